@@ -30,23 +30,20 @@ int main (int argc, char *argv[])
 	window.SetBackground (&bgCanvas);
 	bgCanvas.DrawImg ("Assets/bg.bmp", 0, 0, xWnd, yWnd);
 
-	// Init Canvases
-	std::vector<std::vector<std::unique_ptr<Canvas>>> dras (cDir);
+	// Init Sprite Sheets
+	// Each Sheet has a Row of Frames, with their Masks right below
+	std::vector<std::unique_ptr<SpriteSheet>> dras;
 	for (size_t i = 0; i < cDir; i++)
-		for (size_t j = 0; j < cDraPerDir; j++)
-		{
-			auto fileName = std::string ("Assets/dra") +
-				std::to_string (i) + ".bmp";
-			std::unique_ptr<Canvas> egg (
-				new Canvas (draSize[i].first, draSize[i].second));
-
-			egg->DrawImgMask (fileName.c_str (), fileName.c_str (),
-				(int) draSize[i].first, (int) draSize[i].second,
-							  0, 0,
-							  (int) (j * draSize[i].first), 0,
-							  (int) (j * draSize[i].first), (int) (draSize[i].second));
-			dras[i].emplace_back (std::move (egg));
-		}
+	{
+		auto fileName = std::string ("Assets/dra") +
+			std::to_string (i) + ".bmp";
+		Image sheet (fileName.c_str ());
+
+		dras.emplace_back (new SpriteSheet (
+			sheet, sheet,
+			(unsigned) draSize[i].first, (unsigned) draSize[i].second,
+			0, (unsigned) draSize[i].second));
+	}
 
 	// Shared Data
 	auto iDir = 0;
@@ -200,7 +197,7 @@ int main (int argc, char *argv[])
 			// Compute what to Draw
 			if (pDra != nullptr)
 				bgCanvas -= pDra;
-			pDra = dras[iDir][iFrame].get ();
+			pDra = &(*dras[iDir])[iFrame % dras[iDir]->GetFrameCount ()];
 			pDra->MoveTo (pos_x, pos_y);
 			bgCanvas += pDra;
 
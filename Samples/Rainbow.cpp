@@ -5,7 +5,6 @@
 
 #include "../src/EggAche.h"
 #include <vector>
-#include <tuple>
 
 int main (int argc, char *argv[])
 {
@@ -16,26 +15,25 @@ int main (int argc, char *argv[])
 	Canvas canvas (wndSize, wndSize);
 	window.SetBackground (&canvas);
 
-	std::vector<std::tuple<unsigned, unsigned, unsigned>> colors
+	// Create Brushes once, and Switch among them by SetStyle
+	std::vector<Brush> brushes
 	{
-		{255, 0, 0},
-		{255, 165, 0},
-		{255, 255, 0},
-		{0, 255, 0},
-		{0, 127, 255},
-		{0, 0, 255},
-		{139, 0, 255}
+		Brush (false, 255, 0, 0),
+		Brush (false, 255, 165, 0),
+		Brush (false, 255, 255, 0),
+		Brush (false, 0, 255, 0),
+		Brush (false, 0, 127, 255),
+		Brush (false, 0, 0, 255),
+		Brush (false, 139, 0, 255)
 	};
-	auto cColor = colors.size ();
+	auto cColor = brushes.size ();
 	double anglePerSeg = 360.0 / cColor;
 
-	canvas.SetPen (0, 0, 0, 0);
+	canvas.SetStyle (Pen (0));
 	auto DrawRainbow = [&] (double angleBeg,
-							unsigned r,
-							unsigned g,
-							unsigned b)
+							const Brush &brush)
 	{
-		canvas.SetBrush (false, r, g, b);
+		canvas.SetStyle (brush);
 		canvas.DrawPie (0, 0, wndSize, wndSize,
 						angleBeg, anglePerSeg);
 	};
@@ -58,9 +56,7 @@ int main (int argc, char *argv[])
 			for (size_t i = 0; i < cColor; i++)
 				DrawRainbow (anglePerSeg * i +
 							 offset * 360.0 / offsetCount,
-							 std::get<0> (colors[i]),
-							 std::get<1> (colors[i]),
-							 std::get<2> (colors[i]));
+							 brushes[i]);
 			window.Refresh ();
 		}
 
@@ -20,26 +20,26 @@ int main (int argc, char *argv[])
 	window.SetBackground (canvas.get ());
 
 	const auto fontHeight = 18;							// Default Font Height is 18
-	const auto fontWidth = canvas->GetTxtWidth ("a");	// Default Font is Fixed-Width
-	auto chPerLine = width / fontWidth;
-	std::string bufStr;
+	TextLayout layout (width, fontHeight);
+	layout.AppendParagraph ("");
 
 	std::mutex mtx;
 	auto drawScheme = [&] ()
 	{
 		canvas->Clear ();
 
-		// Text
-		auto rowCount = bufStr.size () / chPerLine;
-		for (size_t i = 0; i < rowCount + 1; i++)
-		{
-			std::string strLine (bufStr, i * chPerLine, chPerLine);
-			canvas->DrawTxt (0, (int) (i * fontHeight), strLine.c_str ());
-		}
+		// Text (Only the Last Lines that fit in the Window)
+		auto cRow = height / fontHeight;
+		auto cLine = layout.GetLineCount (*canvas);
+		auto firstLine = cLine > cRow ? cLine - cRow : 0;
+		layout.Draw (*canvas, 0, 0, firstLine, cRow);
 
 		// Cursor
-		auto xPos = (bufStr.size () % chPerLine) * fontWidth;
-		auto yPos = rowCount * fontHeight;
+		auto iLast = layout.GetParagraphCount () - 1;
+		auto pos = layout.Locate (*canvas, iLast,
+								  layout.GetParagraph (iLast).size ());
+		auto xPos = pos.first;
+		auto yPos = (pos.second - firstLine) * fontHeight;
 		canvas->DrawLine ((int) xPos, (int) yPos,
 			(int) xPos, (int) (yPos + fontHeight));
 
@@ -53,7 +53,7 @@ int main (int argc, char *argv[])
 
 		width = x;
 		height = y;
-		chPerLine = width / fontWidth;
+		layout.SetWidth (width);
 
 		canvas = std::unique_ptr<Canvas> (new Canvas (width, height));
 		window.SetBackground (canvas.get ());
@@ -64,15 +64,25 @@ int main (int argc, char *argv[])
 	{
 		std::lock_guard<std::mutex> lg (mtx);
 
+		auto iLast = layout.GetParagraphCount () - 1;
+		auto bufStr = layout.GetParagraph (iLast);
 		switch (ch)
 		{
 		case '\b':
 			if (!bufStr.empty ())
+			{
 				bufStr.pop_back ();
+				layout.SetParagraph (iLast, bufStr);
+			}
+			else if (iLast > 0)
+				layout.EraseParagraph (iLast);
 			break;
 
 		case '\r':
 		case '\n':
+			layout.AppendParagraph ("");
+			break;
+
 		case '\t':
 		case '\v':
 		case '\f':
@@ -80,6 +90,7 @@ int main (int argc, char *argv[])
 
 		default:
 			bufStr.push_back (ch);
+			layout.SetParagraph (iLast, bufStr);
 			break;
 		}
 		drawScheme ();
@@ -0,0 +1,59 @@
+//
+// Asset Packer of EggAche Graphics Library
+// By BOT Man, 2016
+//
+// Usage: PackAssets <output.pack> <image>...
+// Build: g++ -std=c++11 -O2 PackAssets.cpp ../src/EggAche_Pack.cpp
+//        ../src/EggAche_Image.cpp ../src/EggAche_Png.cpp ../src/EggAche_Jpeg.cpp
+//        ../src/EggAche_Qoi.cpp ../src/EggAche_Zlib.cpp ../src/EggAche_Async.cpp
+//        -lpthread
+//
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/EggAche_Pack.h"
+
+int main (int argc, char *argv[])
+{
+	using namespace EggAche_Impl;
+
+	if (argc < 3)
+	{
+		fprintf (stderr, "Usage: %s <output.pack> <image>...\n", argv[0]);
+		return 1;
+	}
+
+	// Decode all in Parallel, and keep the Paths as Names
+	std::vector<std::shared_ptr<PendingImage>> pendings;
+	for (auto i = 2; i < argc; i++)
+		pendings.push_back (LoadImageFileAsync (argv[i]));
+
+	std::vector<std::string> names;
+	std::vector<std::shared_ptr<const ImageData>> images;
+	size_t cbPixels = 0;
+	for (auto i = 2; i < argc; i++)
+	{
+		auto image = pendings[i - 2]->Wait ();
+		if (!image)
+		{
+			fprintf (stderr, "Can't Decode %s\n", argv[i]);
+			return 1;
+		}
+		names.push_back (argv[i]);
+		images.push_back (image);
+		cbPixels += (size_t) image->w * image->h * 4;
+	}
+
+	if (!AssetPackData::Save (argv[1], names, images))
+	{
+		fprintf (stderr, "Can't Save %s (or Names are Duplicated)\n", argv[1]);
+		return 1;
+	}
+
+	printf ("Packed %u Images (%u KB of Pixels) into %s\n",
+			(unsigned) images.size (), (unsigned) (cbPixels >> 10), argv[1]);
+	return 0;
+}
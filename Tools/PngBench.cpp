@@ -0,0 +1,176 @@
+//
+// PNG Encoder Benchmark of EggAche Graphics Library
+// By BOT Man, 2016
+//
+// Usage: PngBench [image]...
+// Build: g++ -std=c++11 -O2 PngBench.cpp ../src/EggAche_Image.cpp
+//        ../src/EggAche_Png.cpp ../src/EggAche_Jpeg.cpp ../src/EggAche_Qoi.cpp
+//        ../src/EggAche_Zlib.cpp
+//
+// Compare the Speed (MB of RGB a Second) and the Ratio (RGB to PNG Size)
+// of PngEncoder at several Levels against stb_image_write's;
+// Without any image, a UI-like, a Gradient and a Noise Image are Synthesized;
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../src/EggAche_Image.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../src/stb_image_write.h"
+
+namespace
+{
+	using namespace EggAche_Impl;
+
+	const int RUNS = 3;						// Best of the Runs is Reported
+
+	struct Sample
+	{
+		std::string name;
+		int w, h;
+		std::vector<uint32_t> pixels;		// 0x00RRGGBB, Row by Row
+	};
+
+	Sample Synthesize (const char *name, int w, int h)
+	{
+		Sample sample { name, w, h, std::vector<uint32_t> ((size_t) w * h) };
+		uint32_t seed = 7;
+		for (auto y = 0; y < h; y++)
+			for (auto x = 0; x < w; x++)
+			{
+				uint32_t color;
+				if (sample.name == "ui")
+					color = y % 40 < 24 && x % 160 < 140 ? 0xF0F0F0 :
+					(x / 160 + y / 40) % 5 ? 0xFFFFFF : 0x3366CC;
+				else if (sample.name == "gradient")
+					color = (uint32_t) (x * 255 / w) << 16 |
+					(uint32_t) (y * 255 / h) << 8 | ((x ^ y) & 0xFF);
+				else
+					color = (seed = seed * 1664525 + 1013904223) >> 8;
+				sample.pixels[(size_t) y * w + x] = color;
+			}
+		return sample;
+	}
+
+	// Time fn by the Best of RUNS, in Seconds
+	double Measure (const std::function<size_t ()> &fn, size_t &size)
+	{
+		auto best = 1e30;
+		for (auto i = 0; i < RUNS; i++)
+		{
+			auto start = std::chrono::steady_clock::now ();
+			size = fn ();
+			std::chrono::duration<double> elapsed =
+				std::chrono::steady_clock::now () - start;
+			best = std::min (best, elapsed.count ());
+		}
+		return best;
+	}
+
+	void Report (const char *encoder, const Sample &sample,
+				 double seconds, size_t size)
+	{
+		auto cbRgb = (double) sample.w * sample.h * 3;
+		if (size)
+			printf ("%-10s %-14s %8.1f MB/s %8.2f : 1 %10u B\n",
+					sample.name.c_str (), encoder,
+					cbRgb / seconds / (1 << 20), cbRgb / size, (unsigned) size);
+		else
+			printf ("%-10s %-14s Failed\n", sample.name.c_str (), encoder);
+	}
+
+	void Bench (Sample &sample)
+	{
+		Surface surface { (unsigned char *) sample.pixels.data (),
+			(ptrdiff_t) sample.w * 4, sample.w, sample.h };
+
+		const int levels[] = { 1, 6, 9 };
+		for (auto level : levels)
+		{
+			size_t size;
+			auto seconds = Measure ([&] ()
+			{
+				size_t cb = 0;
+				PngEncoder png (sample.w, sample.h,
+								[&] (const uint8_t *, size_t n) { cb += n; return true; },
+								nullptr, level);
+				return png.AddRows (surface) && png.Finish () ? cb : 0;
+			}, size);
+			Report (("EggAche L" + std::to_string (level)).c_str (),
+					sample, seconds, size);
+		}
+
+		// As Canvas::Encode does, Indexed if there are few Colors
+		{
+			size_t size;
+			auto seconds = Measure ([&] ()
+			{
+				ColorCensus census;
+				auto isIndexed = census.Add (surface);
+				size_t cb = 0;
+				PngEncoder png (sample.w, sample.h,
+								[&] (const uint8_t *, size_t n) { cb += n; return true; },
+								isIndexed ? &census : nullptr);
+				return png.AddRows (surface) && png.Finish () ? cb : 0;
+			}, size);
+			Report ("EggAche Auto", sample, seconds, size);
+		}
+
+		// stb takes Packed RGB, which is not Counted in its Time
+		std::vector<unsigned char> rgb ((size_t) sample.w * sample.h * 3);
+		for (size_t i = 0; i < sample.pixels.size (); i++)
+		{
+			rgb[i * 3] = (unsigned char) (sample.pixels[i] >> 16);
+			rgb[i * 3 + 1] = (unsigned char) (sample.pixels[i] >> 8);
+			rgb[i * 3 + 2] = (unsigned char) sample.pixels[i];
+		}
+		size_t size;
+		auto seconds = Measure ([&] ()
+		{
+			int len = 0;
+			auto png = stbi_write_png_to_mem (rgb.data (), sample.w * 3,
+											  sample.w, sample.h, 3, &len);
+			free (png);
+			return png ? (size_t) len : 0;
+		}, size);
+		Report ("stb", sample, seconds, size);
+	}
+}
+
+int main (int argc, char *argv[])
+{
+	std::vector<Sample> samples;
+	for (auto i = 1; i < argc; i++)
+	{
+		auto image = LoadImageFile (argv[i]);
+		if (!image)
+		{
+			fprintf (stderr, "Can't Decode %s\n", argv[i]);
+			return 1;
+		}
+		Sample sample { argv[i], image->w, image->h,
+			std::vector<uint32_t> ((size_t) image->w * image->h) };
+		for (auto y = 0; y < image->h; y++)
+			for (auto x = 0; x < image->w; x++)
+				sample.pixels[(size_t) y * image->w + x] =
+				image->Pixel (x, y) & 0xFFFFFF;
+		samples.push_back (std::move (sample));
+	}
+	if (samples.empty ())
+	{
+		samples.push_back (Synthesize ("ui", 1920, 1080));
+		samples.push_back (Synthesize ("gradient", 1920, 1080));
+		samples.push_back (Synthesize ("noise", 1024, 1024));
+	}
+
+	for (auto &sample : samples)
+		Bench (sample);
+	return 0;
+}
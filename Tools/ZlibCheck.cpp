@@ -0,0 +1,105 @@
+//
+// Zlib Checker of EggAche Graphics Library
+// By BOT Man, 2016
+//
+// Usage: ZlibCheck
+// Build: g++ -std=c++11 -O2 ZlibCheck.cpp ../src/EggAche_Zlib.cpp
+//
+// Check that Deflater's Streams (at every Level, Written Piece by Piece)
+// Inflate back, and that Malformed Streams are Rejected safely;
+// Return 0 if all Pass (Build with -fsanitize=address to catch Overruns);
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../src/EggAche_Zlib.h"
+
+namespace
+{
+	using namespace EggAche_Impl;
+
+	struct Malformed
+	{
+		const char *name;
+		std::vector<unsigned char> stream;
+	};
+
+	// Streams Crafted to Break a careless Inflater
+	const Malformed MALFORMED[] = {
+		// Dynamic Block of 288 Literal/Length and 32 Distance Lengths
+		// (over RFC 1951's 286 and 30), Run-length Coded to the 320th
+		{ "HLIT / HDIST over the Limits",
+			{ 0x78, 0x9C, 0xFD, 0x1F, 0x80, 0xE4, 0xFF, 0x7F, 0x08 } },
+		{ "Truncated Header", { 0x78 } },
+		{ "Preset Dictionary", { 0x78, 0xBB, 0x03, 0x00 } },
+		{ "Reserved Block Type", { 0x78, 0x9C, 0x07, 0x00 } },
+		{ "Stored Length not Complemented",
+			{ 0x78, 0x9C, 0x01, 0x05, 0x00, 0x05, 0x00, 'E', 'g', 'g', 'A', 'c' } },
+	};
+
+	std::vector<unsigned char> Synthesize (size_t size)
+	{
+		// Runs, Repeated Phrases and Noise, as Rows of an Image would be
+		std::vector<unsigned char> data (size);
+		uint32_t seed = 7;
+		for (size_t i = 0; i < size; i++)
+		{
+			seed = seed * 1664525 + 1013904223;
+			if (i % 4096 < 1024)
+				data[i] = (unsigned char) (i / 256);
+			else if (i % 4096 < 3072 && i >= 300)
+				data[i] = data[i - 300 + (seed >> 28)];
+			else
+				data[i] = (unsigned char) (seed >> 24);
+		}
+		return data;
+	}
+
+	bool RoundTrip (const std::vector<unsigned char> &data, int level, size_t piece)
+	{
+		Deflater deflater (level);
+		std::vector<unsigned char> stream, back;
+		for (size_t i = 0; i < data.size (); i += piece)
+			deflater.Write (data.data () + i, std::min (piece, data.size () - i), stream);
+		deflater.Finish (stream);
+		return Inflate (stream.data (), stream.size (), back) && back == data;
+	}
+}
+
+int main ()
+{
+	auto cFailed = 0;
+	for (const auto &malformed : MALFORMED)
+	{
+		std::vector<unsigned char> out;
+		auto isRejected = !Inflate (malformed.stream.data (),
+									malformed.stream.size (), out);
+		printf ("%-40s %s\n", malformed.name, isRejected ? "Rejected" : "FAILED");
+		cFailed += !isRejected;
+	}
+
+	const size_t sizes[] = { 0, 1, 65535, 200000 };
+	const size_t pieces[] = { 1, 777, 1 << 20 };
+	for (auto size : sizes)
+	{
+		auto data = Synthesize (size);
+		for (auto level = 0; level <= 9; level++)
+			for (auto piece : pieces)
+			{
+				if (size > 65535 && piece == 1)
+					continue;
+				if (!RoundTrip (data, level, piece))
+				{
+					printf ("Round Trip of %u Bytes at Level %d by %u FAILED\n",
+							(unsigned) size, level, (unsigned) piece);
+					cFailed++;
+				}
+			}
+	}
+
+	printf ("%s\n", cFailed ? "FAILED" : "All Passed");
+	return cFailed ? 1 : 0;
+}
@@ -4,10 +4,132 @@
 //
 
 #include <memory>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <mutex>
+#include <string>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
 
 #include "EggAche.h"
 #include "EggAche_Impl.h"
 
+namespace EggAche_Impl
+{
+	// Intern Tables of Drawing States
+
+	namespace
+	{
+		std::mutex internMtx;
+
+		inline unsigned long long PackColor (unsigned r, unsigned g, unsigned b)
+		{
+			return (std::min (r, 255u) << 16) |
+				(std::min (g, 255u) << 8) | std::min (b, 255u);
+		}
+
+		// Tables are built on First Use, for Styles Constructed Statically
+		std::unordered_map<unsigned long long,
+			std::unique_ptr<PenStyle>> &Pens ()
+		{
+			static std::unordered_map<unsigned long long,
+				std::unique_ptr<PenStyle>> pens;
+			return pens;
+		}
+
+		std::unordered_map<unsigned long long,
+			std::unique_ptr<BrushStyle>> &Brushes ()
+		{
+			static std::unordered_map<unsigned long long,
+				std::unique_ptr<BrushStyle>> brushes;
+			return brushes;
+		}
+
+		// Color of Null Pen is ignored
+		unsigned long long PenKey (unsigned width,
+								   unsigned r, unsigned g, unsigned b)
+		{
+			return ((unsigned long long) width << 24) |
+				(width ? PackColor (r, g, b) : 0);
+		}
+
+		// Color of Transparent Brush is ignored
+		unsigned long long BrushKey (bool isTransparent,
+									 unsigned r, unsigned g, unsigned b)
+		{
+			return ((unsigned long long) isTransparent << 24) |
+				(isTransparent ? 0 : PackColor (r, g, b));
+		}
+	}
+
+	const PenStyle *InternPen (unsigned width,
+							   unsigned r, unsigned g, unsigned b)
+	{
+		if (width == 0)
+			r = g = b = 0;
+		auto key = PenKey (width, r, g, b);
+
+		std::lock_guard<std::mutex> lg (internMtx);
+		auto &pen = Pens ()[key];
+		if (!pen)
+			pen.reset (new PenStyle {
+			width, std::min (r, 255u), std::min (g, 255u), std::min (b, 255u) });
+		return pen.get ();
+	}
+
+	const BrushStyle *InternBrush (bool isTransparent,
+								   unsigned r, unsigned g, unsigned b)
+	{
+		if (isTransparent)
+			r = g = b = 0;
+		auto key = BrushKey (isTransparent, r, g, b);
+
+		std::lock_guard<std::mutex> lg (internMtx);
+		auto &brush = Brushes ()[key];
+		if (!brush)
+			brush.reset (new BrushStyle {
+			isTransparent, std::min (r, 255u), std::min (g, 255u), std::min (b, 255u) });
+		return brush.get ();
+	}
+
+	const FontStyle *InternFont (unsigned size, const char *family,
+								 unsigned r, unsigned g, unsigned b)
+	{
+		static std::unordered_map<std::string,
+			std::unique_ptr<FontStyle>> fonts;
+
+		auto key = std::string (family) + '\n' +
+			std::to_string (((unsigned long long) size << 24) | PackColor (r, g, b));
+
+		std::lock_guard<std::mutex> lg (internMtx);
+		auto &font = fonts[key];
+		if (!font)
+			font.reset (new FontStyle {
+			size, family, std::min (r, 255u), std::min (g, 255u), std::min (b, 255u) });
+		return font.get ();
+	}
+
+	const PenStyle *FindPen (unsigned width,
+							 unsigned r, unsigned g, unsigned b)
+	{
+		std::lock_guard<std::mutex> lg (internMtx);
+		auto it = Pens ().find (PenKey (width, r, g, b));
+		return it != Pens ().end () ? it->second.get () : nullptr;
+	}
+
+	const BrushStyle *FindBrush (bool isTransparent,
+								 unsigned r, unsigned g, unsigned b)
+	{
+		std::lock_guard<std::mutex> lg (internMtx);
+		auto it = Brushes ().find (BrushKey (isTransparent, r, g, b));
+		return it != Brushes ().end () ? it->second.get () : nullptr;
+	}
+}
+
 namespace EggAche
 {
 	EggAche_Impl::GUIFactory *NewGUIFactory ()
@@ -23,7 +145,7 @@ namespace EggAche
 	Window::Window (size_t width,
 					size_t height,
 					const char *cap_string)
-		: bgCanvas (nullptr), windowImpl (nullptr)
+		: bgCanvas (nullptr), asyncGeneration (0), windowImpl (nullptr)
 	{
 		std::unique_ptr<EggAche_Impl::GUIFactory> guiFactory (
 			NewGUIFactory ());
@@ -48,6 +170,14 @@ namespace EggAche
 		if (IsClosed () || !this->bgCanvas)
 			return false;
 
+		// Walk the Canvases only if any Image is Decoded since the last time
+		auto generation = EggAche_Impl::AsyncGeneration ();
+		if (generation != asyncGeneration)
+		{
+			asyncGeneration = generation;
+			this->bgCanvas->RecursiveDrawAsync ();
+		}
+
 		if (!this->bgCanvas->isLatest)
 			this->bgCanvas->Buffering ();
 		return windowImpl->Draw (this->bgCanvas->buffer.get (), 0, 0);
@@ -112,10 +242,268 @@ namespace EggAche
 		{ fn (this, ch); });
 	}
 
+	Pen::Pen (unsigned width, unsigned r, unsigned g, unsigned b)
+		: style (EggAche_Impl::InternPen (width, r, g, b))
+	{}
+
+	Brush::Brush (bool isTransparent, unsigned r, unsigned g, unsigned b)
+		: style (EggAche_Impl::InternBrush (isTransparent, r, g, b))
+	{}
+
+	Font::Font (unsigned size, const char *family,
+				unsigned r, unsigned g, unsigned b)
+		: style (EggAche_Impl::InternFont (size, family, r, g, b))
+	{}
+
+	Path::Path ()
+	{}
+
+	void Path::MoveTo (int x, int y)
+	{
+		contours.push_back ({ { (double) x, (double) y } });
+		closed.push_back (false);
+	}
+
+	void Path::LineTo (int x, int y)
+	{
+		this->Continue ();
+		contours.back ().push_back ({ (double) x, (double) y });
+	}
+
+	void Path::QuadTo (int xCtrl, int yCtrl, int x, int y)
+	{
+		this->Continue ();
+		EggAche_Impl::FlattenQuad (contours.back (),
+			{ (double) xCtrl, (double) yCtrl },
+			{ (double) x, (double) y });
+	}
+
+	void Path::CubicTo (int xCtrl1, int yCtrl1,
+						int xCtrl2, int yCtrl2,
+						int x, int y)
+	{
+		this->Continue ();
+		EggAche_Impl::FlattenCubic (contours.back (),
+			{ (double) xCtrl1, (double) yCtrl1 },
+			{ (double) xCtrl2, (double) yCtrl2 },
+			{ (double) x, (double) y });
+	}
+
+	void Path::Continue ()
+	{
+		if (contours.empty ())
+			this->MoveTo (0, 0);
+		else if (closed.back ())
+		{
+			// Start where the Closed Sub Path Began (and Ended)
+			auto start = contours.back ().front ();
+			contours.push_back ({ start });
+			closed.push_back (false);
+		}
+	}
+
+	void Path::Close ()
+	{
+		if (!contours.empty ())
+			closed.back () = true;
+	}
+
+	void Path::Clear ()
+	{
+		contours.clear ();
+		closed.clear ();
+	}
+
+	Image::Image (const char *fileName)
+		: data (EggAche_Impl::LoadImageFile (fileName))
+	{
+		if (!data)
+			throw std::runtime_error ("Err_Image_#0_Decode");
+	}
+
+	Image Image::LoadAsync (const char *fileName)
+	{
+		Image image;
+		image.pending = EggAche_Impl::LoadImageFileAsync (fileName);
+		return image;
+	}
+
+	bool Image::IsLoading () const
+	{
+		return pending && !pending->IsDone ();
+	}
+
+	const std::shared_ptr<const EggAche_Impl::ImageData> &Image::Data () const
+	{
+		if (pending)
+		{
+			data = pending->Wait ();
+			pending = nullptr;
+		}
+		if (!data)
+			throw std::runtime_error ("Err_Image_#0_Decode");
+		return data;
+	}
+
+	size_t Image::GetWidth () const
+	{
+		return (size_t) Data ()->w;
+	}
+
+	size_t Image::GetHeight () const
+	{
+		return (size_t) Data ()->h;
+	}
+
+	Atlas::Atlas (size_t pageWidth, size_t pageHeight)
+		: data (new EggAche_Impl::AtlasData ((int) pageWidth, (int) pageHeight))
+	{}
+
+	Atlas::Atlas (const char *fileName)
+		: data (EggAche_Impl::AtlasData::Load (fileName))
+	{
+		if (!data)
+			throw std::runtime_error ("Err_Atlas_#0_Load");
+	}
+
+	size_t Atlas::Add (const Image &image)
+	{
+		return data->Add (*image.Data ());
+	}
+
+	size_t Atlas::Add (const char *fileName)
+	{
+		return Add (Image (fileName));
+	}
+
+	void Atlas::Add (const char *const *fileNames, size_t count, size_t *ids)
+	{
+		// Decode all in Parallel, and Pack the Taller ones first
+		std::vector<Image> images;
+		for (size_t i = 0; i < count; i++)
+			images.push_back (Image::LoadAsync (fileNames[i]));
+
+		std::vector<size_t> order (count);
+		for (size_t i = 0; i < count; i++)
+			order[i] = i;
+		std::stable_sort (order.begin (), order.end (), [&] (size_t a, size_t b)
+		{
+			return images[a].GetHeight () > images[b].GetHeight ();
+		});
+
+		for (auto i : order)
+			ids[i] = Add (images[i]);
+	}
+
+	size_t Atlas::GetCount () const
+	{
+		return data->Count ();
+	}
+
+	size_t Atlas::GetPageCount () const
+	{
+		return data->PageCount ();
+	}
+
+	size_t Atlas::GetWidth (size_t id) const
+	{
+		return id < data->Count () ? (size_t) data->Entry (id)->w : 0;
+	}
+
+	size_t Atlas::GetHeight (size_t id) const
+	{
+		return id < data->Count () ? (size_t) data->Entry (id)->h : 0;
+	}
+
+	bool Atlas::Save (const char *fileName) const
+	{
+		return data->Save (fileName);
+	}
+
+	AssetPack::AssetPack (const char *fileName)
+		: data (EggAche_Impl::AssetPackData::Load (fileName))
+	{
+		if (!data)
+			throw std::runtime_error ("Err_AssetPack_#0_Load");
+	}
+
+	bool AssetPack::Has (const char *name) const
+	{
+		return data->Find (name) != nullptr;
+	}
+
+	Image AssetPack::Get (const char *name) const
+	{
+		Image image;
+		image.data = data->Find (name);
+		if (!image.data)
+			throw std::runtime_error ("Err_AssetPack_#1_Name");
+		return image;
+	}
+
+	size_t AssetPack::GetCount () const
+	{
+		return data->Count ();
+	}
+
+	SnapshotLog::SnapshotLog (const char *fileName)
+		: store (EggAche_Impl::SnapshotStore::Open (fileName))
+	{
+		if (!store)
+			throw std::runtime_error ("Err_SnapshotLog_#0_Open");
+	}
+
+	size_t SnapshotLog::GetFrameCount () const
+	{
+		return store->FrameCount ();
+	}
+
+	size_t SnapshotLog::GetTileCount () const
+	{
+		return store->TileCount ();
+	}
+
+	Image SnapshotLog::GetFrame (size_t index) const
+	{
+		Image image;
+		image.data = store->Frame (index);
+		if (!image.data)
+			throw std::runtime_error ("Err_SnapshotLog_#1_Frame");
+		return image;
+	}
+
+	SnapshotPolicy::SnapshotPolicy (unsigned budgetMs)
+		: budget (new EggAche_Impl::SnapshotBudget (budgetMs / 1000.0)),
+		lastFormat (ImageFormat::Bmp)
+	{}
+
+	void SnapshotPolicy::SetBudget (unsigned budgetMs)
+	{
+		budget->SetBudget (budgetMs / 1000.0);
+	}
+
+	unsigned SnapshotPolicy::GetBudget () const
+	{
+		return (unsigned) (budget->Budget () * 1000 + 0.5);
+	}
+
+	ImageFormat SnapshotPolicy::GetLastFormat () const
+	{
+		return lastFormat;
+	}
+
+	namespace
+	{
+		// Unique across Canvases, so it also tells which Canvas Measured
+		std::atomic<unsigned long> fontGenerations (0);
+	}
+
 	Canvas::Canvas (size_t width, size_t height,
 					int pos_x, int pos_y)
 		: isLatest (false),
-		x (pos_x), y (pos_y), w (width), h (height)
+		x (pos_x), y (pos_y), w (width), h (height),
+		penWidth (1), fontSize (18),
+		fontGeneration (++fontGenerations), advancesGeneration (0)
 	{
 		std::unique_ptr<EggAche_Impl::GUIFactory> guiFactory (
 			NewGUIFactory ());
@@ -123,15 +511,87 @@ namespace EggAche
 			guiFactory->NewGUIContext (width, height));
 	}
 
+	Canvas::Canvas (const Image &sheet,
+					unsigned width, unsigned height,
+					unsigned x_src, unsigned y_src,
+					int pos_x, int pos_y)
+		: isLatest (false),
+		x (pos_x), y (pos_y), w (width), h (height),
+		penWidth (1), fontSize (18),
+		fontGeneration (++fontGenerations), advancesGeneration (0)
+	{
+		frame = EggAche_Impl::SubImage (sheet.Data (), (int) x_src, (int) y_src,
+										(int) width, (int) height);
+		if (!frame)
+			throw std::runtime_error ("Err_Canvas_#0_Frame");
+	}
+
+	Canvas::Canvas (const Image &sheet, const Image &mask,
+					unsigned width, unsigned height,
+					unsigned x_src, unsigned y_src,
+					unsigned x_msk, unsigned y_msk,
+					int pos_x, int pos_y)
+		: Canvas (sheet, width, height, x_src, y_src, pos_x, pos_y)
+	{
+		auto frameMask = EggAche_Impl::SubImage (mask.Data (), (int) x_msk, (int) y_msk,
+												 (int) width, (int) height);
+		if (!frameMask)
+			throw std::runtime_error ("Err_Canvas_#1_Mask");
+
+		// Split into Runs now, rather than on every Buffering
+		frameSprite = EggAche_Impl::BuildMaskedSprite (*frame, 0, 0, *frameMask, 0, 0,
+													   (int) width, (int) height);
+		if (!frameSprite)
+			throw std::runtime_error ("Err_Canvas_#1_Mask");
+	}
+
+	EggAche_Impl::GUIContext *Canvas::Context ()
+	{
+		if (!frame)
+			return context.get ();
+
+		// Copy the Viewed Frame into a new Bitmap
+		std::unique_ptr<EggAche_Impl::GUIFactory> guiFactory (
+			NewGUIFactory ());
+		context = std::unique_ptr<EggAche_Impl::GUIContext> (
+			guiFactory->NewGUIContext (w, h));
+
+		if (frameSprite)
+			context->DrawSprite (*frameSprite, 0, 0);
+		else
+			context->DrawImg (*frame, 0, 0, (int) w, (int) h);
+		if (!clipStack.empty ())
+			context->SetClip (clipStack.back ());
+
+		frame = nullptr;
+		frameSprite = nullptr;
+		return context.get ();
+	}
+
 	void Canvas::RecursiveDraw (EggAche_Impl::GUIContext *parentContext,
-								size_t x, size_t y) const
+								size_t x, size_t y,
+								const EggAche_Impl::Rect &bounds) const
 	{
 		// Actual Position of this Canvas
-		this->context->PaintOnContext (parentContext, x, y);
+		// Canvases out of bounds are not Painted, but their Sub Canvases
+		// may lie out of them, so those are Visited anyway
+		auto isOut = (int) x >= bounds.right || (int) y >= bounds.bottom ||
+			(int) x + (int) w <= bounds.left || (int) y + (int) h <= bounds.top;
+		if (!isOut)
+		{
+			// Frame Views are Blitted from the Sheet directly,
+			// Keyed as their Copies would be once Drawn on
+			if (this->frameSprite)
+				parentContext->DrawSprite (*this->frameSprite, (int) x, (int) y);
+			else if (this->frame)
+				parentContext->DrawImgKeyed (*this->frame, (int) x, (int) y);
+			else
+				this->context->PaintOnContext (parentContext, x, y);
+		}
 
 		for (auto subCanvas : this->subCanvases)
 			subCanvas->RecursiveDraw (parentContext,
-									  x + subCanvas->x, y + subCanvas->y);
+									  x + subCanvas->x, y + subCanvas->y, bounds);
 	}
 
 	void Canvas::RecursiveInvalidate ()
@@ -151,10 +611,54 @@ namespace EggAche
 		buffer->SetBrush (false, 255, 255, 255);
 		buffer->DrawRect (-10, -10, (int) (this->w + 10), (int) (this->h + 10));
 
-		this->RecursiveDraw (buffer.get (), 0, 0);
+		this->RecursiveDraw (buffer.get (), 0, 0,
+							 EggAche_Impl::Rect { 0, 0, (int) w, (int) h });
 		isLatest = true;
 	}
 
+	EggAche_Impl::Rect Canvas::TrimRect (int x, int y,
+										 unsigned width, unsigned height) const
+	{
+		return EggAche_Impl::Rect {
+			std::max (x, 0), std::max (y, 0),
+			(int) std::min ((long long) x + width, (long long) w),
+			(int) std::min ((long long) y + height, (long long) h) };
+	}
+
+	bool Canvas::ComposeRegion (const EggAche_Impl::Rect &rect, int bandHeight,
+								std::function<bool (
+									const EggAche_Impl::GUIContext *,
+									const EggAche_Impl::Rect &)> fnBand)
+	{
+		if (rect.IsEmpty ())
+			return false;
+
+		if (isLatest)
+			return fnBand (buffer.get (), rect);
+
+		// Compose the Rect Band by Band, each at (0, 0) of a single Context,
+		// so only the Sub Canvases across the Band are Drawn
+		auto rectW = rect.right - rect.left;
+		bandHeight = std::min (bandHeight, rect.bottom - rect.top);
+		std::unique_ptr<EggAche_Impl::GUIFactory> guiFactory (
+			NewGUIFactory ());
+		std::unique_ptr<EggAche_Impl::GUIContext> band (
+			guiFactory->NewGUIContext ((size_t) rectW, (size_t) bandHeight));
+		band->SetBrush (false, 255, 255, 255);
+
+		for (auto top = rect.top; top < rect.bottom; top += bandHeight)
+		{
+			auto bandRect = EggAche_Impl::Rect {
+				0, 0, rectW, std::min (bandHeight, rect.bottom - top) };
+			band->DrawRect (-10, -10, rectW + 10, bandHeight + 10);
+			this->RecursiveDraw (band.get (),
+								 (size_t) -rect.left, (size_t) -top, bandRect);
+			if (!fnBand (band.get (), bandRect))
+				return false;
+		}
+		return true;
+	}
+
 	void Canvas::operator+= (Canvas *canvas)
 	{
 		if (canvas != this)
@@ -193,99 +697,445 @@ namespace EggAche
 	bool Canvas::SetPen (unsigned width,
 						 unsigned r, unsigned g, unsigned b)
 	{
-		return context->SetPen (width, r, g, b);
+		penWidth = width;
+		return Context ()->SetPen (width, r, g, b);
 	}
 
 	bool Canvas::SetBrush (bool isTransparent,
 						   unsigned r, unsigned g, unsigned b)
 	{
-		return context->SetBrush (isTransparent, r, g, b);
+		return Context ()->SetBrush (isTransparent, r, g, b);
 	}
 
 	bool Canvas::SetFont (unsigned size, const char *family,
 						  unsigned r, unsigned g, unsigned b)
 	{
-		return context->SetFont (size, family, r, g, b);
+		fontSize = size;
+		fontGeneration = ++fontGenerations;
+		return Context ()->SetFont (size, family, r, g, b);
+	}
+
+	bool Canvas::SetStyle (const Style &style)
+	{
+		penWidth = style.pen.style->width;
+		fontSize = style.font.style->size;
+		fontGeneration = ++fontGenerations;
+		return Context ()->SetStyle (style.pen.style,
+									 style.brush.style,
+									 style.font.style);
+	}
+
+	bool Canvas::SetStyle (const Pen &pen)
+	{
+		penWidth = pen.style->width;
+		return Context ()->SetStyle (pen.style, nullptr, nullptr);
+	}
+
+	bool Canvas::SetStyle (const Brush &brush)
+	{
+		return Context ()->SetStyle (nullptr, brush.style, nullptr);
+	}
+
+	bool Canvas::SetStyle (const Font &font)
+	{
+		fontSize = font.style->size;
+		fontGeneration = ++fontGenerations;
+		return Context ()->SetStyle (nullptr, nullptr, font.style);
 	}
 
 	void Canvas::Clear ()
 	{
 		this->RecursiveInvalidate ();
-		context->Clear ();
+		asyncDraws.clear ();
+		Context ()->Clear ();
+	}
+
+	bool Canvas::Scroll (int scale_x, int scale_y)
+	{
+		this->RecursiveInvalidate ();
+		return Context ()->Scroll (scale_x, scale_y);
+	}
+
+	void Canvas::PushClip (int xBeg, int yBeg, int xEnd, int yEnd)
+	{
+		EggAche_Impl::Rect clip {
+			std::min (xBeg, xEnd), std::min (yBeg, yEnd),
+			std::max (xBeg, xEnd), std::max (yBeg, yEnd) };
+
+		const auto &outer = clipStack.empty () ?
+			EggAche_Impl::Rect { 0, 0, (int) w, (int) h } : clipStack.back ();
+		clip.left = std::max (clip.left, outer.left);
+		clip.top = std::max (clip.top, outer.top);
+		clip.right = std::max (clip.left, std::min (clip.right, outer.right));
+		clip.bottom = std::max (clip.top, std::min (clip.bottom, outer.bottom));
+
+		clipStack.push_back (clip);
+
+		// Frame Views take the Clip when Copied
+		if (context)
+			context->SetClip (clip);
+	}
+
+	void Canvas::PopClip ()
+	{
+		if (clipStack.empty ())
+			return;
+
+		clipStack.pop_back ();
+		if (context)
+			context->SetClip (CurrentClip ());
+	}
+
+	EggAche_Impl::Rect Canvas::CurrentClip () const
+	{
+		return clipStack.empty () ?
+			EggAche_Impl::Rect { 0, 0, (int) w, (int) h } :
+			clipStack.back ();
+	}
+
+	bool Canvas::IsClippedOut (int xBeg, int yBeg, int xEnd, int yEnd) const
+	{
+		if (clipStack.empty ())
+			return false;
+
+		// Pen may stroke outside the Bounding Box
+		auto margin = (int) (penWidth / 2 + 1);
+		const auto &clip = clipStack.back ();
+		return clip.IsEmpty () ||
+			std::max (xBeg, xEnd) + margin <= clip.left ||
+			std::min (xBeg, xEnd) - margin >= clip.right ||
+			std::max (yBeg, yEnd) + margin <= clip.top ||
+			std::min (yBeg, yEnd) - margin >= clip.bottom;
 	}
 
 	bool Canvas::DrawLine (int xBeg, int yBeg, int xEnd, int yEnd)
 	{
+		if (IsClippedOut (xBeg, yBeg, xEnd, yEnd))
+			return true;
 		this->RecursiveInvalidate ();
-		return context->DrawLine (xBeg, yBeg, xEnd, yEnd);
+		return Context ()->DrawLine (xBeg, yBeg, xEnd, yEnd);
 	}
 
 	bool Canvas::DrawRect (int xBeg, int yBeg, int xEnd, int yEnd)
 	{
+		if (IsClippedOut (xBeg, yBeg, xEnd, yEnd))
+			return true;
 		this->RecursiveInvalidate ();
-		return context->DrawRect (xBeg, yBeg, xEnd, yEnd);
+		return Context ()->DrawRect (xBeg, yBeg, xEnd, yEnd);
 	}
 
 	bool Canvas::DrawElps (int xBeg, int yBeg, int xEnd, int yEnd)
 	{
+		if (IsClippedOut (xBeg, yBeg, xEnd, yEnd))
+			return true;
 		this->RecursiveInvalidate ();
-		return context->DrawElps (xBeg, yBeg, xEnd, yEnd);
+		return Context ()->DrawElps (xBeg, yBeg, xEnd, yEnd);
 	}
 
 	bool Canvas::DrawRdRt (int xBeg, int yBeg, int xEnd, int yEnd,
 						   int wElps, int hElps)
 	{
+		if (IsClippedOut (xBeg, yBeg, xEnd, yEnd))
+			return true;
 		this->RecursiveInvalidate ();
-		return context->DrawRdRt (xBeg, yBeg, xEnd, yEnd,
-								  wElps, hElps);
+		return Context ()->DrawRdRt (xBeg, yBeg, xEnd, yEnd,
+									 wElps, hElps);
 	}
 
 	bool Canvas::DrawArc (int xLeft, int yTop, int xRight, int yBottom,
 						  double angleBeg, double cAngle)
 	{
+		if (IsClippedOut (xLeft, yTop, xRight, yBottom))
+			return true;
 		this->RecursiveInvalidate ();
-		return context->DrawArc (xLeft, yTop, xRight, yBottom,
-								 angleBeg, cAngle);
+		return Context ()->DrawArc (xLeft, yTop, xRight, yBottom,
+									angleBeg, cAngle);
 	}
 
 	bool Canvas::DrawChord (int xLeft, int yTop, int xRight, int yBottom,
 							double angleBeg, double cAngle)
 	{
+		if (IsClippedOut (xLeft, yTop, xRight, yBottom))
+			return true;
 		this->RecursiveInvalidate ();
-		return context->DrawChord (xLeft, yTop, xRight, yBottom,
-								   angleBeg, cAngle);
+		return Context ()->DrawChord (xLeft, yTop, xRight, yBottom,
+									  angleBeg, cAngle);
 	}
 
 	bool Canvas::DrawPie (int xLeft, int yTop, int xRight, int yBottom,
 						  double angleBeg, double cAngle)
 	{
+		if (IsClippedOut (xLeft, yTop, xRight, yBottom))
+			return true;
+		this->RecursiveInvalidate ();
+		return Context ()->DrawPie (xLeft, yTop, xRight, yBottom,
+									angleBeg, cAngle);
+	}
+
+	bool Canvas::DrawPolygon (const std::vector<std::pair<int, int>> &points,
+							  FillRule fillRule)
+	{
+		std::vector<EggAche_Impl::Contour> contours (1);
+		contours[0].reserve (points.size ());
+		for (const auto &point : points)
+			contours[0].push_back ({ (double) point.first, (double) point.second });
+
+		auto bounds = EggAche_Impl::BoundingRect (contours);
+		if (IsClippedOut (bounds.left, bounds.top, bounds.right, bounds.bottom))
+			return true;
+
 		this->RecursiveInvalidate ();
-		return context->DrawPie (xLeft, yTop, xRight, yBottom,
-								 angleBeg, cAngle);
+
+		auto isFilled = Context ()->FillPolygon (contours,
+												 fillRule == FillRule::NonZero);
+		return Context ()->DrawPolyline (contours[0], true) && isFilled;
+	}
+
+	bool Canvas::DrawPolyline (const std::vector<std::pair<int, int>> &points)
+	{
+		std::vector<EggAche_Impl::Contour> contours (1);
+		contours[0].reserve (points.size ());
+		for (const auto &point : points)
+			contours[0].push_back ({ (double) point.first, (double) point.second });
+
+		auto bounds = EggAche_Impl::BoundingRect (contours);
+		if (IsClippedOut (bounds.left, bounds.top, bounds.right, bounds.bottom))
+			return true;
+
+		this->RecursiveInvalidate ();
+		return Context ()->DrawPolyline (contours[0], false);
+	}
+
+	bool Canvas::DrawPath (const Path &path, FillRule fillRule)
+	{
+		auto bounds = EggAche_Impl::BoundingRect (path.contours);
+		if (IsClippedOut (bounds.left, bounds.top, bounds.right, bounds.bottom))
+			return true;
+
+		this->RecursiveInvalidate ();
+
+		auto ret = Context ()->FillPolygon (path.contours,
+											fillRule == FillRule::NonZero);
+		for (size_t i = 0; i < path.contours.size (); i++)
+			if (!Context ()->DrawPolyline (path.contours[i], path.closed[i]))
+				ret = false;
+		return ret;
 	}
 
 	bool Canvas::DrawTxt (int xBeg, int yBeg, const char *szText)
 	{
+		if (IsClippedOut (xBeg, yBeg, INT_MAX / 2, yBeg + (int) fontSize))
+			return true;
 		this->RecursiveInvalidate ();
-		return context->DrawTxt (xBeg, yBeg, szText);
+		return Context ()->DrawTxt (xBeg, yBeg, szText);
 	}
 
 	size_t Canvas::GetTxtWidth (const char *szText)
 	{
-		return context->GetTxtWidth (szText);
+		return Context ()->GetTxtWidth (szText);
+	}
+
+	bool Canvas::MeasureTexts (const char *const *texts, size_t count,
+							   size_t *widths)
+	{
+		return Context ()->MeasureTexts (texts, count, widths);
+	}
+
+	const int *Canvas::Advances ()
+	{
+		if (advancesGeneration == fontGeneration)
+			return advances;
+
+		// Measure all the Characters by a single Batch
+		static char chars[256][2];
+		static const char *texts[256];
+		static std::once_flag isInit;
+		std::call_once (isInit, [] ()
+		{
+			for (auto i = 0; i < 256; i++)
+			{
+				chars[i][0] = (char) i;
+				chars[i][1] = 0;
+				texts[i] = chars[i];
+			}
+		});
+
+		size_t widths[256];
+		if (!this->MeasureTexts (texts, 256, widths))
+			return nullptr;
+		for (auto i = 0; i < 256; i++)
+			advances[i] = (int) widths[i];
+		advancesGeneration = fontGeneration;
+		return advances;
 	}
 
 	bool Canvas::DrawImg (const char *fileName, int x, int y)
 	{
+		if (IsClippedOut (x, y, INT_MAX / 2, INT_MAX / 2))
+			return true;
+
+		// Decode it portably, or leave it to the Platform
+		if (auto image = EggAche_Impl::LoadImageFile (fileName))
+		{
+			this->RecursiveInvalidate ();
+			return Context ()->DrawImg (*image, x, y, image->w, image->h);
+		}
 		this->RecursiveInvalidate ();
-		return context->DrawImg (fileName, x, y);
+		return Context ()->DrawImg (fileName, x, y);
 	}
 
 	bool Canvas::DrawImg (const char *fileName, int x, int y,
 						  unsigned width, unsigned height)
 	{
+		if (IsClippedOut (x, y, x + (int) width, y + (int) height))
+			return true;
+
+		if (auto image = EggAche_Impl::LoadImageFile (fileName))
+		{
+			// Not Cached, as the File is Decoded every time
+			if (image->w != (int) width || image->h != (int) height)
+				image = EggAche_Impl::ScaleImage (*image, (int) width, (int) height);
+			if (!image)
+				return false;
+			this->RecursiveInvalidate ();
+			return Context ()->DrawImg (*image, x, y, (int) width, (int) height);
+		}
+		this->RecursiveInvalidate ();
+		return Context ()->DrawImg (fileName, x, y, width, height);
+	}
+
+	bool Canvas::DrawImg (const Image &image, int x, int y)
+	{
+		return DrawImg (image, x, y, (unsigned) image.Data ()->w, (unsigned) image.Data ()->h);
+	}
+
+	bool Canvas::DrawImg (const Image &image, int x, int y,
+						  unsigned width, unsigned height)
+	{
+		if (IsClippedOut (x, y, x + (int) width, y + (int) height))
+			return true;
+
+		// Stretched Images are Resampled once, and Cached
+		auto scaled = EggAche_Impl::ScaleImageCached (image.Data (),
+													  (int) width, (int) height);
+		if (!scaled)
+			return false;
+		this->RecursiveInvalidate ();
+		return Context ()->DrawImg (*scaled, x, y, (int) width, (int) height);
+	}
+
+	bool Canvas::DrawImg (const Atlas &atlas, size_t id, int x, int y)
+	{
+		if (id >= atlas.data->Count ())
+			return false;
+		const auto &image = atlas.data->Entry (id);
+		return DrawImg (atlas, id, x, y, (unsigned) image->w, (unsigned) image->h);
+	}
+
+	bool Canvas::DrawImg (const Atlas &atlas, size_t id, int x, int y,
+						  unsigned width, unsigned height)
+	{
+		if (id >= atlas.data->Count ())
+			return false;
+		if (IsClippedOut (x, y, x + (int) width, y + (int) height))
+			return true;
+		auto image = EggAche_Impl::ScaleImageCached (atlas.data->Entry (id),
+													 (int) width, (int) height);
+		if (!image)
+			return false;
+		this->RecursiveInvalidate ();
+		return Context ()->DrawImg (*image, x, y, (int) width, (int) height);
+	}
+
+	bool Canvas::DrawImgAsync (const char *fileName, int x, int y)
+	{
+		return DrawImgAsync (EggAche_Impl::LoadImageFileAsync (fileName),
+							 x, y, -1, -1);
+	}
+
+	bool Canvas::DrawImgAsync (const char *fileName, int x, int y,
+							   unsigned width, unsigned height)
+	{
+		// Skip Decoding the Images never Visible
+		if (IsClippedOut (x, y, x + (int) width, y + (int) height))
+			return true;
+		return DrawImgAsync (EggAche_Impl::LoadImageFileAsync (fileName),
+							 x, y, (int) width, (int) height);
+	}
+
+	bool Canvas::DrawImgAsync (const Image &image, int x, int y)
+	{
+		if (!image.IsLoading ())
+			return DrawDecoded (image.pending ? image.pending->Get () : image.data,
+								x, y, -1, -1);
+		return DrawImgAsync (image.pending, x, y, -1, -1);
+	}
+
+	bool Canvas::DrawImgAsync (const Image &image, int x, int y,
+							   unsigned width, unsigned height)
+	{
+		if (IsClippedOut (x, y, x + (int) width, y + (int) height))
+			return true;
+		if (!image.IsLoading ())
+			return DrawDecoded (image.pending ? image.pending->Get () : image.data,
+								x, y, (int) width, (int) height);
+		return DrawImgAsync (image.pending, x, y, (int) width, (int) height);
+	}
+
+	bool Canvas::DrawImgAsync (const std::shared_ptr<EggAche_Impl::PendingImage> &image,
+							   int x, int y, int width, int height)
+	{
+		// Drawn by the next Window.Refresh () after Decoding
+		asyncDraws.push_back (AsyncDraw { image, x, y, width, height, CurrentClip () });
+		return true;
+	}
+
+	bool Canvas::DrawDecoded (const std::shared_ptr<const EggAche_Impl::ImageData> &image,
+							  int x, int y, int width, int height)
+	{
+		if (!image)
+			return false;
+		if (width < 0 || height < 0)
+		{
+			width = image->w;
+			height = image->h;
+		}
+		if (IsClippedOut (x, y, x + width, y + height))
+			return true;
+
+		auto scaled = EggAche_Impl::ScaleImageCached (image, width, height);
+		if (!scaled)
+			return false;
 		this->RecursiveInvalidate ();
-		return context->DrawImg (fileName, x, y, width, height);
+		return Context ()->DrawImg (*scaled, x, y, width, height);
+	}
+
+	void Canvas::RecursiveDrawAsync ()
+	{
+		for (auto it = asyncDraws.begin (); it != asyncDraws.end ();)
+		{
+			if (!it->image->IsDone ())
+			{
+				++it;
+				continue;
+			}
+
+			// Draw in the Clip of DrawImgAsync, and then Restore the current one
+			auto image = it->image->Get ();
+			if (image)
+			{
+				auto clipStackNow = std::move (clipStack);
+				clipStack.assign (1, it->clip);
+				Context ()->SetClip (it->clip);
+				DrawDecoded (image, it->x, it->y, it->width, it->height);
+				clipStack = std::move (clipStackNow);
+				Context ()->SetClip (CurrentClip ());
+			}
+			it = asyncDraws.erase (it);
+		}
+
+		for (auto subCanvas : this->subCanvases)
+			subCanvas->RecursiveDrawAsync ();
 	}
 
 	bool Canvas::DrawImgMask (const char *srcFile,
@@ -295,33 +1145,579 @@ namespace EggAche
 							  unsigned x_src, unsigned y_src,
 							  unsigned x_msk, unsigned y_msk)
 	{
+		if (IsClippedOut (x_pos, y_pos, x_pos + (int) width, y_pos + (int) height))
+			return true;
+
+		auto src = EggAche_Impl::LoadImageFile (srcFile);
+		auto mask = EggAche_Impl::LoadImageFile (maskFile);
 		this->RecursiveInvalidate ();
-		return context->DrawImgMask (srcFile, maskFile,
-									 width, height,
-									 x_pos, y_pos,
-									 x_src, y_src,
-									 x_msk, y_msk);
+		if (src && mask)
+			return Context ()->DrawImgMask (*src, *mask,
+											width, height,
+											x_pos, y_pos,
+											x_src, y_src,
+											x_msk, y_msk);
+		return Context ()->DrawImgMask (srcFile, maskFile,
+										width, height,
+										x_pos, y_pos,
+										x_src, y_src,
+										x_msk, y_msk);
 	}
 
-	bool Canvas::SaveAsJpg (const char * fileName)
+	bool Canvas::DrawImgMask (const Image &src,
+							  const Image &mask,
+							  unsigned width, unsigned height,
+							  int x_pos, int y_pos,
+							  unsigned x_src, unsigned y_src,
+							  unsigned x_msk, unsigned y_msk)
 	{
-		if (!isLatest)
-			this->Buffering ();
-		return buffer->SaveAsJpg (fileName);
+		if (IsClippedOut (x_pos, y_pos, x_pos + (int) width, y_pos + (int) height))
+			return true;
+		this->RecursiveInvalidate ();
+
+		auto sprite = EggAche_Impl::BuildMaskedSpriteCached (
+			src.Data (), (int) x_src, (int) y_src,
+			mask.Data (), (int) x_msk, (int) y_msk, (int) width, (int) height);
+		if (sprite)
+			return Context ()->DrawSprite (*sprite, x_pos, y_pos);
+		return Context ()->DrawImgMask (*src.Data (), *mask.Data (),
+										width, height,
+										x_pos, y_pos,
+										x_src, y_src,
+										x_msk, y_msk);
 	}
 
-	bool Canvas::SaveAsPng (const char * fileName)
+	bool Canvas::Encode (const EggAche_Impl::Rect &rect,
+						 ImageFormat format, unsigned quality,
+						 const EggAche_Impl::ImageWriter &writer, int level)
 	{
-		if (!isLatest)
+		if (format == ImageFormat::Png)
+		{
+			// Bands of 4 MB are Composed and Encoded one after another
+			const auto BAND_PIXELS = 1 << 20, FEW_BANDS = 4;
+			auto rectW = rect.right - rect.left, rectH = rect.bottom - rect.top;
+			auto bandHeight = std::max (BAND_PIXELS / std::max (rectW, 1), 1);
+
+			// A few Bands (or the Buffer) are Composed at once,
+			// and the Colors Counted on the same Pixels as Encoded
+			if (isLatest || rectH <= FEW_BANDS * bandHeight)
+			{
+				return ComposeRegion (rect, rectH, [&] (
+					const EggAche_Impl::GUIContext *context, const EggAche_Impl::Rect &rect)
+				{
+					EggAche_Impl::ColorCensus census;
+					auto isIndexed = context->CountColors (census, rect);
+					EggAche_Impl::PngEncoder png (rectW, rectH, writer,
+												  isIndexed ? &census : nullptr, level);
+					return context->EncodePng (png, rect) && png.Finish ();
+				});
+			}
+
+			// Otherwise, Colors are Counted Band by Band, and once they run
+			// over 256 (in the First Band for Photos), Rgb is Encoded from there;
+			// only if a Band was Counted before (or all are Indexed),
+			// the Bands are Composed again
+			EggAche_Impl::ColorCensus census;
+			std::unique_ptr<EggAche_Impl::PngEncoder> png;
+			auto cCounted = 0;
+			auto isDone = ComposeRegion (rect, bandHeight, [&] (
+				const EggAche_Impl::GUIContext *context, const EggAche_Impl::Rect &band)
+			{
+				if (!png)
+				{
+					if (context->CountColors (census, band))
+					{
+						cCounted++;
+						return true;
+					}
+					png.reset (new EggAche_Impl::PngEncoder (
+						rectW, rectH, writer, nullptr, level));
+					if (cCounted)
+						return false;
+				}
+				return context->EncodePng (*png, band);
+			});
+
+			if (png && (isDone || !cCounted))
+				return isDone && png->Finish ();
+			if (!png)
+				png.reset (new EggAche_Impl::PngEncoder (
+					rectW, rectH, writer, &census, level));
+			return ComposeRegion (rect, bandHeight, [&] (
+				const EggAche_Impl::GUIContext *context, const EggAche_Impl::Rect &band)
+			{
+				return context->EncodePng (*png, band);
+			}) && png->Finish ();
+		}
+
+		return ComposeRegion (rect, rect.bottom - rect.top, [&] (
+			const EggAche_Impl::GUIContext *context, const EggAche_Impl::Rect &rect)
+		{
+			switch (format)
+			{
+			case ImageFormat::Jpg: return context->EncodeJpg (rect, quality, writer);
+			case ImageFormat::Bmp: return context->EncodeBmp (rect, writer);
+			case ImageFormat::Qoi: return context->EncodeQoi (rect, writer);
+			default: return false;
+			}
+		});
+	}
+
+	namespace
+	{
+		EggAche_Impl::ImageWriter FileWriter (std::ofstream &file)
+		{
+			return [&file] (const uint8_t *data, size_t size)
+			{
+				return (bool) file.write ((const char *) data, (std::streamsize) size);
+			};
+		}
+	}
+
+	bool Canvas::SaveAs (const char *fileName, ImageFormat format,
+						 unsigned quality)
+	{
+		std::ofstream file (fileName, std::ios::binary | std::ios::trunc);
+		return file && EncodeTo (format, FileWriter (file), quality) &&
+			file.flush ();
+	}
+
+	bool Canvas::SaveAs (const char *fileName, ImageFormat format,
+						 unsigned quality, int x, int y,
+						 unsigned width, unsigned height)
+	{
+		std::ofstream file (fileName, std::ios::binary | std::ios::trunc);
+		return file && Encode (TrimRect (x, y, width, height),
+							   format, quality, FileWriter (file)) && file.flush ();
+	}
+
+	bool Canvas::EncodeTo (ImageFormat format,
+						   std::function<bool (const uint8_t *, size_t)> writer,
+						   unsigned quality)
+	{
+		// Png is Composed Band by Band, rather than into the Buffer
+		if (!isLatest && format != ImageFormat::Png)
 			this->Buffering ();
-		return buffer->SaveAsPng (fileName);
+		return Encode (EggAche_Impl::Rect { 0, 0, (int) w, (int) h },
+					   format, quality, writer);
+	}
+
+	bool Canvas::EncodeTo (ImageFormat format, std::vector<uint8_t> &out,
+						   unsigned quality)
+	{
+		out.clear ();
+		return EncodeTo (format, [&out] (const uint8_t *data, size_t size)
+		{
+			out.insert (out.end (), data, data + size);
+			return true;
+		}, quality);
+	}
+
+	bool Canvas::SaveAsJpg (const char *fileName, unsigned quality)
+	{
+		return SaveAs (fileName, ImageFormat::Jpg, quality);
+	}
+
+	bool Canvas::SaveAsPng (const char *fileName)
+	{
+		return SaveAs (fileName, ImageFormat::Png, 0);
 	}
 
 	bool Canvas::SaveAsBmp (const char *fileName)
+	{
+		return SaveAs (fileName, ImageFormat::Bmp, 0);
+	}
+
+	bool Canvas::SaveAsQoi (const char *fileName)
+	{
+		return SaveAs (fileName, ImageFormat::Qoi, 0);
+	}
+
+	bool Canvas::SaveAsJpg (const char *fileName, int x, int y,
+							unsigned width, unsigned height, unsigned quality)
+	{
+		return SaveAs (fileName, ImageFormat::Jpg, quality, x, y, width, height);
+	}
+
+	bool Canvas::SaveAsPng (const char *fileName, int x, int y,
+							unsigned width, unsigned height)
+	{
+		return SaveAs (fileName, ImageFormat::Png, 0, x, y, width, height);
+	}
+
+	bool Canvas::SaveAsBmp (const char *fileName, int x, int y,
+							unsigned width, unsigned height)
+	{
+		return SaveAs (fileName, ImageFormat::Bmp, 0, x, y, width, height);
+	}
+
+	bool Canvas::SaveAsQoi (const char *fileName, int x, int y,
+							unsigned width, unsigned height)
+	{
+		return SaveAs (fileName, ImageFormat::Qoi, 0, x, y, width, height);
+	}
+
+	bool Canvas::SaveAsSnapshot (SnapshotLog &log)
 	{
 		if (!isLatest)
 			this->Buffering ();
-		return buffer->SaveAsBmp (fileName);
+		return buffer->SaveAsSnapshot (*log.store,
+			EggAche_Impl::Rect { 0, 0, (int) w, (int) h });
+	}
+
+	bool Canvas::SaveAsSnapshot (SnapshotLog &log, int x, int y,
+								 unsigned width, unsigned height)
+	{
+		auto rect = TrimRect (x, y, width, height);
+		return ComposeRegion (rect, rect.bottom - rect.top, [&] (
+			const EggAche_Impl::GUIContext *context, const EggAche_Impl::Rect &rect)
+		{
+			return context->SaveAsSnapshot (*log.store, rect);
+		});
+	}
+
+	bool Canvas::SaveAsSnapshot (const char *fileName, SnapshotPolicy &policy)
+	{
+		using EggAche_Impl::SnapshotBudget;
+
+		auto start = std::chrono::steady_clock::now ();
+		auto pixels = (long long) w * h;
+		auto mode = policy.budget->Choose (pixels);
+
+		auto format = ImageFormat::Png;
+		std::string path (fileName);
+		switch (mode)
+		{
+		case SnapshotBudget::MODE_BMP: format = ImageFormat::Bmp; path += ".bmp"; break;
+		case SnapshotBudget::MODE_QOI: format = ImageFormat::Qoi; path += ".qoi"; break;
+		default: path += ".png"; break;
+		}
+
+		// Png is Composed Band by Band, rather than into the Buffer
+		if (!isLatest && format != ImageFormat::Png)
+			this->Buffering ();
+		std::ofstream file (path, std::ios::binary | std::ios::trunc);
+		auto isOk = file && Encode (EggAche_Impl::Rect { 0, 0, (int) w, (int) h },
+									format, 0, FileWriter (file),
+									SnapshotBudget::PngLevel (mode)) && file.flush ();
+		file.close ();
+
+		std::chrono::duration<double> elapsed =
+			std::chrono::steady_clock::now () - start;
+		policy.budget->Record (mode, pixels, elapsed.count ());
+		policy.lastFormat = format;
+		return isOk;
+	}
+
+	SpriteSheet::SpriteSheet (const Image &sheet,
+							  unsigned width, unsigned height)
+	{
+		if (!width || !height)
+			throw std::runtime_error ("Err_SpriteSheet_#0_Frame");
+
+		auto cx = sheet.GetWidth () / width, cy = sheet.GetHeight () / height;
+		for (size_t j = 0; j < cy; j++)
+			for (size_t i = 0; i < cx; i++)
+				frames.emplace_back (new Canvas (sheet, width, height,
+												 (unsigned) (i * width),
+												 (unsigned) (j * height)));
+		if (frames.empty ())
+			throw std::runtime_error ("Err_SpriteSheet_#0_Frame");
+	}
+
+	SpriteSheet::SpriteSheet (const Image &sheet, const Image &mask,
+							  unsigned width, unsigned height,
+							  unsigned x_msk, unsigned y_msk)
+	{
+		if (!width || !height)
+			throw std::runtime_error ("Err_SpriteSheet_#0_Frame");
+
+		// Frames whose Masks are out of mask are dropped too
+		auto cx = sheet.GetWidth () / width, cy = sheet.GetHeight () / height;
+		if (mask.GetWidth () >= x_msk && mask.GetHeight () >= y_msk)
+		{
+			cx = std::min (cx, (mask.GetWidth () - x_msk) / width);
+			cy = std::min (cy, (mask.GetHeight () - y_msk) / height);
+		}
+		else
+			cx = cy = 0;
+
+		for (size_t j = 0; j < cy; j++)
+			for (size_t i = 0; i < cx; i++)
+				frames.emplace_back (new Canvas (sheet, mask, width, height,
+												 (unsigned) (i * width),
+												 (unsigned) (j * height),
+												 (unsigned) (x_msk + i * width),
+												 (unsigned) (y_msk + j * height)));
+		if (frames.empty ())
+			throw std::runtime_error ("Err_SpriteSheet_#0_Frame");
+	}
+
+	size_t SpriteSheet::GetFrameCount () const
+	{
+		return frames.size ();
+	}
+
+	Canvas &SpriteSheet::operator[] (size_t index)
+	{
+		return *frames.at (index);
+	}
+
+	// Text Layout Helpers
+
+	namespace
+	{
+		void WrapLines (const char *szText, size_t cch,
+						const int advances[256], size_t width,
+						std::vector<size_t> &lineBegs)
+		{
+			lineBegs.assign (1, 0);
+
+			size_t lineBeg = 0, lineWidth = 0;
+			auto iSpace = cch;				// Last Space in current Line
+			for (size_t i = 0; i < cch; i++)
+			{
+				auto advance = (size_t) advances[(unsigned char) szText[i]];
+				if (lineWidth + advance > width && i > lineBeg)
+				{
+					// Break after the Last Space, or right here
+					lineBeg = iSpace < cch ? iSpace + 1 : i;
+					lineBegs.push_back (lineBeg);
+
+					lineWidth = 0;
+					for (auto j = lineBeg; j < i; j++)
+						lineWidth += advances[(unsigned char) szText[j]];
+					iSpace = cch;
+				}
+
+				if (szText[i] == ' ')
+					iSpace = i;
+				lineWidth += advance;
+			}
+		}
+	}
+
+	// Text Layout
+
+	TextLayout::TextLayout (size_t width, size_t lineHeight)
+		: isLineCountDirty (true), width (width), lineHeight (lineHeight),
+		fontGeneration (0)
+	{
+		std::fill (advances, advances + 256, 0);
+	}
+
+	void TextLayout::SetWidth (size_t width)
+	{
+		if (this->width == width)
+			return;
+
+		this->width = width;
+		for (auto &paragraph : paragraphs)
+			paragraph.isDirty = true;
+		isLineCountDirty = true;
+	}
+
+	size_t TextLayout::GetParagraphCount () const
+	{
+		return paragraphs.size ();
+	}
+
+	const std::string &TextLayout::GetParagraph (size_t index) const
+	{
+		return paragraphs[index].text;
+	}
+
+	void TextLayout::SetParagraph (size_t index, const std::string &text)
+	{
+		if (index >= paragraphs.size ())
+			return this->AppendParagraph (text);
+
+		paragraphs[index].text = text;
+		paragraphs[index].isDirty = true;
+		isLineCountDirty = true;
+	}
+
+	void TextLayout::InsertParagraph (size_t index, const std::string &text)
+	{
+		index = std::min (index, paragraphs.size ());
+		paragraphs.insert (paragraphs.begin () + index,
+						   Paragraph { text, {}, true });
+		isLineCountDirty = true;
+	}
+
+	void TextLayout::AppendParagraph (const std::string &text)
+	{
+		this->InsertParagraph (paragraphs.size (), text);
+	}
+
+	void TextLayout::EraseParagraph (size_t index)
+	{
+		if (index >= paragraphs.size ())
+			return;
+
+		paragraphs.erase (paragraphs.begin () + index);
+		isLineCountDirty = true;
+	}
+
+	void TextLayout::Layout (Canvas &canvas)
+	{
+		// Font of canvas (or canvas itself) may be changed since Last Layout,
+		// but Lines are Wrapped again only if the Advances are changed
+		const int *newAdvances;
+		if (canvas.fontGeneration != fontGeneration &&
+			(newAdvances = canvas.Advances ()))
+		{
+			fontGeneration = canvas.fontGeneration;
+			if (!std::equal (newAdvances, newAdvances + 256, advances))
+			{
+				std::copy (newAdvances, newAdvances + 256, advances);
+				for (auto &paragraph : paragraphs)
+					paragraph.isDirty = true;
+				isLineCountDirty = true;
+			}
+		}
+
+		if (!isLineCountDirty)
+			return;
+
+		// Only the Dirty Paragraphs are Wrapped again
+		firstLines.resize (paragraphs.size () + 1);
+		size_t cLine = 0;
+		for (size_t i = 0; i < paragraphs.size (); i++)
+		{
+			auto &paragraph = paragraphs[i];
+			if (paragraph.isDirty)
+			{
+				WrapLines (paragraph.text.c_str (), paragraph.text.size (),
+						   advances, width, paragraph.lineBegs);
+				paragraph.isDirty = false;
+			}
+			firstLines[i] = cLine;
+			cLine += paragraph.lineBegs.size ();
+		}
+		firstLines[paragraphs.size ()] = cLine;
+		isLineCountDirty = false;
+	}
+
+	size_t TextLayout::GetLineCount (Canvas &canvas)
+	{
+		this->Layout (canvas);
+		return firstLines.back ();
+	}
+
+	std::pair<size_t, size_t> TextLayout::Locate (Canvas &canvas,
+												  size_t index,
+												  size_t offset)
+	{
+		this->Layout (canvas);
+		if (index >= paragraphs.size ())
+			return std::make_pair ((size_t) 0, firstLines.back ());
+
+		const auto &paragraph = paragraphs[index];
+		offset = std::min (offset, paragraph.text.size ());
+
+		auto iLine = (size_t) (std::upper_bound (paragraph.lineBegs.begin (),
+												 paragraph.lineBegs.end (),
+												 offset) -
+							   paragraph.lineBegs.begin ()) - 1;
+		size_t x = 0;
+		for (auto i = paragraph.lineBegs[iLine]; i < offset; i++)
+			x += advances[(unsigned char) paragraph.text[i]];
+
+		return std::make_pair (x, firstLines[index] + iLine);
+	}
+
+	bool TextLayout::Draw (Canvas &canvas, int x, int y,
+						   size_t firstLine, size_t cLine)
+	{
+		this->Layout (canvas);
+
+		auto lastLine = std::min (firstLines.back (),
+								  firstLine + std::min (cLine, firstLines.back ()));
+		if (firstLine >= lastLine)
+			return true;
+
+		// Find the Paragraph of firstLine
+		auto index = (size_t) (std::upper_bound (firstLines.begin (),
+												 firstLines.end () - 1,
+												 firstLine) -
+							   firstLines.begin ()) - 1;
+
+		auto ret = true;
+		std::string strLine;
+		for (auto iLine = firstLine; iLine < lastLine; index++)
+		{
+			const auto &paragraph = paragraphs[index];
+			const auto &lineBegs = paragraph.lineBegs;
+			for (auto i = iLine - firstLines[index];
+				 i < lineBegs.size () && iLine < lastLine; i++, iLine++)
+			{
+				auto lineEnd = i + 1 < lineBegs.size () ?
+					lineBegs[i + 1] : paragraph.text.size ();
+				strLine.assign (paragraph.text, lineBegs[i], lineEnd - lineBegs[i]);
+
+				auto yLine = y + (int) ((iLine - firstLine) * lineHeight);
+				if (!canvas.DrawTxt (x, yLine, strLine.c_str ()))
+					ret = false;
+			}
+		}
+		return ret;
+	}
+
+	// Console
+
+	Console::Console (size_t width, size_t height,
+					  int pos_x, int pos_y, size_t lineHeight)
+		: Canvas (width, height, pos_x, pos_y),
+		width (width), height (height),
+		lineHeight (std::max (lineHeight, (size_t) 1)), cLine (0)
+	{}
+
+	bool Console::AppendLine (const char *szText)
+	{
+		auto advances = this->Advances ();
+		if (!advances)
+			return false;
+
+		std::vector<size_t> lineBegs;
+		auto cch = strlen (szText);
+		WrapLines (szText, cch, advances, width, lineBegs);
+
+		auto cRow = std::max (height / lineHeight, (size_t) 1);
+		auto cNew = lineBegs.size ();
+
+		// Only the Lines that will be shown are Drawn
+		auto iFirst = cNew > cRow ? cNew - cRow : 0;
+		auto cShown = cNew - iFirst;
+
+		// Scroll the Old Lines up once for all the New Lines
+		if (cLine + cShown > cRow)
+		{
+			auto cOverflow = cLine + cShown - cRow;
+			if (cOverflow >= cLine)
+				this->Clear ();
+			else
+				this->Scroll (0, -(int) (cOverflow * lineHeight));
+			cLine -= std::min (cOverflow, cLine);
+		}
+
+		auto ret = true;
+		std::string strLine;
+		for (auto i = iFirst; i < cNew; i++)
+		{
+			auto lineEnd = i + 1 < cNew ? lineBegs[i + 1] : cch;
+			strLine.assign (szText + lineBegs[i], lineEnd - lineBegs[i]);
+			if (!this->DrawTxt (0, (int) (cLine * lineHeight), strLine.c_str ()))
+				ret = false;
+			cLine++;
+		}
+		return ret;
+	}
+
+	void Console::ClearLines ()
+	{
+		this->Clear ();
+		cLine = 0;
 	}
 
 	void MsgBox (const char *szTxt, const char *szCap)
@@ -12,7 +12,10 @@
 #include <functional>
 #include <memory>
 #include <list>
+#include <vector>
+#include <string>
 #include "EggAche_Impl.h"
+#include "EggAche_Raster.h"
 
 namespace EggAche
 {
@@ -38,6 +41,8 @@ namespace EggAche
 		// 2. Why NO Auto Refresh?
 		//    Auto Refresh will cost much more resource if there are too many
 		//    drawing changes at a time...
+		// 3. Images of Canvas.DrawImgAsync Decoded since the last Refresh
+		//    are Drawn before Rendering;
 
 		bool IsClosed () const;								// Is Window closed
 		// Remarks:
@@ -70,13 +75,287 @@ namespace EggAche
 	private:
 		std::unique_ptr<EggAche_Impl::WindowImpl> windowImpl;	// Window Impl Bridge
 		Canvas *bgCanvas;										// Background Canvas
+		unsigned long asyncGeneration;							// Decoded Images Drawn
 
 		Window (const Window &) = delete;					// Not allow to copy
 		void operator= (const Window &) = delete;			// Not allow to copy
 	};
 
+	//===========================Style============================
+
+	class Pen
+	{
+	public:
+		Pen (unsigned width = 1,							// Pen Width
+			 unsigned r = 0,								// Pen Color
+			 unsigned g = 0,
+			 unsigned b = 0);
+
+		bool operator== (const Pen &pen) const { return style == pen.style; }
+		bool operator!= (const Pen &pen) const { return style != pen.style; }
+		size_t Hash () const { return (size_t) style; }
+
+	private:
+		const EggAche_Impl::PenStyle *style;				// Interned Style
+		friend class Canvas;
+	};
+
+	class Brush
+	{
+	public:
+		Brush (bool isTransparent = true,					// Is Transparent
+			   unsigned r = 0,								// Brush Color
+			   unsigned g = 0,
+			   unsigned b = 0);
+
+		bool operator== (const Brush &brush) const { return style == brush.style; }
+		bool operator!= (const Brush &brush) const { return style != brush.style; }
+		size_t Hash () const { return (size_t) style; }
+
+	private:
+		const EggAche_Impl::BrushStyle *style;				// Interned Style
+		friend class Canvas;
+	};
+
+	class Font
+	{
+	public:
+		Font (unsigned size = 18,							// Font Size
+			  const char *family = "Consolas",				// Font Family
+			  unsigned r = 0,								// Font Color
+			  unsigned g = 0,
+			  unsigned b = 0);
+
+		bool operator== (const Font &font) const { return style == font.style; }
+		bool operator!= (const Font &font) const { return style != font.style; }
+		size_t Hash () const { return (size_t) style; }
+
+	private:
+		const EggAche_Impl::FontStyle *style;				// Interned Style
+		friend class Canvas;
+	};
+
+	struct Style
+	{
+		Pen pen;
+		Brush brush;
+		Font font;
+	};
+	// Remarks:
+	// 1. Pen, Brush and Font are Immutable, and Equal ones share a single
+	//    Process-wide Object, so Comparing and Hashing them is Cheap;
+	// 2. Create them once (e.g. out of the Drawing Loop), and Switch among them
+	//    by Canvas.SetStyle () without Creating any GDI Object;
+	// 3. The Objects are kept until Exit, so don't Create one for each Frame
+	//    of Animated Colors (use Canvas.SetPen () and so on instead);
+
+	//============================Path============================
+
+	enum class FillRule
+	{
+		EvenOdd,											// Inside if crossed Odd times
+		NonZero												// Inside if Winding Number != 0
+	};
+
+	class Path
+	{
+	public:
+		Path ();
+
+		void MoveTo (int x, int y);							// Begin a new Sub Path
+		void LineTo (int x, int y);
+		void QuadTo (int xCtrl, int yCtrl,					// Quadratic Bezier Curve
+					 int x, int y);
+		void CubicTo (int xCtrl1, int yCtrl1,				// Cubic Bezier Curve
+					  int xCtrl2, int yCtrl2,
+					  int x, int y);
+		void Close ();										// Close current Sub Path
+		// Remarks:
+		// 1. LineTo/QuadTo/CubicTo start from the Last Point,
+		//    or (0, 0) if there is no Point yet;
+		//    After Close, a new Sub Path starts from the Closed one's Start Point;
+		// 2. Curves are flattened into Lines when added, so a Path
+		//    can be drawn many times without being flattened again;
+
+		void Clear ();										// Remove all Sub Paths
+
+	private:
+		std::vector<EggAche_Impl::Contour> contours;		// Flattened Sub Paths
+		std::vector<bool> closed;							// Is Sub Path closed
+		void Continue ();									// Open a Sub Path to Add to
+		friend class Canvas;
+	};
+
+	//===========================Image============================
+
+	class Image
+	{
+	public:
+		Image (const char *fileName);						// Source: "path/*.bmp|png|jpg"
+		// Remarks:
+		// 1. Decode the File once, and Draw it by Canvas.DrawImg many times;
+		// 2. Support Bitmap, PNG, Baseline JPEG (not Progressive) and QOI files;
+		// 3. 32-bit Bitmaps are Drawn right from the Mapped File without Copying;
+		// 4. Copying an Image only shares the Decoded Pixels;
+		// 5. When an error occurs, throw std::runtime_error
+
+		static Image LoadAsync (const char *fileName);		// Source: "path/*.bmp|png|jpg"
+		// Remarks:
+		// 1. Return at once, and Decode the File on a Background Thread;
+		// 2. Using the Image (except by Canvas.DrawImgAsync and IsLoading)
+		//    waits for the Decoding;
+		// 3. If the Decoding Failed, the first Use throws std::runtime_error
+
+		bool IsLoading () const;							// Is still Decoding
+
+		size_t GetWidth () const;
+		size_t GetHeight () const;
+
+	private:
+		Image () {}
+		mutable std::shared_ptr<const EggAche_Impl::ImageData> data;
+		mutable std::shared_ptr<EggAche_Impl::PendingImage> pending;
+		const std::shared_ptr<const EggAche_Impl::ImageData> &Data () const;
+		friend class Canvas;
+		friend class Atlas;
+		friend class AssetPack;
+		friend class SnapshotLog;
+	};
+
+	//===========================Atlas============================
+
+	class Atlas
+	{
+	public:
+		Atlas (size_t pageWidth = 1024,						// Size of each Page
+			   size_t pageHeight = 1024);
+
+		Atlas (const char *fileName);						// Saved Atlas: "path/*.atlas"
+		// Remarks:
+		// 1. Loading a Saved Atlas maps the File, and Draws its Pages
+		//    without Decoding or Copying;
+		// 2. When an error occurs, throw std::runtime_error
+
+		size_t Add (const Image &image);					// Return the id
+		size_t Add (const char *fileName);					// Source: "path/*.bmp|png|jpg"
+		void Add (const char *const *fileNames,				// Sources
+				  size_t count,								// Count of Sources
+				  size_t *ids);								// Output ids
+		// Remarks:
+		// 1. Images are Packed (Skyline, Bottom-left) into a few large Pages,
+		//    instead of a Bitmap for each;
+		// 2. Adding many at once Packs them tighter (Taller ones first);
+		// 3. Images larger than a Page get a Page of their own;
+		// 4. Images added after Loading go to new Pages;
+		// 5. When a File can't be Decoded, throw std::runtime_error
+
+		size_t GetCount () const;
+		size_t GetPageCount () const;
+		size_t GetWidth (size_t id) const;
+		size_t GetHeight (size_t id) const;
+
+		bool Save (const char *fileName) const;				// "path/*.atlas"
+		// Remarks:
+		// Save the Pages (Raw Pixels) with the Index into a single File;
+
+	private:
+		std::unique_ptr<EggAche_Impl::AtlasData> data;
+		friend class Canvas;
+
+		Atlas (const Atlas &) = delete;						// Not allow to copy
+		void operator= (const Atlas &) = delete;			// Not allow to copy
+	};
+
+	//=========================Asset Pack=========================
+
+	class AssetPack
+	{
+	public:
+		AssetPack (const char *fileName);					// Packed: "path/*.pack"
+		// Remarks:
+		// 1. Map the File made by Tools/PackAssets, and read only its Index,
+		//    so Opening costs no Decoding nor any File but this;
+		// 2. When an error occurs, throw std::runtime_error
+
+		bool Has (const char *name) const;					// Name as Packed
+		Image Get (const char *name) const;					// Name as Packed
+		// Remarks:
+		// 1. Names are the Paths given to the Packer, like "Assets/Egg.bmp",
+		//    matched with either '/' or '\\' as the Separator;
+		// 2. Images are Views of the Mapped Pixels, Drawn without Copying;
+		// 3. When name is not in the Pack, Get throws std::runtime_error
+
+		size_t GetCount () const;
+
+	private:
+		std::unique_ptr<EggAche_Impl::AssetPackData> data;
+
+		AssetPack (const AssetPack &) = delete;				// Not allow to copy
+		void operator= (const AssetPack &) = delete;		// Not allow to copy
+	};
+
+	//========================Snapshot Log========================
+
+	class SnapshotLog
+	{
+	public:
+		SnapshotLog (const char *fileName);					// Log: "path/*.snap"
+		// Remarks:
+		// 1. Create the File, or Open an existing Log to Append to;
+		// 2. Frames Saved by Canvas.SaveAsSnapshot are Split into 64 * 64 Tiles,
+		//    and only the Tiles not Logged before are Written (Lossless, in QOI),
+		//    with a small Manifest of each Frame;
+		// 3. So nearly unchanged Frames cost little Storage and Writing;
+		// 4. When an error occurs, throw std::runtime_error
+
+		size_t GetFrameCount () const;
+		size_t GetTileCount () const;						// Distinct Tiles Written
+
+		Image GetFrame (size_t index) const;				// Rebuild Frame from Tiles
+		// Remarks:
+		// When index is out of range or the Log is broken, throw std::runtime_error
+
+	private:
+		std::unique_ptr<EggAche_Impl::SnapshotStore> store;
+		friend class Canvas;
+
+		SnapshotLog (const SnapshotLog &) = delete;			// Not allow to copy
+		void operator= (const SnapshotLog &) = delete;		// Not allow to copy
+	};
+
 	//===========================Canvas===========================
 
+	enum class ImageFormat
+	{
+		Jpg, Png, Bmp, Qoi
+	};
+
+	class SnapshotPolicy
+	{
+	public:
+		SnapshotPolicy (unsigned budgetMs = 20);			// Time a Snapshot may take
+		// Remarks:
+		// 1. Canvas.SaveAsSnapshot (fileName, policy) Saves in the Smallest of
+		//    Bmp, Qoi and Png (Level 1/3/6/9) Expected to be Done in budgetMs,
+		//    by the Speed each was Measured at in the recent Frames;
+		// 2. It Starts from Bmp and Steps up a Format a Frame at most,
+		//    but Drops at once when a Frame runs over;
+		// 3. Use one Policy for each Producer (NOT Thread-safe);
+
+		void SetBudget (unsigned budgetMs);					// e.g. Tighter in Bursts
+		unsigned GetBudget () const;
+
+		ImageFormat GetLastFormat () const;					// Format last Saved in
+
+	private:
+		std::unique_ptr<EggAche_Impl::SnapshotBudget> budget;
+		ImageFormat lastFormat;
+		friend class Canvas;
+
+		SnapshotPolicy (const SnapshotPolicy &) = delete;	// Not allow to copy
+		void operator= (const SnapshotPolicy &) = delete;	// Not allow to copy
+	};
+
 	class Canvas
 	{
 	public:
@@ -85,6 +364,26 @@ namespace EggAche
 		   // Remarks:
 		   // When an error occurs, throw std::runtime_error
 
+		Canvas (const Image &sheet,							// Sheet to View
+				unsigned width, unsigned height,			// Size of the Frame
+				unsigned x_src, unsigned y_src,				// Position in sheet
+				int pos_x = 0, int pos_y = 0);				// Canvas' initial postion
+
+		Canvas (const Image &sheet,							// Sheet to View
+				const Image &mask,							// Mask of sheet
+				unsigned width, unsigned height,			// Size of the Frame
+				unsigned x_src, unsigned y_src,				// Position in sheet
+				unsigned x_msk, unsigned y_msk,				// Position in mask
+				int pos_x = 0, int pos_y = 0);				// Canvas' initial postion
+		// Remarks:
+		// 1. The Canvas is a View of a Frame of sheet, sharing its Pixels
+		//    without a Bitmap of its own;
+		// 2. It's Composited like other Canvases (by mask as DrawImgMask),
+		//    and the mask is Split into Runs only once here;
+		// 3. Drawing on it copies the Frame into its own Bitmap first,
+		//    which looks the same (Transparent Color included) as the View;
+		// 4. When the Frame is out of sheet, throw std::runtime_error
+
 		void Buffering ();									// Buffering Canvas and Sub Canvases
 		// Remarks:
 		// Buffer this Canvas and its Sub Canvases, for Window.Refresh ();
@@ -115,11 +414,37 @@ namespace EggAche
 					  unsigned g = 0,
 					  unsigned b = 0);
 		// Remarks:
-		// If SetBrush's isTransparent is set, the Color will be ignored
+		// 1. If SetBrush's isTransparent is set, the Color will be ignored;
+		// 2. Family "Bitmap" is the Built-in Font (Fixed-Width, Sharpest at
+		//    Size 8, 16, 24 and 32), which needs no Font installed;
+		// 3. Unlike Pen, Brush and Font, the Colors are not Interned,
+		//    so Animating them takes no Memory; an Equal Pen / Brush
+		//    Created before shares its GDI Object;
+
+		bool SetStyle (const Style &style);					// Set all the Three
+		bool SetStyle (const Pen &pen);
+		bool SetStyle (const Brush &brush);
+		bool SetStyle (const Font &font);
+		// Remarks:
+		// Switching to an already used Style is only a Pointer Swap;
 
 		void Clear ();										// Clear the Canvas
 		// Remarks:
-		// Erase the content in Canvas
+		// Erase the content in Canvas (inside the current Clip)
+
+		bool Scroll (int scale_x, int scale_y);				// Scroll the Content
+		// Remarks:
+		// 1. Shift the Pixels inside the current Clip by (scale_x, scale_y),
+		//    and Erase the Vacated Part;
+		// 2. Much Cheaper than Clearing and Drawing all the Content again;
+
+		void PushClip (int xBeg, int yBeg, int xEnd, int yEnd);	// Restrict Drawing
+		void PopClip ();										// Restore previous Clip
+		// Remarks:
+		// 1. Drawing is restricted inside the Rectangle (xBeg, yBeg)-(xEnd, yEnd)
+		//    intersected with the current Clip, until the matching PopClip ();
+		// 2. All the Drawing (including Clear) only touches Pixels inside the Clip;
+		// 3. Shapes completely outside the Clip are skipped before Rasterization;
 
 		bool DrawTxt (int xBeg, int yBeg, const char *szText);
 		// Remarks:
@@ -130,6 +455,13 @@ namespace EggAche
 		// Return the Estimated Width of the String in Current Font;
 		// Return 0 if an Error occurs;
 
+		bool MeasureTexts (const char *const *texts,		// Texts to Measure
+						   size_t count,					// Count of Texts
+						   size_t *widths);					// Output Widths
+		// Remarks:
+		// 1. Estimate the Width of count Texts at once into widths;
+		// 2. Prefer this to GetTxtWidth in a Loop when Laying out many Labels;
+
 		bool DrawImg (const char *fileName,					// Source: "path/*.bmp"
 					  int x, int y);						// Position to paste in Canvas
 
@@ -137,8 +469,52 @@ namespace EggAche
 					  int x, int y,							// Position to paste in Canvas
 					  unsigned width, unsigned height);		// Size to paste in Canvas
 		// Remarks:
-		// 1. The Bitmap file will be stretched into width * height in Canvas;
-		// 2. Only Support Bitmap (.bmp) file... currently
+		// 1. The Image will be stretched into width * height in Canvas,
+		//    by Bilinear (Enlarging) or Box Filter (Shrinking);
+		// 2. Support Bitmap (.bmp), PNG (.png) and Baseline JPEG (.jpg) files;
+		// 3. Prefer the Image versions for Images Drawn more than once;
+
+		bool DrawImg (const Image &image,					// Decoded Image
+					  int x, int y);						// Position to paste in Canvas
+
+		bool DrawImg (const Image &image,					// Decoded Image
+					  int x, int y,							// Position to paste in Canvas
+					  unsigned width, unsigned height);		// Size to paste in Canvas
+		// Remarks:
+		// The Stretched Copies of the Latest Sizes are Cached,
+		// so Drawing the same Size again costs no Resampling;
+
+		bool DrawImg (const Atlas &atlas,					// Packed Images
+					  size_t id,							// Image id in atlas
+					  int x, int y);						// Position to paste in Canvas
+
+		bool DrawImg (const Atlas &atlas,					// Packed Images
+					  size_t id,							// Image id in atlas
+					  int x, int y,							// Position to paste in Canvas
+					  unsigned width, unsigned height);		// Size to paste in Canvas
+		// Remarks:
+		// Return false if id is not in atlas;
+
+		bool DrawImgAsync (const char *fileName,			// Source: "path/*.bmp|png|jpg"
+						   int x, int y);					// Position to paste in Canvas
+
+		bool DrawImgAsync (const char *fileName,			// Source: "path/*.bmp|png|jpg"
+						   int x, int y,					// Position to paste in Canvas
+						   unsigned width, unsigned height);// Size to paste in Canvas
+
+		bool DrawImgAsync (const Image &image,				// Image maybe still Loading
+						   int x, int y);					// Position to paste in Canvas
+
+		bool DrawImgAsync (const Image &image,				// Image maybe still Loading
+						   int x, int y,					// Position to paste in Canvas
+						   unsigned width, unsigned height);// Size to paste in Canvas
+		// Remarks:
+		// 1. Draw at once if the Image is Loaded; Otherwise Draw nothing,
+		//    and Decode the File on a Background Thread;
+		// 2. The next Window.Refresh () after Decoding Draws the Image
+		//    (in the Clip of now) over what's Drawn meanwhile;
+		// 3. Clear () drops the Images not Drawn yet;
+		// 4. Return false only if the Image is Loaded and Failed;
 
 		bool DrawImgMask (const char *srcFile,				// Source: "path/*.bmp"
 						  const char *maskFile,				// Mask: "path/*.bmp"
@@ -150,6 +526,17 @@ namespace EggAche
 		// 1. The Bitmap file will NOT be stretched;
 		// 2. The Mask is usually Black (foreground) and White (background)
 
+		bool DrawImgMask (const Image &src,					// Decoded Source
+						  const Image &mask,				// Decoded Mask
+						  unsigned width, unsigned height,	// Size of the part to Draw
+						  int x_pos, int y_pos,				// Position to paste in Canvas
+						  unsigned x_src, unsigned y_src,	// Position in src
+						  unsigned x_msk, unsigned y_msk);	// Position in mask
+		// Remarks:
+		// 1. The Parts of src and mask are Split into Runs once, and kept
+		//    for the next Draws of the same Parts;
+		// 2. The Background under White Mask and Black Source is not Touched;
+
 		bool DrawLine (int xBeg, int yBeg, int xEnd, int yEnd);
 		// Remarks:
 		// Draw a Line from (xBeg, yBeg) to (xEnd, yEnd);
@@ -204,19 +591,129 @@ namespace EggAche
 		// Positive 'cAngle' indicates counterclockwise motion, and Negative clockwise;
 		// The Pie is closed by drawing 2 Radius of the Angles;
 
-		bool SaveAsJpg (const char *fileName);				// "path/*.jpg"
+		bool DrawPolygon (const std::vector<std::pair<int, int>> &points,
+						  FillRule fillRule = FillRule::EvenOdd);
+		// Remarks:
+		// 1. Connect the points and the last one to the first one with the Pen,
+		//    and Fill the inside with the Brush;
+		// 2. Thousands of points are filled by a single Scanline Pass;
+
+		bool DrawPolyline (const std::vector<std::pair<int, int>> &points);
+		// Remarks:
+		// Connect the points one by one with the Pen (NOT Closed or Filled);
+
+		bool DrawPath (const Path &path,
+					   FillRule fillRule = FillRule::EvenOdd);
+		// Remarks:
+		// 1. Fill all the Sub Paths (closed implicitly) with the Brush
+		//    by fillRule, then Stroke them with the Pen;
+		// 2. Only the Sub Paths ended with Close () are stroked as closed;
+
+		bool SaveAsJpg (const char *fileName,				// "path/*.jpg"
+						unsigned quality = 85);				// 1 - 100
 		bool SaveAsPng (const char *fileName);				// "path/*.png"
 		bool SaveAsBmp (const char *fileName);				// "path/*.bmp"
+		bool SaveAsQoi (const char *fileName);				// "path/*.qoi"
+		// Remarks:
+		// 1. Save Canvas' Content into a .jpg/.png/.bmp/.qoi File;
+		// 2. Performance: qoi = bmp > jpg >> png;
+		// 3. Size: bmp >> qoi > png > jpg (for Photos);
+		// 4. Jpg is Encoded portably (Baseline, SIMD DCT), Chroma Subsampled
+		//    below quality 90;
+		// 5. Qoi is Lossless, and fast enough to Log every Frame;
+		// 6. Png is Composed and Encoded in Bands of Rows (if not Buffered),
+		//    so Huge Canvases take only a few MB more; up to 4M Pixels are
+		//    Composed once, and Counted and Encoded on the same Pixels;
+		// 7. Png of at most 256 Colors (as Charts) is Indexed in 1/2/4/8 bpp,
+		//    several times smaller and faster than RGB;
+		// 8. Png is Deflated at zlib's Level 6 (Lazy Matching, SIMD Checksums),
+		//    see Tools/PngBench.cpp for its Speed and Ratio;
+
+		bool SaveAsJpg (const char *fileName,				// "path/*.jpg"
+						int x, int y,						// Left-top of the Rect
+						unsigned width, unsigned height,	// Size of the Rect
+						unsigned quality = 85);				// 1 - 100
+		bool SaveAsPng (const char *fileName,				// "path/*.png"
+						int x, int y,
+						unsigned width, unsigned height);
+		bool SaveAsBmp (const char *fileName,				// "path/*.bmp"
+						int x, int y,
+						unsigned width, unsigned height);
+		bool SaveAsQoi (const char *fileName,				// "path/*.qoi"
+						int x, int y,
+						unsigned width, unsigned height);
 		// Remarks:
-		// 1. Save Canvas' Content into a .jpg/.png/.bmp File;
-		// 2. Performance: bmp = jpg >> png;
-		// 3. Size: bmp >> jpg > png;
-		// 4. Windows MinGW Version doesn't Support Jpg...
+		// 1. Save only the Rect of Canvas' Content (trimmed by the Canvas),
+		//    and return false if nothing is left;
+		// 2. If the Canvas is not Buffered, only the Sub Canvases
+		//    across the Rect are Composed (and the Buffer is left as is);
+
+		bool SaveAsSnapshot (SnapshotLog &log);				// Append a Frame to log
+		bool SaveAsSnapshot (SnapshotLog &log,
+							 int x, int y,					// Left-top of the Rect
+							 unsigned width, unsigned height);	// Size of the Rect
+		// Remarks:
+		// Only the Tiles not in log yet are Written, so it's much cheaper
+		// than other SaveAs* for Graphical Logs of nearly unchanged Frames;
+
+		bool SaveAsSnapshot (const char *fileName,			// "path/*" (Extension
+							 SnapshotPolicy &policy);		// of the Format Appended)
+		// Remarks:
+		// 1. Save as .bmp/.qoi/.png, whichever policy Expects to fit its Budget,
+		//    instead of a Format fixed at each Call;
+		// 2. The Time taken (Composing and Writing included) is Measured
+		//    into policy, for the next Frames;
+
+		bool EncodeTo (ImageFormat format,					// Format to Encode
+					   std::vector<uint8_t> &out,			// Encoded File Bytes
+					   unsigned quality = 85);				// 1 - 100 (Jpg)
+		bool EncodeTo (ImageFormat format,					// Format to Encode
+					   std::function<bool (					// Called with each
+						   const uint8_t *data,				// Chunk of the File,
+						   size_t size)> writer,			// false to Stop
+					   unsigned quality = 85);				// 1 - 100 (Jpg)
+		// Remarks:
+		// 1. Encode Canvas' Content as SaveAs* does, but into Memory
+		//    (out is Replaced) or to writer, instead of a File;
+		// 2. Bmp and Png are Written as they are Encoded,
+		//    and the others in a single Chunk;
+		// 3. Return false if Encoding fails, or writer returns false;
 
 	private:
 		int x, y; size_t w, h;								// Postion and Size
 		std::unique_ptr<EggAche_Impl::GUIContext> context;	// GUI Impl Bridge
 
+		std::shared_ptr<const EggAche_Impl::ImageData> frame;	// Viewed Frame
+		std::shared_ptr<const EggAche_Impl::MaskedSprite> frameSprite;
+		EggAche_Impl::GUIContext *Context ();				// Bitmap to Draw on
+
+		std::vector<EggAche_Impl::Rect> clipStack;			// Nested Clips
+		EggAche_Impl::Rect CurrentClip () const;
+
+		struct AsyncDraw									// Image to Draw
+		{													// after Decoding
+			std::shared_ptr<EggAche_Impl::PendingImage> image;
+			int x, y, width, height;						// -1 as Image's Size
+			EggAche_Impl::Rect clip;
+		};
+		std::list<AsyncDraw> asyncDraws;
+		bool DrawImgAsync (const std::shared_ptr<EggAche_Impl::PendingImage> &,
+						   int, int, int, int);
+		bool DrawDecoded (const std::shared_ptr<				// Draw at Size given,
+						  const EggAche_Impl::ImageData> &,	// or -1 as Image's
+						  int, int, int, int);
+		void RecursiveDrawAsync ();							// Draw Decoded Images
+		unsigned penWidth, fontSize;						// For Clip Rejection
+		bool IsClippedOut (int xBeg, int yBeg,				// Is Bounding Box
+						   int xEnd, int yEnd) const;		// out of Clip
+
+		unsigned long fontGeneration;						// Changed with the Font
+		unsigned long advancesGeneration;					// Font of advances
+		int advances[256];									// Advances of Characters
+		const int *Advances ();								// Measured once a Font
+		friend class TextLayout;
+		friend class Console;
+
 		std::list<Canvas *> subCanvases;				// Sub Canvases
 		std::list<Canvas *> parCanvases;				// Parent Canvases
 
@@ -224,7 +721,21 @@ namespace EggAche
 		std::unique_ptr<EggAche_Impl::GUIContext> buffer;	// Buffer with White Bg
 
 		void RecursiveDraw (EggAche_Impl::GUIContext *,		// Helper Function of
-							size_t, size_t) const;			// Buffering
+							size_t, size_t,					// Buffering, Skipping
+							const EggAche_Impl::Rect &) const;	// Canvases out of Rect
+		EggAche_Impl::Rect TrimRect (int, int,				// Rect trimmed
+									 unsigned, unsigned) const;	// by the Canvas
+		bool ComposeRegion (const EggAche_Impl::Rect &, int,	// Pass Rect of Buffer,
+							std::function<bool (			// or Bands of the Height
+								const EggAche_Impl::GUIContext *,	// Composed
+								const EggAche_Impl::Rect &)>);	// one by one
+		bool Encode (const EggAche_Impl::Rect &,			// Encode Rect
+					 ImageFormat, unsigned,					// of the Canvas
+					 const EggAche_Impl::ImageWriter &,		// (Png Deflated
+					 int = 6);								// at the Level)
+		bool SaveAs (const char *, ImageFormat, unsigned);	// Encode into a File
+		bool SaveAs (const char *, ImageFormat, unsigned,	// Encode Rect
+					 int, int, unsigned, unsigned);			// into a File
 		void RecursiveInvalidate ();
 		friend bool Window::Refresh ();
 
@@ -232,6 +743,110 @@ namespace EggAche
 		void operator= (const Canvas &) = delete;			// Not allow to copy
 	};
 
+	//=========================Sprite Sheet=======================
+
+	class SpriteSheet
+	{
+	public:
+		SpriteSheet (const Image &sheet,					// Sheet of Frames
+					 unsigned width, unsigned height);		// Size of each Frame
+
+		SpriteSheet (const Image &sheet,					// Sheet of Frames
+					 const Image &mask,						// Mask of sheet
+					 unsigned width, unsigned height,		// Size of each Frame
+					 unsigned x_msk, unsigned y_msk);		// Position of the Masks
+		// Remarks:
+		// 1. Frames are cut from sheet Row by Row, from Left to Right;
+		// 2. Each Frame is a Canvas Viewing sheet (see Canvas' Remarks),
+		//    so the Cost grows with the Sheet, not Frames * Frame Size;
+		// 3. The Masks of the Frames are cut from mask at (x_msk, y_msk);
+		// 4. When no Frame fits in sheet, throw std::runtime_error
+
+		size_t GetFrameCount () const;
+		Canvas &operator[] (size_t index);					// Get the Frame
+
+	private:
+		std::vector<std::unique_ptr<Canvas>> frames;
+
+		SpriteSheet (const SpriteSheet &) = delete;			// Not allow to copy
+		void operator= (const SpriteSheet &) = delete;		// Not allow to copy
+	};
+
+	//=========================Text Layout========================
+
+	class TextLayout
+	{
+	public:
+		TextLayout (size_t width,							// Width to Wrap Lines
+					size_t lineHeight = 18);				// Height of each Line
+
+		void SetWidth (size_t width);						// Wrap all Lines again
+
+		size_t GetParagraphCount () const;
+		const std::string &GetParagraph (size_t index) const;
+		void SetParagraph (size_t index, const std::string &text);
+		void InsertParagraph (size_t index, const std::string &text);
+		void AppendParagraph (const std::string &text);
+		void EraseParagraph (size_t index);
+		// Remarks:
+		// 1. Text is made up of Paragraphs, and each of them is Wrapped
+		//    into Lines (at Spaces if possible) no wider than width;
+		// 2. Wrapped Lines are Cached, and only the Edited Paragraphs
+		//    will be Wrapped again;
+
+		size_t GetLineCount (Canvas &canvas);				// Count of all Lines
+		std::pair<size_t, size_t> Locate (Canvas &canvas,	// Get (x, iLine) of the
+										  size_t index,		// Character at offset of
+										  size_t offset);	// Paragraph index
+
+		bool Draw (Canvas &canvas, int x, int y,			// Draw at (x, y)
+				   size_t firstLine = 0,					// From Line firstLine
+				   size_t cLine = (size_t) -1);				// At most cLine Lines
+		// Remarks:
+		// 1. Lines are Measured by the Current Font of canvas,
+		//    whose Characters are Measured only once a Font;
+		// 2. Only the Lines in [firstLine, firstLine + cLine) are Drawn,
+		//    so the Cost doesn't grow with the Length of the whole Text;
+
+	private:
+		struct Paragraph
+		{
+			std::string text;
+			std::vector<size_t> lineBegs;					// Offsets of Wrapped Lines
+			bool isDirty;
+		};
+		std::vector<Paragraph> paragraphs;
+		std::vector<size_t> firstLines;						// First Line of Paragraphs
+		bool isLineCountDirty;
+
+		size_t width, lineHeight;
+		int advances[256];									// Advances of Last Layout
+		unsigned long fontGeneration;						// Font of Last Layout
+
+		void Layout (Canvas &canvas);
+	};
+
+	//===========================Console==========================
+
+	class Console : public Canvas
+	{
+	public:
+		Console (size_t width, size_t height,				// Console's size
+				 int pos_x = 0, int pos_y = 0,				// Console's initial postion
+				 size_t lineHeight = 18);					// Height of each Line
+
+		bool AppendLine (const char *szText);				// Append Lines at Bottom
+		void ClearLines ();									// Clear all Lines
+		// Remarks:
+		// 1. Long Text is Wrapped into several Lines;
+		// 2. When the Console is full, the old Lines are Scrolled up,
+		//    and only the new Lines are Drawn;
+
+	private:
+		size_t width, height, lineHeight;
+		size_t cLine;										// Count of Shown Lines
+	};
+
 	//======================Message Box========================
 
 	void MsgBox (
@@ -241,4 +856,33 @@ namespace EggAche
 	// Pop up a Message Box;
 }
 
+namespace std
+{
+	// Interned Styles are Hashed by their Address
+
+	template<> struct hash<EggAche::Pen>
+	{
+		size_t operator() (const EggAche::Pen &pen) const
+		{
+			return pen.Hash ();
+		}
+	};
+
+	template<> struct hash<EggAche::Brush>
+	{
+		size_t operator() (const EggAche::Brush &brush) const
+		{
+			return brush.Hash ();
+		}
+	};
+
+	template<> struct hash<EggAche::Font>
+	{
+		size_t operator() (const EggAche::Font &font) const
+		{
+			return font.Hash ();
+		}
+	};
+}
+
 #endif  //EGGACHE_GL
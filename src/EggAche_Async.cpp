@@ -0,0 +1,131 @@
+//
+// Background Image Decoding of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "EggAche_Image.h"
+
+namespace EggAche_Impl
+{
+	// Pool of Decoding Threads
+
+	namespace
+	{
+		const unsigned MAX_DECODE_THREADS = 4;
+
+		std::atomic<unsigned long> asyncGeneration (0);
+
+		class DecodePool
+		{
+		public:
+			DecodePool () : isStopping (false)
+			{
+				// Leave a Core to the UI Thread
+				auto cores = std::thread::hardware_concurrency ();
+				auto count = std::min (std::max (cores, 2u) - 1, MAX_DECODE_THREADS);
+				for (unsigned i = 0; i < count; i++)
+					workers.emplace_back (&DecodePool::Work, this);
+			}
+
+			~DecodePool ()
+			{
+				// Tasks not Started are Dropped at Exit
+				{
+					std::lock_guard<std::mutex> lg (mtx);
+					isStopping = true;
+				}
+				cv.notify_all ();
+				for (auto &worker : workers)
+					worker.join ();
+			}
+
+			void Push (std::function<void ()> task)
+			{
+				{
+					std::lock_guard<std::mutex> lg (mtx);
+					tasks.push_back (std::move (task));
+				}
+				cv.notify_one ();
+			}
+
+		private:
+			std::mutex mtx;
+			std::condition_variable cv;
+			std::deque<std::function<void ()>> tasks;
+			std::vector<std::thread> workers;
+			bool isStopping;
+
+			void Work ()
+			{
+				for (;;)
+				{
+					std::function<void ()> task;
+					{
+						std::unique_lock<std::mutex> lock (mtx);
+						cv.wait (lock, [this] { return isStopping || !tasks.empty (); });
+						if (isStopping)
+							return;
+						task = std::move (tasks.front ());
+						tasks.pop_front ();
+					}
+					task ();
+				}
+			}
+		};
+
+		DecodePool &Pool ()
+		{
+			static DecodePool pool;
+			return pool;
+		}
+	}
+
+	bool PendingImage::IsDone () const
+	{
+		std::lock_guard<std::mutex> lg (mtx);
+		return isDone;
+	}
+
+	std::shared_ptr<const ImageData> PendingImage::Get () const
+	{
+		std::lock_guard<std::mutex> lg (mtx);
+		return image;
+	}
+
+	std::shared_ptr<const ImageData> PendingImage::Wait () const
+	{
+		std::unique_lock<std::mutex> lock (mtx);
+		cv.wait (lock, [this] { return isDone; });
+		return image;
+	}
+
+	std::shared_ptr<PendingImage> LoadImageFileAsync (const char *fileName)
+	{
+		auto pending = std::make_shared<PendingImage> ();
+		std::string name (fileName ? fileName : "");
+		Pool ().Push ([pending, name]
+		{
+			auto image = LoadImageFile (name.c_str ());
+			{
+				std::lock_guard<std::mutex> lg (pending->mtx);
+				pending->image = std::move (image);
+				pending->isDone = true;
+			}
+			pending->cv.notify_all ();
+			asyncGeneration++;
+		});
+		return pending;
+	}
+
+	unsigned long AsyncGeneration ()
+	{
+		return asyncGeneration.load ();
+	}
+}
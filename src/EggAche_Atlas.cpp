@@ -0,0 +1,290 @@
+//
+// Portable Image Atlas of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#include <algorithm>
+#include <fstream>
+
+#include "EggAche_Atlas.h"
+
+namespace EggAche_Impl
+{
+	// Skyline Packer
+
+	SkylinePacker::SkylinePacker (int width, int height)
+		: skyline { { 0, 0, width } }, width (width), height (height)
+	{}
+
+	int SkylinePacker::Fit (size_t index, int w, int h) const
+	{
+		// The Rectangle rests on the Highest Segment under it
+		auto x = skyline[index].x;
+		if (x + w > width)
+			return -1;
+
+		auto y = 0, left = w;
+		for (auto i = index; left > 0; i++)
+		{
+			y = std::max (y, skyline[i].y);
+			if (y + h > height)
+				return -1;
+			left -= skyline[i].w;
+		}
+		return y;
+	}
+
+	bool SkylinePacker::Insert (int w, int h, int &x, int &y)
+	{
+		if (w <= 0 || h <= 0)
+			return false;
+
+		// Lowest Top first, then the Narrowest Segment
+		size_t best = skyline.size ();
+		auto bestTop = height + 1, bestWidth = width + 1;
+		for (size_t i = 0; i < skyline.size (); i++)
+		{
+			auto top = Fit (i, w, h);
+			if (top < 0)
+				continue;
+			if (top + h < bestTop || (top + h == bestTop && skyline[i].w < bestWidth))
+			{
+				best = i;
+				bestTop = top + h;
+				bestWidth = skyline[i].w;
+			}
+		}
+		if (best == skyline.size ())
+			return false;
+
+		x = skyline[best].x;
+		y = bestTop - h;
+
+		// Cut off the Segments Shadowed by the new Top
+		skyline.insert (skyline.begin () + best, Segment { x, bestTop, w });
+		for (auto i = best + 1; i < skyline.size ();)
+		{
+			auto &seg = skyline[i];
+			auto shadow = x + w - seg.x;
+			if (shadow <= 0)
+				break;
+			if (shadow < seg.w)
+			{
+				seg.x += shadow;
+				seg.w -= shadow;
+				break;
+			}
+			skyline.erase (skyline.begin () + i);
+		}
+
+		// Merge Neighbours of the same Height
+		for (size_t i = 0; i + 1 < skyline.size ();)
+		{
+			if (skyline[i].y == skyline[i + 1].y)
+			{
+				skyline[i].w += skyline[i + 1].w;
+				skyline.erase (skyline.begin () + i + 1);
+			}
+			else
+				i++;
+		}
+		return true;
+	}
+
+	// Atlas
+
+	namespace
+	{
+		const char ATLAS_MAGIC[8] = { 'E', 'G', 'G', 'A', 'T', 'L', 'A', 'S' };
+		const uint32_t ATLAS_VERSION = 1;
+		const size_t PAGE_ALIGN = 16;
+
+		inline uint32_t U32 (const unsigned char *p)
+		{
+			return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+		}
+
+		inline void Put32 (std::vector<unsigned char> &out, uint32_t value)
+		{
+			for (auto i = 0; i < 4; i++)
+				out.push_back ((unsigned char) (value >> (8 * i)));
+		}
+
+		// View of the Rectangle in page, Alpha kept by the Entry
+		std::shared_ptr<const ImageData> EntryView (
+			const std::shared_ptr<const ImageData> &page,
+			int x, int y, int w, int h, bool hasAlpha)
+		{
+			auto view = std::make_shared<ImageData> ();
+			view->w = w;
+			view->h = h;
+			view->bits = page->Row (y) + 4 * x;
+			view->stride = page->stride;
+			view->hasAlpha = hasAlpha;
+			view->parent = page;
+			return view;
+		}
+	}
+
+	AtlasData::AtlasData (int pageWidth, int pageHeight)
+		: pageWidth (std::max (pageWidth, 1)), pageHeight (std::max (pageHeight, 1))
+	{}
+
+	size_t AtlasData::NewPage (int w, int h)
+	{
+		auto pixels = std::make_shared<ImageData> ();
+		pixels->w = w;
+		pixels->h = h;
+		pixels->hasAlpha = true;
+		pixels->pixels.assign ((size_t) w * h, 0);
+		pixels->bits = (const unsigned char *) pixels->pixels.data ();
+		pixels->stride = (ptrdiff_t) w * 4;
+
+		pages.push_back (Page { pixels, pixels, SkylinePacker (w, h) });
+		return pages.size () - 1;
+	}
+
+	size_t AtlasData::Add (const ImageData &image)
+	{
+		// Try the Pages still Packing, then a new one
+		size_t iPage = pages.size ();
+		int x = 0, y = 0;
+		for (size_t i = 0; i < pages.size (); i++)
+			if (pages[i].pixels && pages[i].packer.Insert (image.w, image.h, x, y))
+			{
+				iPage = i;
+				break;
+			}
+		if (iPage == pages.size ())
+		{
+			iPage = NewPage (std::max (pageWidth, image.w), std::max (pageHeight, image.h));
+			pages[iPage].packer.Insert (image.w, image.h, x, y);
+		}
+
+		// Opaque Images get their Undefined Alpha filled
+		auto &page = *pages[iPage].pixels;
+		auto alpha = image.hasAlpha ? 0u : 0xFF000000u;
+		for (auto j = 0; j < image.h; j++)
+		{
+			auto dst = &page.pixels[(size_t) (y + j) * page.w + x];
+			for (auto i = 0; i < image.w; i++)
+				dst[i] = image.Pixel (i, j) | alpha;
+		}
+
+		entries.push_back (EntryView (pages[iPage].image, x, y,
+									  image.w, image.h, image.hasAlpha));
+		entryPages.push_back (iPage);
+		return entries.size () - 1;
+	}
+
+	bool AtlasData::Save (const char *fileName) const
+	{
+		// Header, Pages and Entries, followed by the Aligned Pixels
+		std::vector<unsigned char> index (ATLAS_MAGIC, ATLAS_MAGIC + 8);
+		Put32 (index, ATLAS_VERSION);
+		Put32 (index, (uint32_t) pages.size ());
+		Put32 (index, (uint32_t) entries.size ());
+		Put32 (index, 0);
+
+		auto offset = 24 + pages.size () * 16 + entries.size () * 24;
+		std::vector<size_t> offsets;
+		for (const auto &page : pages)
+		{
+			offset = (offset + PAGE_ALIGN - 1) / PAGE_ALIGN * PAGE_ALIGN;
+			offsets.push_back (offset);
+			Put32 (index, (uint32_t) page.image->w);
+			Put32 (index, (uint32_t) page.image->h);
+			Put32 (index, (uint32_t) offset);
+			Put32 (index, (uint32_t) ((unsigned long long) offset >> 32));
+			offset += (size_t) page.image->w * page.image->h * 4;
+		}
+
+		for (size_t i = 0; i < entries.size (); i++)
+		{
+			const auto &entry = *entries[i];
+			const auto &page = *pages[entryPages[i]].image;
+			auto pos = entry.bits - page.bits;
+			Put32 (index, (uint32_t) entryPages[i]);
+			Put32 (index, (uint32_t) ((pos % page.stride) / 4));
+			Put32 (index, (uint32_t) (pos / page.stride));
+			Put32 (index, (uint32_t) entry.w);
+			Put32 (index, (uint32_t) entry.h);
+			Put32 (index, entry.hasAlpha ? 1 : 0);
+		}
+
+		std::ofstream file (fileName, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+		file.write ((const char *) index.data (), (std::streamsize) index.size ());
+
+		auto written = index.size ();
+		const char padding[PAGE_ALIGN] = { 0 };
+		for (size_t i = 0; i < pages.size (); i++)
+		{
+			const auto &page = *pages[i].image;
+			file.write (padding, (std::streamsize) (offsets[i] - written));
+			for (auto y = 0; y < page.h; y++)
+				file.write ((const char *) page.Row (y), (std::streamsize) page.w * 4);
+			written = offsets[i] + (size_t) page.w * page.h * 4;
+		}
+		return (bool) file;
+	}
+
+	std::unique_ptr<AtlasData> AtlasData::Load (const char *fileName)
+	{
+		auto file = MappedFile::Map (fileName);
+		if (!file)
+			return nullptr;
+
+		auto data = file->Data ();
+		auto size = file->Size ();
+		if (size < 24 || !std::equal (ATLAS_MAGIC, ATLAS_MAGIC + 8, (const char *) data) ||
+			U32 (data + 8) != ATLAS_VERSION)
+			return nullptr;
+
+		auto cPage = (size_t) U32 (data + 12);
+		auto cEntry = (size_t) U32 (data + 16);
+		if (cPage > (size - 24) / 16 || cEntry > (size - 24 - cPage * 16) / 24)
+			return nullptr;
+
+		std::unique_ptr<AtlasData> atlas (new AtlasData (1024, 1024));
+		for (size_t i = 0; i < cPage; i++)
+		{
+			auto p = data + 24 + i * 16;
+			auto w = (size_t) U32 (p), h = (size_t) U32 (p + 4);
+			auto offset = (unsigned long long) U32 (p + 8) |
+				((unsigned long long) U32 (p + 12) << 32);
+			if (!w || !h || w > (1 << 16) || h > (1 << 16) ||
+				offset > size || (unsigned long long) w * h * 4 > size - offset)
+				return nullptr;
+
+			// Loaded Pages are Read-only, so new Images go to new Pages
+			auto image = std::make_shared<ImageData> ();
+			image->w = (int) w;
+			image->h = (int) h;
+			image->bits = data + offset;
+			image->stride = (ptrdiff_t) w * 4;
+			image->hasAlpha = true;
+			image->file = file;
+			atlas->pages.push_back (Page { image, nullptr, SkylinePacker (0, 0) });
+		}
+
+		for (size_t i = 0; i < cEntry; i++)
+		{
+			auto p = data + 24 + cPage * 16 + i * 24;
+			auto iPage = (size_t) U32 (p);
+			auto x = (long long) U32 (p + 4), y = (long long) U32 (p + 8);
+			auto w = (long long) U32 (p + 12), h = (long long) U32 (p + 16);
+			if (iPage >= cPage || !w || !h)
+				return nullptr;
+			const auto &page = atlas->pages[iPage].image;
+			if (x + w > page->w || y + h > page->h)
+				return nullptr;
+
+			atlas->entries.push_back (EntryView (page, (int) x, (int) y,
+												 (int) w, (int) h, (U32 (p + 20) & 1) != 0));
+			atlas->entryPages.push_back (iPage);
+		}
+		return atlas;
+	}
+}
@@ -0,0 +1,80 @@
+//
+// Portable Image Atlas of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#ifndef EGGACHE_GL_ATLAS
+#define EGGACHE_GL_ATLAS
+
+#include <memory>
+#include <vector>
+#include "EggAche_Image.h"
+
+namespace EggAche_Impl
+{
+	// Bottom-left Skyline Bin Packer
+	class SkylinePacker
+	{
+	public:
+		SkylinePacker (int width, int height);
+
+		bool Insert (int w, int h, int &x, int &y);
+		// Remarks:
+		// 1. Place the w * h Rectangle where its Top is the Lowest,
+		//    and Raise the Skyline under it;
+		// 2. Return false if it doesn't fit;
+
+	private:
+		struct Segment
+		{
+			int x, y, w;					// Top of the Packed Column [x, x + w)
+		};
+		std::vector<Segment> skyline;
+		int width, height;
+
+		int Fit (size_t index, int w, int h) const;
+	};
+
+	// Images Packed into a few large Pages
+	class AtlasData
+	{
+	public:
+		AtlasData (int pageWidth, int pageHeight);
+
+		static std::unique_ptr<AtlasData> Load (const char *fileName);
+		// Remarks:
+		// 1. Pages are Views of the Mapped File without any Copy;
+		// 2. Return nullptr if the File is not a Saved Atlas;
+
+		bool Save (const char *fileName) const;
+
+		size_t Add (const ImageData &image);
+		// Remarks:
+		// 1. Copy image into the first Page it fits in, or a new Page;
+		// 2. Images larger than a Page get a Page of their own;
+		// 3. Return the id of the Entry;
+
+		size_t Count () const { return entries.size (); }
+		size_t PageCount () const { return pages.size (); }
+		const std::shared_ptr<const ImageData> &Entry (size_t id) const
+		{
+			return entries[id];
+		}
+
+	private:
+		struct Page
+		{
+			std::shared_ptr<const ImageData> image;
+			std::shared_ptr<ImageData> pixels;	// Writable Pixels, if still Packing
+			SkylinePacker packer;
+		};
+		std::vector<Page> pages;
+		std::vector<std::shared_ptr<const ImageData>> entries;	// Views of Pages
+		std::vector<size_t> entryPages;
+		int pageWidth, pageHeight;
+
+		size_t NewPage (int w, int h);
+	};
+}
+
+#endif  //EGGACHE_GL_ATLAS
@@ -0,0 +1,603 @@
+//
+// Portable Image Decoding Helpers of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "EggAche_Image.h"
+
+#ifdef EGGACHE_GL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace EggAche_Impl
+{
+	// Mapped File
+
+	std::shared_ptr<const MappedFile> MappedFile::Map (const char *fileName)
+	{
+		std::shared_ptr<MappedFile> file (new MappedFile ());
+
+#ifdef _WIN32
+		auto hFile = CreateFileA (fileName, GENERIC_READ, FILE_SHARE_READ,
+								  NULL, OPEN_EXISTING,
+								  FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile == INVALID_HANDLE_VALUE)
+			return nullptr;
+
+		LARGE_INTEGER cbFile;
+		if (!GetFileSizeEx (hFile, &cbFile) || cbFile.QuadPart == 0 ||
+			(unsigned long long) cbFile.QuadPart > (size_t) -1)
+		{
+			CloseHandle (hFile);
+			return nullptr;
+		}
+
+		// The Mapping keeps the File open by itself
+		auto hMapping = CreateFileMappingA (hFile, NULL, PAGE_READONLY,
+											0, 0, NULL);
+		CloseHandle (hFile);
+		if (!hMapping)
+			return nullptr;
+
+		auto view = MapViewOfFile (hMapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view)
+		{
+			CloseHandle (hMapping);
+			return nullptr;
+		}
+
+		file->data = (const unsigned char *) view;
+		file->size = (size_t) cbFile.QuadPart;
+		file->hMapping = hMapping;
+#else
+		auto fd = open (fileName, O_RDONLY);
+		if (fd == -1)
+			return nullptr;
+
+		struct stat st;
+		if (fstat (fd, &st) == -1 || st.st_size == 0)
+		{
+			close (fd);
+			return nullptr;
+		}
+
+		// The Mapping keeps the File open by itself
+		auto view = mmap (nullptr, (size_t) st.st_size, PROT_READ,
+						  MAP_PRIVATE, fd, 0);
+		close (fd);
+		if (view == MAP_FAILED)
+			return nullptr;
+
+		file->data = (const unsigned char *) view;
+		file->size = (size_t) st.st_size;
+#endif
+		return file;
+	}
+
+	MappedFile::~MappedFile ()
+	{
+		if (!data)
+			return;
+#ifdef _WIN32
+		UnmapViewOfFile (data);
+		CloseHandle ((HANDLE) hMapping);
+#else
+		munmap ((void *) data, size);
+#endif
+	}
+
+	// Bitmap Decoding
+
+	namespace
+	{
+		// Guard against Headers claiming Gigantic Sizes
+		const long long MAX_PIXELS = 1 << 28;
+
+		enum
+		{
+			COMPRESS_RGB = 0,
+			COMPRESS_RLE8 = 1,
+			COMPRESS_RLE4 = 2,
+			COMPRESS_BITFIELDS = 3,
+			COMPRESS_ALPHABITFIELDS = 6
+		};
+
+		inline uint32_t U16 (const unsigned char *p)
+		{
+			return p[0] | (p[1] << 8);
+		}
+
+		inline uint32_t U32 (const unsigned char *p)
+		{
+			return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+		}
+
+		// Scale a Channel picked by a Bit Mask into 8 Bits
+		class Channel
+		{
+		public:
+			Channel (uint32_t mask = 0) : mask (mask), shift (0), max (0)
+			{
+				if (!mask) return;
+				while (!((mask >> shift) & 1)) shift++;
+				max = mask >> shift;
+			}
+
+			uint32_t operator() (uint32_t value) const
+			{
+				if (!mask) return 0;
+				auto v = (value & mask) >> shift;
+				if (max == 0xFF) return v;
+				return (uint32_t) (((unsigned long long) v * 255 + max / 2) / max);
+			}
+
+		private:
+			uint32_t mask, shift, max;
+		};
+
+		// RLE4/RLE8 skip Pixels by Deltas and Line Ends,
+		// and the skipped ones are left Transparent
+		bool DecodeRle (const unsigned char *p, const unsigned char *end,
+						bool isRle8, const std::vector<uint32_t> &palette,
+						ImageData &image)
+		{
+			auto put = [&] (int x, int y, unsigned index)
+			{
+				if (x < image.w && y < image.h)
+					image.pixels[(size_t) (image.h - 1 - y) * image.w + x] =
+					index < palette.size () ? palette[index] : 0xFF000000;
+			};
+
+			auto x = 0, y = 0;
+			while (end - p >= 2 && y < image.h)
+			{
+				unsigned count = p[0], code = p[1];
+				p += 2;
+
+				// Encoded Run
+				if (count)
+				{
+					for (unsigned i = 0; i < count; i++, x++)
+						put (x, y, isRle8 ? code :
+							 (i & 1) ? code & 0xF : code >> 4);
+					continue;
+				}
+
+				switch (code)
+				{
+				case 0:		// End of Line
+					x = 0;
+					y++;
+					break;
+
+				case 1:		// End of Bitmap
+					return true;
+
+				case 2:		// Delta
+					if (end - p < 2)
+						return false;
+					x += p[0];
+					y += p[1];
+					p += 2;
+					break;
+
+				default:	// Absolute Run, padded to 16 Bits
+				{
+					auto cb = isRle8 ? code : (code + 1) / 2;
+					if ((ptrdiff_t) cb > end - p)
+						return false;
+					for (unsigned i = 0; i < code; i++, x++)
+						put (x, y, isRle8 ? p[i] :
+							 (i & 1) ? p[i / 2] & 0xF : p[i / 2] >> 4);
+					p += (cb + 1) & ~1u;
+					break;
+				}
+				}
+			}
+			return true;
+		}
+	}
+
+	std::shared_ptr<const ImageData> DecodeBmp (
+		const unsigned char *data, size_t size,
+		const std::shared_ptr<const MappedFile> &file)
+	{
+		// BITMAPFILEHEADER and the Size of Info Header
+		if (size < 18 || data[0] != 'B' || data[1] != 'M')
+			return nullptr;
+		auto offBits = (size_t) U32 (data + 10);
+		auto hdrSize = (size_t) U32 (data + 14);
+		auto hdr = data + 14;
+		if (hdrSize > size - 14 || offBits >= size)
+			return nullptr;
+
+		// BITMAPCOREHEADER or BITMAPINFOHEADER (and its later Versions)
+		long long w, h;
+		unsigned bpp, compression = COMPRESS_RGB, clrUsed = 0;
+		auto isCore = hdrSize == 12;
+		if (isCore)
+		{
+			w = U16 (hdr + 4);
+			h = (int16_t) U16 (hdr + 6);
+			bpp = U16 (hdr + 10);
+		}
+		else if (hdrSize >= 40)
+		{
+			w = (int32_t) U32 (hdr + 4);
+			h = (int32_t) U32 (hdr + 8);
+			bpp = U16 (hdr + 14);
+			compression = U32 (hdr + 16);
+			clrUsed = U32 (hdr + 32);
+		}
+		else
+			return nullptr;
+
+		auto isTopDown = h < 0;
+		if (isTopDown) h = -h;
+		if (w <= 0 || h <= 0 || w * h > MAX_PIXELS)
+			return nullptr;
+
+		auto isRle = compression == COMPRESS_RLE8 || compression == COMPRESS_RLE4;
+		auto isBitFields = compression == COMPRESS_BITFIELDS ||
+			compression == COMPRESS_ALPHABITFIELDS;
+		if ((compression == COMPRESS_RLE8 && bpp != 8) ||
+			(compression == COMPRESS_RLE4 && bpp != 4) ||
+			(isBitFields && bpp != 16 && bpp != 32) ||
+			(isRle && isTopDown) ||
+			(!isRle && !isBitFields && compression != COMPRESS_RGB))
+			return nullptr;
+
+		// Bit Masks of R, G, B and A
+		uint32_t masks[4] = { 0xFF0000, 0xFF00, 0xFF, 0 };
+		if (bpp == 16)
+		{
+			masks[0] = 0x7C00;
+			masks[1] = 0x3E0;
+			masks[2] = 0x1F;
+		}
+		auto pMasks = hdr + 40;		// Inside V2+ Headers, or following V1
+		if (isBitFields)
+		{
+			auto cMask = hdrSize >= 56 ||
+				compression == COMPRESS_ALPHABITFIELDS ? 4 : 3;
+			if ((size_t) (pMasks - data) + cMask * 4 > size)
+				return nullptr;
+			for (auto i = 0; i < cMask; i++)
+				masks[i] = U32 (pMasks + i * 4);
+		}
+
+		// Palette (RGBTRIPLE in Core Headers, or RGBQUAD)
+		std::vector<uint32_t> palette;
+		if (bpp == 1 || bpp == 4 || bpp == 8)
+		{
+			auto cEntry = (size_t) (clrUsed ? clrUsed : 1u << bpp);
+			auto cbEntry = (size_t) (isCore ? 3 : 4);
+			auto pPalette = hdr + hdrSize;
+			cEntry = std::min (cEntry, (size_t) 256);
+			cEntry = std::min (cEntry, (size - (pPalette - data)) / cbEntry);
+			for (size_t i = 0; i < cEntry; i++)
+			{
+				auto p = pPalette + i * cbEntry;
+				palette.push_back (0xFF000000 | (p[2] << 16) | (p[1] << 8) | p[0]);
+			}
+		}
+		else if (bpp != 16 && bpp != 24 && bpp != 32)
+			return nullptr;
+
+		auto image = std::make_shared<ImageData> ();
+		image->w = (int) w;
+		image->h = (int) h;
+		image->hasAlpha = masks[3] != 0;
+
+		if (isRle)
+		{
+			image->pixels.assign ((size_t) w * h, 0);
+			if (!DecodeRle (data + offBits, data + size,
+							compression == COMPRESS_RLE8, palette, *image))
+				return nullptr;
+
+			image->bits = (const unsigned char *) image->pixels.data ();
+			image->stride = (ptrdiff_t) w * 4;
+			image->hasAlpha = std::any_of (
+				image->pixels.begin (), image->pixels.end (),
+				[] (uint32_t pixel) { return (pixel >> 24) == 0; });
+			return image;
+		}
+
+		auto cbRow = (size_t) ((w * bpp + 31) / 32 * 4);
+		if (cbRow * h > size - offBits)
+			return nullptr;
+		auto topRow = data + offBits + (isTopDown ? 0 : cbRow * (h - 1));
+		auto stride = isTopDown ? (ptrdiff_t) cbRow : -(ptrdiff_t) cbRow;
+
+		// Alpha Bytes are often all Zero when the Writer ignores them
+		auto isAlphaUsed = [&] ()
+		{
+			for (auto y = 0; y < h; y++)
+				for (auto x = 0; x < w; x++)
+					if ((U32 (topRow + stride * y + 4 * x) & masks[3]) != 0)
+						return true;
+			return false;
+		};
+
+		// Zero-copy: Mapped Rows are already in BGRX/BGRA
+		auto isMapped = file && data >= file->Data () &&
+			data + size <= file->Data () + file->Size ();
+		if (isMapped && bpp == 32 &&
+			masks[0] == 0xFF0000 && masks[1] == 0xFF00 && masks[2] == 0xFF &&
+			(masks[3] == 0 || masks[3] == 0xFF000000))
+		{
+			image->bits = topRow;
+			image->stride = stride;
+			image->file = file;
+			image->hasAlpha = masks[3] != 0 && isAlphaUsed ();
+			return image;
+		}
+
+		if (bpp == 32 && image->hasAlpha && !isAlphaUsed ())
+		{
+			image->hasAlpha = false;
+			masks[3] = 0;
+		}
+
+		// Convert Row by Row into Top-down BGRA
+		image->pixels.resize ((size_t) w * h);
+		Channel r (masks[0]), g (masks[1]), b (masks[2]), a (masks[3]);
+		for (auto y = 0; y < h; y++)
+		{
+			auto src = topRow + stride * y;
+			auto dst = &image->pixels[(size_t) y * w];
+			for (auto x = 0; x < w; x++)
+			{
+				uint32_t value;
+				switch (bpp)
+				{
+				case 1:
+				case 4:
+				case 8:
+				{
+					auto bit = (size_t) x * bpp;
+					auto index = (src[bit / 8] >> (8 - bpp - bit % 8)) &
+						((1u << bpp) - 1);
+					dst[x] = index < palette.size () ? palette[index] : 0xFF000000;
+					continue;
+				}
+				case 16: value = U16 (src + 2 * x); break;
+				case 24: value = src[3 * x] | (src[3 * x + 1] << 8) |
+					(src[3 * x + 2] << 16); break;
+				default: value = U32 (src + 4 * x); break;
+				}
+
+				dst[x] = (r (value) << 16) | (g (value) << 8) | b (value) |
+					(masks[3] ? a (value) << 24 : 0xFF000000);
+			}
+		}
+
+		image->bits = (const unsigned char *) image->pixels.data ();
+		image->stride = (ptrdiff_t) w * 4;
+		return image;
+	}
+
+	std::shared_ptr<const ImageData> SubImage (
+		const std::shared_ptr<const ImageData> &image,
+		int x, int y, int w, int h)
+	{
+		if (!image || x < 0 || y < 0 || w <= 0 || h <= 0 ||
+			w > image->w - x || h > image->h - y)
+			return nullptr;
+
+		auto view = std::make_shared<ImageData> ();
+		view->w = w;
+		view->h = h;
+		view->bits = image->Row (y) + 4 * x;
+		view->stride = image->stride;
+		view->hasAlpha = image->hasAlpha;
+		view->parent = image;
+		return view;
+	}
+
+	std::shared_ptr<const ImageData> LoadImageFile (const char *fileName)
+	{
+		auto file = MappedFile::Map (fileName);
+		if (!file)
+			return nullptr;
+
+		auto data = file->Data ();
+		auto size = file->Size ();
+		if (size >= 2 && data[0] == 'B' && data[1] == 'M')
+			return DecodeBmp (data, size, file);
+		if (size >= 8 && !memcmp (data, "\x89PNG\r\n\x1A\n", 8))
+			return DecodePng (data, size);
+		if (size >= 2 && data[0] == 0xFF && data[1] == 0xD8)
+			return DecodeJpeg (data, size);
+		if (size >= 4 && !memcmp (data, "qoif", 4))
+			return DecodeQoi (data, size);
+		return nullptr;
+	}
+
+	// Image Blitting
+
+	namespace
+	{
+		inline uint32_t Blend (uint32_t dst, uint32_t src)
+		{
+			unsigned a = src >> 24;
+			if (a == 0) return dst;
+			if (a == 255) return src & 0xFFFFFF;
+
+			// Blend each Channel: dst + (src - dst) * a / 255
+			uint32_t out = 0;
+			for (auto shift = 0; shift < 24; shift += 8)
+			{
+				int dc = (dst >> shift) & 0xFF;
+				int sc = (src >> shift) & 0xFF;
+				out |= (uint32_t) (dc + (sc - dc) * (int) a / 255) << shift;
+			}
+			return out;
+		}
+
+		// Copy n Pixels (maybe not 4-byte Aligned) with Alpha Cleared
+		inline void CopyRow (uint32_t *dst, const unsigned char *src, int n)
+		{
+			auto i = 0;
+#ifdef EGGACHE_GL_SSE2
+			auto rgb = _mm_set1_epi32 (0xFFFFFF);
+			for (; i + 4 <= n; i += 4)
+				_mm_storeu_si128 ((__m128i *) (dst + i), _mm_and_si128 (
+					_mm_loadu_si128 ((const __m128i *) (src + 4 * i)), rgb));
+#endif
+			for (; i < n; i++)
+			{
+				uint32_t pixel;
+				memcpy (&pixel, src + 4 * i, 4);
+				dst[i] = pixel & 0xFFFFFF;
+			}
+		}
+	}
+
+	void BlitImage (const Surface &surface, const Rect &clip,
+					int xDst, int yDst, int wDst, int hDst,
+					const ImageData &image)
+	{
+		if (wDst <= 0 || hDst <= 0)
+			return;
+
+		auto xBeg = std::max (xDst, clip.left);
+		auto yBeg = std::max (yDst, clip.top);
+		auto xEnd = std::min (xDst + wDst, clip.right);
+		auto yEnd = std::min (yDst + hDst, clip.bottom);
+		if (xBeg >= xEnd || yBeg >= yEnd)
+			return;
+
+		// Not Stretched: each Row is Copied (or Blended) straight from image
+		if (wDst == image.w && hDst == image.h)
+		{
+			for (auto y = yBeg; y < yEnd; y++)
+			{
+				auto src = image.Row (y - yDst) + 4 * (xBeg - xDst);
+				auto dst = surface.Row (y) + xBeg;
+				if (!image.hasAlpha)
+				{
+					CopyRow (dst, src, xEnd - xBeg);
+					continue;
+				}
+				for (auto i = 0; i < xEnd - xBeg; i++)
+				{
+					uint32_t pixel;
+					memcpy (&pixel, src + 4 * i, 4);
+					dst[i] = Blend (dst[i], pixel);
+				}
+			}
+			return;
+		}
+
+		// Nearest Source Column of each Destination Column
+		std::vector<int> xSrcs (xEnd - xBeg);
+		for (auto x = xBeg; x < xEnd; x++)
+			xSrcs[x - xBeg] = (int) (((long long) (x - xDst) * 2 + 1) *
+									 image.w / (2 * (long long) wDst));
+
+		for (auto y = yBeg; y < yEnd; y++)
+		{
+			auto ySrc = (int) (((long long) (y - yDst) * 2 + 1) *
+							   image.h / (2 * (long long) hDst));
+			auto src = image.Row (ySrc);
+			auto dst = surface.Row (y) + xBeg;
+			uint32_t pixel;
+			if (image.hasAlpha)
+				for (auto i = 0; i < xEnd - xBeg; i++)
+				{
+					memcpy (&pixel, src + 4 * xSrcs[i], 4);
+					dst[i] = Blend (dst[i], pixel);
+				}
+			else
+				for (auto i = 0; i < xEnd - xBeg; i++)
+				{
+					memcpy (&pixel, src + 4 * xSrcs[i], 4);
+					dst[i] = pixel & 0xFFFFFF;
+				}
+		}
+	}
+
+	void BlitImageKeyed (const Surface &surface, const Rect &clip,
+						 int xDst, int yDst, const ImageData &image,
+						 uint32_t colorKey)
+	{
+		auto xBeg = std::max (xDst, clip.left);
+		auto yBeg = std::max (yDst, clip.top);
+		auto xEnd = std::min (xDst + image.w, clip.right);
+		auto yEnd = std::min (yDst + image.h, clip.bottom);
+		colorKey &= 0xFFFFFF;
+
+		for (auto y = yBeg; y < yEnd; y++)
+		{
+			auto src = image.Row (y - yDst) + 4 * (xBeg - xDst);
+			auto dst = surface.Row (y) + xBeg;
+			auto i = 0, n = xEnd - xBeg;
+#ifdef EGGACHE_GL_SSE2
+			if (!image.hasAlpha)
+			{
+				auto rgb = _mm_set1_epi32 (0xFFFFFF);
+				auto key = _mm_set1_epi32 ((int) colorKey);
+				for (; i + 4 <= n; i += 4)
+				{
+					auto pixels = _mm_and_si128 (
+						_mm_loadu_si128 ((const __m128i *) (src + 4 * i)), rgb);
+					auto isKey = _mm_cmpeq_epi32 (pixels, key);
+					auto old = _mm_loadu_si128 ((const __m128i *) (dst + i));
+					_mm_storeu_si128 ((__m128i *) (dst + i), _mm_or_si128 (
+						_mm_and_si128 (isKey, old), _mm_andnot_si128 (isKey, pixels)));
+				}
+			}
+#endif
+			for (; i < n; i++)
+			{
+				uint32_t pixel;
+				memcpy (&pixel, src + 4 * i, 4);
+				pixel = image.hasAlpha ? Blend (colorKey, pixel) : pixel & 0xFFFFFF;
+				if (pixel != colorKey)
+					dst[i] = pixel;
+			}
+		}
+	}
+
+	void BlitImageMask (const Surface &surface, const Rect &clip,
+						int xDst, int yDst, int w, int h,
+						const ImageData &src, int xSrc, int ySrc,
+						const ImageData &mask, int xMsk, int yMsk)
+	{
+		// Trim by both Sources, and then by clip
+		w = std::min (w, std::min (src.w - xSrc, mask.w - xMsk));
+		h = std::min (h, std::min (src.h - ySrc, mask.h - yMsk));
+
+		auto xBeg = std::max (xDst, clip.left);
+		auto yBeg = std::max (yDst, clip.top);
+		auto xEnd = std::min (xDst + w, clip.right);
+		auto yEnd = std::min (yDst + h, clip.bottom);
+
+		for (auto y = yBeg; y < yEnd; y++)
+		{
+			auto dst = surface.Row (y);
+			for (auto x = xBeg; x < xEnd; x++)
+			{
+				auto s = src.Pixel (x - xDst + xSrc, y - yDst + ySrc);
+				auto m = mask.Pixel (x - xDst + xMsk, y - yDst + yMsk);
+				dst[x] = ((dst[x] & m) | s) & 0xFFFFFF;
+			}
+		}
+	}
+}
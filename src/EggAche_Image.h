@@ -0,0 +1,312 @@
+//
+// Portable Image Coding Helpers of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#ifndef EGGACHE_GL_IMAGE
+#define EGGACHE_GL_IMAGE
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "EggAche_Raster.h"
+#include "EggAche_Zlib.h"
+
+namespace EggAche_Impl
+{
+	// Read-only View of a whole File mapped into Memory
+	class MappedFile
+	{
+	public:
+		static std::shared_ptr<const MappedFile> Map (const char *fileName);
+		// Remarks:
+		// Return nullptr if the File can't be Opened or is Empty;
+
+		~MappedFile ();
+
+		const unsigned char *Data () const { return data; }
+		size_t Size () const { return size; }
+
+	private:
+		const unsigned char *data;
+		size_t size;
+		void *hMapping;							// Platform Handle of the Mapping
+
+		MappedFile () : data (nullptr), size (0), hMapping (nullptr) {}
+		MappedFile (const MappedFile &) = delete;		// Not allow to copy
+		void operator= (const MappedFile &) = delete;	// Not allow to copy
+	};
+
+	// Decoded Pixels in 32-bit BGRA (0xAARRGGBB), Row by Row
+	struct ImageData
+	{
+		int w, h;
+		const unsigned char *bits;				// First Pixel of the Top Row
+		ptrdiff_t stride;						// Bytes between Rows (Negative if Bottom-up)
+		bool hasAlpha;							// Otherwise Alpha Bytes are Undefined
+
+		std::vector<uint32_t> pixels;			// Owned Pixels, if Decoded
+		std::shared_ptr<const MappedFile> file;	// Mapped Pixels, if Zero-copy
+		std::shared_ptr<const ImageData> parent;	// Viewed Pixels, if a Sub-Image
+
+		const unsigned char *Row (int y) const
+		{
+			return bits + stride * y;
+		}
+
+		uint32_t Pixel (int x, int y) const
+		{
+			// Mapped Rows are not always 4-byte Aligned
+			uint32_t pixel;
+			memcpy (&pixel, Row (y) + 4 * x, 4);
+			return pixel;
+		}
+	};
+
+	// Image Decoding
+
+	std::shared_ptr<const ImageData> DecodeBmp (
+		const unsigned char *data, size_t size,
+		const std::shared_ptr<const MappedFile> &file = nullptr);
+	// Remarks:
+	// 1. Support 1/4/8/16/24/32 bpp, RLE4/RLE8, Bit Fields,
+	//    and both Top-down and Bottom-up Rows;
+	// 2. If data is inside file and already in 32-bit BGRX/BGRA,
+	//    the Image is a View of the Mapped Rows without any Copy;
+	// 3. Return nullptr if data is not a valid Bitmap;
+
+	std::shared_ptr<const ImageData> DecodePng (
+		const unsigned char *data, size_t size);
+	// Remarks:
+	// 1. Support all Color Types and Bit Depths, tRNS and Adam7 Interlacing;
+	// 2. 16-bit Samples are truncated to 8 Bits;
+
+	std::shared_ptr<const ImageData> DecodeJpeg (
+		const unsigned char *data, size_t size);
+	// Remarks:
+	// 1. Support Baseline (and Extended Huffman) Gray and YCbCr JPEG
+	//    with any Sampling Factors; Progressive JPEG is not Supported;
+	// 2. Subsampled Chroma is Replicated (not Interpolated);
+
+	std::shared_ptr<const ImageData> DecodeQoi (
+		const unsigned char *data, size_t size);
+	// Remarks:
+	// Support both RGB and RGBA QOI (Quite OK Image);
+
+	std::shared_ptr<const ImageData> SubImage (
+		const std::shared_ptr<const ImageData> &image,
+		int x, int y, int w, int h);
+	// Remarks:
+	// 1. Return a View of the Rectangle of image sharing its Pixels;
+	// 2. Return nullptr if the Rectangle is Empty or out of image;
+
+	std::shared_ptr<const ImageData> LoadImageFile (const char *fileName);
+	// Remarks:
+	// 1. Map the File and Decode it by its Signature (BMP, PNG, JPEG or QOI);
+	// 2. All the Decoders use only Local States,
+	//    so Images can be Decoded in Parallel;
+
+	// Background Decoding
+
+	// Image Decoded by the Pool of Decoding Threads
+	class PendingImage
+	{
+	public:
+		bool IsDone () const;
+
+		std::shared_ptr<const ImageData> Get () const;
+		// Remarks:
+		// Return nullptr if it's not Done yet, or it Failed;
+
+		std::shared_ptr<const ImageData> Wait () const;
+		// Remarks:
+		// Block until it's Done, and return nullptr if it Failed;
+
+	private:
+		mutable std::mutex mtx;
+		mutable std::condition_variable cv;
+		bool isDone = false;
+		std::shared_ptr<const ImageData> image;
+
+		friend std::shared_ptr<PendingImage> LoadImageFileAsync (const char *);
+	};
+
+	std::shared_ptr<PendingImage> LoadImageFileAsync (const char *fileName);
+	// Remarks:
+	// 1. Queue fileName for LoadImageFile on a Pool of Background Threads
+	//    (started on first use, one less than the Cores, 4 at most);
+	// 2. AsyncGeneration () Changes every time a PendingImage is Done;
+
+	unsigned long AsyncGeneration ();
+
+	// Image Scaling
+
+	std::shared_ptr<const ImageData> ScaleImage (const ImageData &image,
+												 int w, int h);
+	// Remarks:
+	// 1. Resample image into w * h, along each Axis by Bilinear (Enlarging)
+	//    or Box (Shrinking, averaging all the Pixels covered);
+	// 2. Channels (and Alpha) are Filtered separately, not Premultiplied;
+
+	std::shared_ptr<const ImageData> ScaleImageCached (
+		const std::shared_ptr<const ImageData> &image, int w, int h);
+	// Remarks:
+	// 1. Same as ScaleImage, but the last Scaled Copies (16 at most, 64 MB)
+	//    are kept, as long as their Sources are alive;
+	// 2. Return image itself if it's w * h already;
+
+	// Image Blitting
+
+	void BlitImage (const Surface &surface, const Rect &clip,
+					int xDst, int yDst, int wDst, int hDst,
+					const ImageData &image);
+	// Remarks:
+	// 1. Stretch the whole image into wDst * hDst at (xDst, yDst),
+	//    trimmed by clip;
+	// 2. Rows are copied as is when not Stretched nor Alpha-blended;
+
+	void BlitImageKeyed (const Surface &surface, const Rect &clip,
+						 int xDst, int yDst, const ImageData &image,
+						 uint32_t colorKey);
+	// Remarks:
+	// 1. Same as BlitImage at image's Size, but Pixels coming out as colorKey
+	//    (Alpha-blended onto it, if image has Alpha) leave the Destination as is;
+	// 2. So it's the same as Blitting onto a Bitmap Cleared by colorKey,
+	//    and then Painting that with colorKey Transparent;
+
+	void BlitImageMask (const Surface &surface, const Rect &clip,
+						int xDst, int yDst, int w, int h,
+						const ImageData &src, int xSrc, int ySrc,
+						const ImageData &mask, int xMsk, int yMsk);
+	// Remarks:
+	// Same as BitBlt by SRCAND (mask) and then SRCPAINT (src);
+
+	// Source and Mask Combined into Runs of each Row
+	struct MaskedSprite
+	{
+		struct Run
+		{
+			int x, len;
+			bool isOpaque;						// Mask is Black, so Copy Source
+		};
+
+		int w, h;
+		std::vector<size_t> rowRuns;			// First Run of each Row, and the End
+		std::vector<Run> runs;					// Transparent Runs are Dropped
+		std::vector<uint32_t> pixels, masks;	// Source and Mask in w * h
+	};
+
+	std::shared_ptr<const MaskedSprite> BuildMaskedSprite (
+		const ImageData &src, int xSrc, int ySrc,
+		const ImageData &mask, int xMsk, int yMsk, int w, int h);
+	// Remarks:
+	// 1. Pixels of White Mask and Black Source leave the Destination as is,
+	//    so they are Skipped by BlitMaskedSprite;
+	// 2. Return nullptr if the Part is out of src or mask;
+
+	std::shared_ptr<const MaskedSprite> BuildMaskedSpriteCached (
+		const std::shared_ptr<const ImageData> &src, int xSrc, int ySrc,
+		const std::shared_ptr<const ImageData> &mask, int xMsk, int yMsk,
+		int w, int h);
+	// Remarks:
+	// The last Sprites (64 at most) are kept, as long as their Sources are alive;
+
+	void BlitMaskedSprite (const Surface &surface, const Rect &clip,
+						   int xDst, int yDst, const MaskedSprite &sprite);
+	// Remarks:
+	// Same as BlitImageMask of the Sprite's Parts, in a single Pass;
+
+	// Image Encoding
+
+	// Sink of Encoded Bytes, returning false to Stop
+	using ImageWriter = std::function<bool (const uint8_t *data, size_t size)>;
+
+	bool EncodeJpeg (const Surface &surface, int quality,
+					 std::vector<unsigned char> &out);
+	// Remarks:
+	// 1. Encode the 32-bit BGRX surface into a Baseline JFIF in out;
+	// 2. quality is 1 - 100 as libjpeg's; Chroma is Subsampled (4:2:0)
+	//    below 90, and kept Full (4:4:4) from 90 on;
+
+	bool EncodeQoi (const Surface &surface, std::vector<unsigned char> &out);
+	// Remarks:
+	// 1. Encode the 32-bit BGRX surface into an RGB QOI in out, losslessly;
+	// 2. A single Pass of Runs, an Index of 64 Colors and small Differences,
+	//    so it's about as fast as Copying, and several times smaller than Bmp;
+
+	// Distinct Colors of Surfaces, as long as they are few
+	class ColorCensus
+	{
+	public:
+		static const int MAX_COLORS = 256;
+
+		ColorCensus ();
+
+		bool Add (const Surface &rows);
+		// Remarks:
+		// 1. Count the Colors of rows (Alpha Ignored) in, and return false
+		//    once there are more than MAX_COLORS, without Counting any more;
+		// 2. Each Color is Hashed only where it Changes, and Runs are
+		//    Skipped 4 Pixels at a time (by SSE2);
+
+		bool IsOver () const { return isOver; }
+
+		const std::vector<uint32_t> &Colors () const { return colors; }
+		// Remarks:
+		// In the Order they Appear;
+
+		int IndexOf (uint32_t color) const;
+		// Remarks:
+		// Return -1 if color is not Counted;
+
+	private:
+		std::vector<uint32_t> colors;
+		std::vector<int> slots;					// Indexes into colors, by Hash
+		bool isOver;
+	};
+
+	// PNG Encoded Band by Band, so only a few Rows are held at a time
+	class PngEncoder
+	{
+	public:
+		PngEncoder (int w, int h, const ImageWriter &writer,
+					const ColorCensus *census = nullptr, int level = 6);
+		// Remarks:
+		// 1. If census holds all the Colors (at most 256), the PNG is Indexed
+		//    (1/2/4/8 bpp, by the Number of Colors); Otherwise it's RGB;
+		// 2. level (0 - 9) is the Deflater's;
+
+		bool AddRows (const Surface &rows);
+		// Remarks:
+		// 1. Append the 32-bit BGRX rows (w Pixels wide) below those Added,
+		//    each Filtered by the least Sum of Differences, and Deflated;
+		// 2. Compressed Bytes go to writer in IDAT Chunks of 64K,
+		//    so the Memory used is bounded however large the Image is;
+		// 3. Return false if writer does, a Color is not in census,
+		//    or it goes past h Rows;
+
+		bool Finish ();
+		// Remarks:
+		// Write the rest, or return false if not all the h Rows are Added;
+
+	private:
+		int w, h, y;
+		bool isOk;
+		ImageWriter writer;
+		ColorCensus palette;
+		int depth;								// Bits of an Index, or 0 for RGB
+		Deflater deflater;
+		std::vector<unsigned char> prev, cur;		// Bytes of the last and this Row
+		std::vector<unsigned char> best, filtered;	// Filter Type and Filtered Row
+		std::vector<unsigned char> idat;			// Compressed, not Written yet
+
+		bool WriteChunk (const char *type, const unsigned char *data, size_t size);
+	};
+}
+
+#endif  //EGGACHE_GL_IMAGE
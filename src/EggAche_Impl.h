@@ -8,11 +8,56 @@
 
 #include <functional>
 #include <utility>
+#include <vector>
+#include <string>
+#include "EggAche_Raster.h"
+#include "EggAche_Image.h"
+#include "EggAche_Atlas.h"
+#include "EggAche_Pack.h"
+#include "EggAche_Snapshot.h"
 
 namespace EggAche_Impl
 {
 	class GUIContext;
 
+	// Interned Drawing States
+	// Equal States are the same Object, so they can be compared by Address
+
+	struct PenStyle
+	{
+		unsigned width, r, g, b;
+	};
+
+	struct BrushStyle
+	{
+		bool isTransparent;
+		unsigned r, g, b;
+	};
+
+	struct FontStyle
+	{
+		unsigned size;
+		std::string family;
+		unsigned r, g, b;
+	};
+
+	const PenStyle *InternPen (unsigned width,
+							   unsigned r, unsigned g, unsigned b);
+	const BrushStyle *InternBrush (bool isTransparent,
+								   unsigned r, unsigned g, unsigned b);
+	const FontStyle *InternFont (unsigned size, const char *family,
+								 unsigned r, unsigned g, unsigned b);
+	// Remarks:
+	// Interned States live until Exit, so only Pen, Brush and Font
+	// (held by the User) Intern them, and not SetPen / SetBrush / SetFont;
+
+	const PenStyle *FindPen (unsigned width,
+							 unsigned r, unsigned g, unsigned b);
+	const BrushStyle *FindBrush (bool isTransparent,
+								 unsigned r, unsigned g, unsigned b);
+	// Remarks:
+	// Return the Interned State if any, or nullptr (without Interning);
+
 	class WindowImpl
 	{
 	public:
@@ -59,6 +104,12 @@ namespace EggAche_Impl
 							  unsigned g,
 							  unsigned b) = 0;
 
+		virtual bool SetStyle (const PenStyle *pen,
+							   const BrushStyle *brush,
+							   const FontStyle *font) = 0;
+		// Remarks:
+		// Null Style means keeping the Current one;
+
 		virtual bool DrawLine (int xBeg, int yBeg, int xEnd, int yEnd) = 0;
 
 		virtual bool DrawRect (int xBeg, int yBeg, int xEnd, int yEnd) = 0;
@@ -77,8 +128,15 @@ namespace EggAche_Impl
 		virtual bool DrawPie (int xLeft, int yTop, int xRight, int yBottom,
 							  double angleBeg, double cAngle) = 0;
 
+		virtual bool DrawPolyline (const Contour &points, bool isClosed) = 0;
+
+		virtual bool FillPolygon (const std::vector<Contour> &contours,
+								  bool isNonZero) = 0;
+
 		virtual bool DrawTxt (int xBeg, int yBeg, const char *szText) = 0;
 		virtual size_t GetTxtWidth (const char *szText) = 0;
+		virtual bool MeasureTexts (const char *const *texts, size_t count,
+								   size_t *widths) = 0;
 
 		virtual bool DrawImg (const char *fileName,
 							  int x = 0, int y = 0,
@@ -94,11 +152,41 @@ namespace EggAche_Impl
 								  unsigned x_src, unsigned y_src,
 								  unsigned x_msk, unsigned y_msk) = 0;
 
-		virtual bool SaveAsJpg (const char *fileName) const = 0;
-		virtual bool SaveAsPng (const char *fileName) const = 0;
-		virtual bool SaveAsBmp (const char *fileName) const = 0;
+		virtual bool DrawImg (const ImageData &image,
+							  int x, int y, int width, int height) = 0;
+
+		virtual bool DrawImgKeyed (const ImageData &image, int x, int y) = 0;
+		// Remarks:
+		// Draw image as if it were Copied into a new Context and then Painted,
+		// so its Pixels of the Transparent Color leave this Context as is;
+
+		virtual bool DrawImgMask (const ImageData &src,
+								  const ImageData &mask,
+								  unsigned width, unsigned height,
+								  int x_pos, int y_pos,
+								  unsigned x_src, unsigned y_src,
+								  unsigned x_msk, unsigned y_msk) = 0;
+
+		virtual bool DrawSprite (const MaskedSprite &sprite, int x, int y) = 0;
+
+		virtual bool EncodeJpg (const Rect &rect, unsigned quality,
+								const ImageWriter &writer) const = 0;
+		virtual bool EncodePng (PngEncoder &png, const Rect &rect) const = 0;
+		virtual bool CountColors (ColorCensus &census, const Rect &rect) const = 0;
+		virtual bool EncodeBmp (const Rect &rect, const ImageWriter &writer) const = 0;
+		virtual bool EncodeQoi (const Rect &rect, const ImageWriter &writer) const = 0;
+		virtual bool SaveAsSnapshot (SnapshotStore &store, const Rect &rect) const = 0;
+		// Remarks:
+		// 1. Only the Pixels in rect are Read and Encoded (or Saved);
+		// 2. The Encoded Bytes go to writer in one or more Chunks,
+		//    and return false as soon as writer does;
+		// 3. EncodePng Adds the Rows of rect to png (and CountColors to census),
+		//    so Huge Images can be Encoded Band by Band;
 
 		virtual void Clear () = 0;
+		virtual bool Scroll (int dx, int dy) = 0;
+
+		virtual void SetClip (const Rect &clip) = 0;
 
 		virtual void PaintOnContext (GUIContext *,
 									 size_t x, size_t y) const = 0;
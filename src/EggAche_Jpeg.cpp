@@ -0,0 +1,1222 @@
+//
+// Portable JPEG Codec of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "EggAche_Image.h"
+
+#ifdef EGGACHE_GL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace EggAche_Impl
+{
+	// JPEG Decoding
+
+	namespace
+	{
+		// Guard against Headers claiming Gigantic Sizes
+		const long long MAX_PIXELS = 1 << 28;
+
+		const int FAST_BITS = 9;				// Codes decoded by a single Lookup
+
+		// Natural Order of the i-th Coefficient in the Stream,
+		// padded for Corrupted Runs past 63
+		const unsigned char ZIGZAG[64 + 16] = {
+			0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+			12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+			35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+			58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+			63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63 };
+
+		inline uint32_t U16BE (const unsigned char *p)
+		{
+			return (p[0] << 8) | p[1];
+		}
+
+		// Entropy-coded Bits, MSB first, with 0xFF00 Stuffing
+		class BitReader
+		{
+		public:
+			BitReader (const unsigned char *p, const unsigned char *end)
+				: p (p), end (end), bits (0), cBits (0), isMarker (false)
+			{}
+
+			void Fill ()
+			{
+				while (cBits <= 24)
+				{
+					unsigned b = 0;
+					if (!isMarker && p < end)
+					{
+						b = *p;
+						if (b == 0xFF)
+						{
+							// A Marker ends the Data, and is left for the Parser
+							if (p + 1 < end && p[1] == 0)
+								p += 2;
+							else
+							{
+								isMarker = true;
+								b = 0;
+							}
+						}
+						else
+							p++;
+					}
+					bits |= (uint32_t) b << (24 - cBits);
+					cBits += 8;
+				}
+			}
+
+			unsigned Get (int n)
+			{
+				if (!n) return 0;
+				if (cBits < n) Fill ();
+				auto value = bits >> (32 - n);
+				bits <<= n;
+				cBits -= n;
+				return value;
+			}
+
+			// Get an n-bit Signed Value (Sign is in the Leading Bit)
+			int Extend (int n)
+			{
+				if (!n) return 0;
+				auto value = (int) Get (n);
+				return value < (1 << (n - 1)) ? value - (1 << n) + 1 : value;
+			}
+
+			uint32_t Peek ()
+			{
+				if (cBits < 16) Fill ();
+				return bits;
+			}
+
+			void Skip (int n)
+			{
+				bits <<= n;
+				cBits -= n;
+			}
+
+			// Skip to the Byte after the next RSTn Marker
+			bool Restart ()
+			{
+				bits = 0;
+				cBits = 0;
+				isMarker = false;
+				while (end - p >= 2 && !(p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7))
+					p++;
+				if (end - p < 2)
+					return false;
+				p += 2;
+				return true;
+			}
+
+			const unsigned char *Position () const { return p; }
+
+		private:
+			const unsigned char *p, *end;
+			uint32_t bits;
+			int cBits;
+			bool isMarker;
+		};
+
+		class Huffman
+		{
+		public:
+			// Tables not Defined by the Stream decode Nothing
+			Huffman ()
+			{
+				unsigned char counts[16] = { 0 };
+				Build (counts, nullptr);
+			}
+
+			bool Build (const unsigned char counts[16], const unsigned char *syms)
+			{
+				// Canonical Codes sorted by Length
+				auto k = 0;
+				for (auto len = 1; len <= 16; len++)
+					for (auto i = 0; i < counts[len - 1]; i++)
+						sizes[k++] = (unsigned char) len;
+				sizes[k] = 0;
+				std::copy (syms, syms + k, values);
+
+				unsigned code = 0;
+				k = 0;
+				for (auto len = 1; len <= 16; len++)
+				{
+					delta[len] = k - (int) code;
+					while (sizes[k] == len)
+						codes[k++] = (unsigned short) code++;
+					if (code - 1 >= (1u << len) && counts[len - 1])
+						return false;
+					maxCode[len] = code << (16 - len);
+					code <<= 1;
+				}
+				maxCode[17] = 0xFFFFFFFF;
+
+				std::fill (fast, fast + (1 << FAST_BITS), 255);
+				for (auto i = 0; i < k; i++)
+				{
+					auto len = sizes[i];
+					if (len > FAST_BITS) continue;
+					auto first = codes[i] << (FAST_BITS - len);
+					std::fill (fast + first, fast + first + (1 << (FAST_BITS - len)),
+							   (unsigned char) i);
+				}
+				return true;
+			}
+
+			int Decode (BitReader &reader) const
+			{
+				auto bits = reader.Peek ();
+				auto k = fast[bits >> (32 - FAST_BITS)];
+				if (k != 255)
+				{
+					reader.Skip (sizes[k]);
+					return values[k];
+				}
+
+				// Longer Codes are compared Left-aligned in 16 Bits
+				auto top = bits >> 16;
+				auto len = FAST_BITS + 1;
+				while (top >= maxCode[len]) len++;
+				if (len == 17)
+					return -1;
+
+				auto index = (int) (bits >> (32 - len)) + delta[len];
+				if (index < 0 || index >= 256)
+					return -1;
+				reader.Skip (len);
+				return values[index];
+			}
+
+		private:
+			unsigned char fast[1 << FAST_BITS];	// Index of the Code, or 255
+			unsigned short codes[256];
+			unsigned char sizes[257];
+			unsigned char values[256];
+			uint32_t maxCode[18];
+			int delta[17];						// Index - Code of each Length
+		};
+
+		// Integer IDCT (Islow of the IJG), with Output Level-shifted
+		inline int F2F (double x) { return (int) (x * 4096 + 0.5); }
+
+#define EGGACHE_IDCT_1D(s0, s1, s2, s3, s4, s5, s6, s7)					\
+		int t0, t1, t2, t3, p1, p2, p3, p4, p5, x0, x1, x2, x3;			\
+		p2 = s2;														\
+		p3 = s6;														\
+		p1 = (p2 + p3) * F2F (0.5411961);								\
+		t2 = p1 + p3 * F2F (-1.847759065);								\
+		t3 = p1 + p2 * F2F (0.765366865);								\
+		p2 = s0;														\
+		p3 = s4;														\
+		t0 = (p2 + p3) * 4096;											\
+		t1 = (p2 - p3) * 4096;											\
+		x0 = t0 + t3;													\
+		x3 = t0 - t3;													\
+		x1 = t1 + t2;													\
+		x2 = t1 - t2;													\
+		t0 = s7;														\
+		t1 = s5;														\
+		t2 = s3;														\
+		t3 = s1;														\
+		p3 = t0 + t2;													\
+		p4 = t1 + t3;													\
+		p1 = t0 + t3;													\
+		p2 = t1 + t2;													\
+		p5 = (p3 + p4) * F2F (1.175875602);								\
+		t0 = t0 * F2F (0.298631336);									\
+		t1 = t1 * F2F (2.053119869);									\
+		t2 = t2 * F2F (3.072711026);									\
+		t3 = t3 * F2F (1.501321110);									\
+		p1 = p5 + p1 * F2F (-0.899976223);								\
+		p2 = p5 + p2 * F2F (-2.562915447);								\
+		p3 = p3 * F2F (-1.961570560);									\
+		p4 = p4 * F2F (-0.390180644);									\
+		t3 += p1 + p4;													\
+		t2 += p2 + p3;													\
+		t1 += p2 + p4;													\
+		t0 += p1 + p3;
+
+		inline unsigned char Clamp (int x)
+		{
+			return (unsigned char) (x < 0 ? 0 : x > 255 ? 255 : x);
+		}
+
+		// Valid Coefficients of 8-bit Samples fit in 12 Bits,
+		// and Clamping Corrupted ones keeps the IDCT from Overflowing
+		inline int ClampCoeff (int x)
+		{
+			return x < -4096 ? -4096 : x > 4095 ? 4095 : x;
+		}
+
+		inline int ClampColumn (int x)
+		{
+			return x < -16384 ? -16384 : x > 16383 ? 16383 : x;
+		}
+
+#ifdef EGGACHE_GL_SSE2
+		// Pair of 16-bit Factors for _mm_madd_epi16 of Interleaved Inputs
+		inline __m128i Factors (int lo, int hi)
+		{
+			return _mm_set1_epi32 ((int) ((uint32_t) (uint16_t) lo | ((uint32_t) hi << 16)));
+		}
+
+		inline void Transpose8x8 (__m128i v[8])
+		{
+			auto a0 = _mm_unpacklo_epi16 (v[0], v[1]), a1 = _mm_unpackhi_epi16 (v[0], v[1]);
+			auto a2 = _mm_unpacklo_epi16 (v[2], v[3]), a3 = _mm_unpackhi_epi16 (v[2], v[3]);
+			auto a4 = _mm_unpacklo_epi16 (v[4], v[5]), a5 = _mm_unpackhi_epi16 (v[4], v[5]);
+			auto a6 = _mm_unpacklo_epi16 (v[6], v[7]), a7 = _mm_unpackhi_epi16 (v[6], v[7]);
+			auto b0 = _mm_unpacklo_epi32 (a0, a2), b1 = _mm_unpackhi_epi32 (a0, a2);
+			auto b2 = _mm_unpacklo_epi32 (a1, a3), b3 = _mm_unpackhi_epi32 (a1, a3);
+			auto b4 = _mm_unpacklo_epi32 (a4, a6), b5 = _mm_unpackhi_epi32 (a4, a6);
+			auto b6 = _mm_unpacklo_epi32 (a5, a7), b7 = _mm_unpackhi_epi32 (a5, a7);
+			v[0] = _mm_unpacklo_epi64 (b0, b4); v[1] = _mm_unpackhi_epi64 (b0, b4);
+			v[2] = _mm_unpacklo_epi64 (b1, b5); v[3] = _mm_unpackhi_epi64 (b1, b5);
+			v[4] = _mm_unpacklo_epi64 (b2, b6); v[5] = _mm_unpackhi_epi64 (b2, b6);
+			v[6] = _mm_unpacklo_epi64 (b3, b7); v[7] = _mm_unpackhi_epi64 (b3, b7);
+		}
+
+		// A Pass of EGGACHE_IDCT_1D down the 8 Lanes of v[0] - v[7],
+		// Rounded by bias and Shifted into 16 Bits (Saturated);
+		// Each Term is Expanded into Factors of the Inputs, so every 32-bit Sum
+		// is exactly the Scalar one, by 2 madds of Input Pairs
+		template<int SHIFT>
+		void IdctPass (__m128i v[8], int bias)
+		{
+			const auto C1 = F2F (0.5411961), CM = F2F (-1.847759065), CP = F2F (0.765366865);
+			const auto A = F2F (1.175875602), B = F2F (-0.899976223), C = F2F (-2.562915447),
+				D = F2F (-1.961570560), E = F2F (-0.390180644);
+			const auto K0 = F2F (0.298631336), K1 = F2F (2.053119869),
+				K2 = F2F (3.072711026), K3 = F2F (1.501321110);
+
+			auto rounding = _mm_set1_epi32 (bias);
+			__m128i out[2][8];
+			for (auto half = 0; half < 2; half++)
+			{
+				auto unpack = [half] (__m128i a, __m128i b)
+				{
+					return half ? _mm_unpackhi_epi16 (a, b) : _mm_unpacklo_epi16 (a, b);
+				};
+				auto s04 = unpack (v[0], v[4]), s26 = unpack (v[2], v[6]);
+				auto s13 = unpack (v[1], v[3]), s57 = unpack (v[5], v[7]);
+
+				// Even Part
+				auto t0 = _mm_add_epi32 (_mm_madd_epi16 (s04, Factors (4096, 4096)), rounding);
+				auto t1 = _mm_add_epi32 (_mm_madd_epi16 (s04, Factors (4096, -4096)), rounding);
+				auto t2 = _mm_madd_epi16 (s26, Factors (C1, C1 + CM));
+				auto t3 = _mm_madd_epi16 (s26, Factors (C1 + CP, C1));
+				auto x0 = _mm_add_epi32 (t0, t3), x3 = _mm_sub_epi32 (t0, t3);
+				auto x1 = _mm_add_epi32 (t1, t2), x2 = _mm_sub_epi32 (t1, t2);
+
+				// Odd Part (s7, s5, s3, s1 as t0, t1, t2, t3 of the Scalar)
+				auto o0 = _mm_add_epi32 (_mm_madd_epi16 (s13, Factors (A + B, A + D)),
+										 _mm_madd_epi16 (s57, Factors (A, K0 + A + B + D)));
+				auto o1 = _mm_add_epi32 (_mm_madd_epi16 (s13, Factors (A + E, A + C)),
+										 _mm_madd_epi16 (s57, Factors (K1 + A + C + E, A)));
+				auto o2 = _mm_add_epi32 (_mm_madd_epi16 (s13, Factors (A, K2 + A + C + D)),
+										 _mm_madd_epi16 (s57, Factors (A + C, A + D)));
+				auto o3 = _mm_add_epi32 (_mm_madd_epi16 (s13, Factors (K3 + A + B + E, A)),
+										 _mm_madd_epi16 (s57, Factors (A + E, A + B)));
+
+				auto res = out[half];
+				res[0] = _mm_srai_epi32 (_mm_add_epi32 (x0, o3), SHIFT);
+				res[7] = _mm_srai_epi32 (_mm_sub_epi32 (x0, o3), SHIFT);
+				res[1] = _mm_srai_epi32 (_mm_add_epi32 (x1, o2), SHIFT);
+				res[6] = _mm_srai_epi32 (_mm_sub_epi32 (x1, o2), SHIFT);
+				res[2] = _mm_srai_epi32 (_mm_add_epi32 (x2, o1), SHIFT);
+				res[5] = _mm_srai_epi32 (_mm_sub_epi32 (x2, o1), SHIFT);
+				res[3] = _mm_srai_epi32 (_mm_add_epi32 (x3, o0), SHIFT);
+				res[4] = _mm_srai_epi32 (_mm_sub_epi32 (x3, o0), SHIFT);
+			}
+			for (auto i = 0; i < 8; i++)
+				v[i] = _mm_packs_epi32 (out[0][i], out[1][i]);
+		}
+
+		// Same as the Scalar Idct, Bit by Bit, 8 Columns (then Rows) at once
+		void Idct (const int coeffs[64], unsigned char *out, ptrdiff_t stride)
+		{
+			__m128i v[8];
+			for (auto i = 0; i < 8; i++)
+				v[i] = _mm_packs_epi32 (_mm_loadu_si128 ((const __m128i *) (coeffs + i * 8)),
+										_mm_loadu_si128 ((const __m128i *) (coeffs + i * 8 + 4)));
+
+			// Columns, Clamped as ClampColumn
+			IdctPass<10> (v, 512);
+			auto lo = _mm_set1_epi16 (-16384), hi = _mm_set1_epi16 (16383);
+			for (auto i = 0; i < 8; i++)
+				v[i] = _mm_min_epi16 (_mm_max_epi16 (v[i], lo), hi);
+
+			// Rows, with Rounding and the +128 Level Shift
+			Transpose8x8 (v);
+			IdctPass<17> (v, 65536 + (128 << 17));
+			Transpose8x8 (v);
+			for (auto i = 0; i < 8; i++)
+				_mm_storel_epi64 ((__m128i *) (out + stride * i), _mm_packus_epi16 (v[i], v[i]));
+		}
+#else
+		void Idct (const int coeffs[64], unsigned char *out, ptrdiff_t stride)
+		{
+			int temp[64];
+
+			// Columns
+			for (auto i = 0; i < 8; i++)
+			{
+				auto d = coeffs + i;
+				auto v = temp + i;
+				if (!d[8] && !d[16] && !d[24] && !d[32] &&
+					!d[40] && !d[48] && !d[56])
+				{
+					auto dc = d[0] * 4;
+					v[0] = v[8] = v[16] = v[24] = v[32] = v[40] = v[48] = v[56] = dc;
+					continue;
+				}
+
+				EGGACHE_IDCT_1D (d[0], d[8], d[16], d[24], d[32], d[40], d[48], d[56])
+				x0 += 512; x1 += 512; x2 += 512; x3 += 512;
+				v[0] = ClampColumn ((x0 + t3) >> 10);
+				v[56] = ClampColumn ((x0 - t3) >> 10);
+				v[8] = ClampColumn ((x1 + t2) >> 10);
+				v[48] = ClampColumn ((x1 - t2) >> 10);
+				v[16] = ClampColumn ((x2 + t1) >> 10);
+				v[40] = ClampColumn ((x2 - t1) >> 10);
+				v[24] = ClampColumn ((x3 + t0) >> 10);
+				v[32] = ClampColumn ((x3 - t0) >> 10);
+			}
+
+			// Rows, with Rounding and the +128 Level Shift
+			for (auto i = 0; i < 8; i++)
+			{
+				auto v = temp + i * 8;
+				auto o = out + stride * i;
+				EGGACHE_IDCT_1D (v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7])
+				auto bias = 65536 + (128 << 17);
+				x0 += bias; x1 += bias; x2 += bias; x3 += bias;
+				o[0] = Clamp ((x0 + t3) >> 17);
+				o[7] = Clamp ((x0 - t3) >> 17);
+				o[1] = Clamp ((x1 + t2) >> 17);
+				o[6] = Clamp ((x1 - t2) >> 17);
+				o[2] = Clamp ((x2 + t1) >> 17);
+				o[5] = Clamp ((x2 - t1) >> 17);
+				o[3] = Clamp ((x3 + t0) >> 17);
+				o[4] = Clamp ((x3 - t0) >> 17);
+			}
+		}
+#endif
+
+#undef EGGACHE_IDCT_1D
+
+		// YCbCr to RGB (JFIF), Cb/Cr scaled by 2^7 and Factors by 2^11,
+		// so Terms carry 2 Fraction Bits for Rounding
+		const int CR_R = 2871, CB_G = 705, CR_G = 1463, CB_B = 3629;
+
+		void ConvertYCbCr (const unsigned char *ys, const unsigned char *cbs,
+						   const unsigned char *crs, int w, uint32_t *dst)
+		{
+			auto x = 0;
+#ifdef EGGACHE_GL_SSE2
+			auto zero = _mm_setzero_si128 ();
+			auto bias = _mm_set1_epi16 (128);
+			auto half = _mm_set1_epi16 (2);
+			auto alpha = _mm_set1_epi8 ((char) 0xFF);
+			for (; x + 8 <= w; x += 8)
+			{
+				auto y = _mm_add_epi16 (_mm_slli_epi16 (_mm_unpacklo_epi8 (
+					_mm_loadl_epi64 ((const __m128i *) (ys + x)), zero), 2), half);
+				auto cb = _mm_slli_epi16 (_mm_sub_epi16 (_mm_unpacklo_epi8 (
+					_mm_loadl_epi64 ((const __m128i *) (cbs + x)), zero), bias), 7);
+				auto cr = _mm_slli_epi16 (_mm_sub_epi16 (_mm_unpacklo_epi8 (
+					_mm_loadl_epi64 ((const __m128i *) (crs + x)), zero), bias), 7);
+
+				auto r = _mm_add_epi16 (y, _mm_mulhi_epi16 (cr, _mm_set1_epi16 (CR_R)));
+				auto g = _mm_sub_epi16 (_mm_sub_epi16 (
+					y, _mm_mulhi_epi16 (cb, _mm_set1_epi16 (CB_G))),
+					_mm_mulhi_epi16 (cr, _mm_set1_epi16 (CR_G)));
+				auto b = _mm_add_epi16 (y, _mm_mulhi_epi16 (cb, _mm_set1_epi16 (CB_B)));
+
+				r = _mm_srai_epi16 (r, 2);
+				g = _mm_srai_epi16 (g, 2);
+				b = _mm_srai_epi16 (b, 2);
+
+				// Saturate and Interleave into BGRA
+				auto b8 = _mm_packus_epi16 (b, b);
+				auto g8 = _mm_packus_epi16 (g, g);
+				auto r8 = _mm_packus_epi16 (r, r);
+				auto bg = _mm_unpacklo_epi8 (b8, g8);
+				auto ra = _mm_unpacklo_epi8 (r8, alpha);
+				_mm_storeu_si128 ((__m128i *) (dst + x), _mm_unpacklo_epi16 (bg, ra));
+				_mm_storeu_si128 ((__m128i *) (dst + x + 4), _mm_unpackhi_epi16 (bg, ra));
+			}
+#endif
+			for (; x < w; x++)
+			{
+				int y = ys[x] * 4 + 2, cb = (cbs[x] - 128) * 128, cr = (crs[x] - 128) * 128;
+				auto r = (y + ((cr * CR_R) >> 16)) >> 2;
+				auto g = (y - ((cb * CB_G) >> 16) - ((cr * CR_G) >> 16)) >> 2;
+				auto b = (y + ((cb * CB_B) >> 16)) >> 2;
+				dst[x] = 0xFF000000 | (Clamp (r) << 16) | (Clamp (g) << 8) | Clamp (b);
+			}
+		}
+
+		struct Component
+		{
+			int id, h, v, tq;
+			int td, ta;							// Huffman Tables of the Scan
+			int dcPred;
+			int wBlock, hBlock;					// Blocks covering the Component
+			ptrdiff_t stride;
+			std::vector<unsigned char> plane;	// Padded to whole MCUs
+		};
+
+		bool DecodeBlock (BitReader &reader, Component &comp,
+						  const Huffman &dc, const Huffman &ac,
+						  const unsigned short *qt, int bx, int by)
+		{
+			int coeffs[64];
+			memset (coeffs, 0, sizeof (coeffs));
+
+			auto t = dc.Decode (reader);
+			if (t < 0 || t > 16)
+				return false;
+			comp.dcPred = ClampCoeff (comp.dcPred + reader.Extend (t));
+			coeffs[0] = ClampCoeff (comp.dcPred * qt[0]);
+
+			for (auto k = 1; k < 64;)
+			{
+				auto rs = ac.Decode (reader);
+				if (rs < 0)
+					return false;
+				auto run = rs >> 4, s = rs & 15;
+				if (!s)
+				{
+					if (run != 15) break;		// End of Block
+					k += 16;
+					continue;
+				}
+				k += run;
+				if (k > 63)
+					return false;
+				coeffs[ZIGZAG[k]] = ClampCoeff (reader.Extend (s) * qt[k]);
+				k++;
+			}
+
+			Idct (coeffs, &comp.plane[(size_t) by * 8 * comp.stride + bx * 8], comp.stride);
+			return true;
+		}
+	}
+
+	std::shared_ptr<const ImageData> DecodeJpeg (const unsigned char *data,
+												 size_t size)
+	{
+		if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+			return nullptr;
+
+		unsigned short qts[4][64] = { { 0 } };
+		Huffman huffmans[8];					// DC 0-3, AC 4-7
+		std::vector<Component> comps;
+		auto w = 0, h = 0, hMax = 1, vMax = 1, wMcu = 0, hMcu = 0;
+		auto restartInterval = 0;
+		auto transform = -1;					// Adobe Color Transform
+		auto isFrameRead = false, isScanRead = false;
+
+		auto p = data + 2, end = data + size;
+		while (end - p >= 4)
+		{
+			// Find the next Marker (skipping Fill Bytes)
+			if (*p != 0xFF) { p++; continue; }
+			auto marker = p[1];
+			if (marker == 0xFF || marker == 0x00 ||
+				(marker >= 0xD0 && marker <= 0xD7)) { p++; continue; }
+			if (marker == 0xD9)
+				break;
+
+			auto len = (size_t) U16BE (p + 2);
+			auto body = p + 4, bodyEnd = p + 2 + len;
+			if (len < 2 || len > (size_t) (end - p - 2))
+				return nullptr;
+			p = bodyEnd;
+
+			switch (marker)
+			{
+			case 0xDB:		// DQT
+				while (bodyEnd - body >= 65)
+				{
+					auto pq = *body >> 4, tq = *body & 3;
+					body++;
+					if (bodyEnd - body < (pq ? 128 : 64))
+						return nullptr;
+					for (auto i = 0; i < 64; i++)
+						qts[tq][i] = (unsigned short) (pq ? U16BE (body + 2 * i) : body[i]);
+					body += pq ? 128 : 64;
+				}
+				break;
+
+			case 0xC4:		// DHT
+				while (bodyEnd - body >= 17)
+				{
+					auto tc = *body >> 4, th = *body & 3;
+					auto counts = body + 1;
+					auto cSym = 0;
+					for (auto i = 0; i < 16; i++) cSym += counts[i];
+					body += 17;
+					if (tc > 1 || cSym > 256 || bodyEnd - body < cSym ||
+						!huffmans[tc * 4 + th].Build (counts, body))
+						return nullptr;
+					body += cSym;
+				}
+				break;
+
+			case 0xDD:		// DRI
+				if (len < 4) return nullptr;
+				restartInterval = (int) U16BE (body);
+				break;
+
+			case 0xEE:		// APP14 (Adobe)
+				if (len >= 14 && !memcmp (body, "Adobe", 5))
+					transform = body[11];
+				break;
+
+			case 0xC0:		// SOF0 (Baseline)
+			case 0xC1:		// SOF1 (Extended Huffman)
+			{
+				if (isFrameRead || len < 8 || body[0] != 8)
+					return nullptr;
+				h = (int) U16BE (body + 1);
+				w = (int) U16BE (body + 3);
+				auto cComp = body[5];
+				if (w <= 0 || h <= 0 || (long long) w * h > MAX_PIXELS ||
+					(cComp != 1 && cComp != 3) || len < 8 + 3u * cComp)
+					return nullptr;
+
+				comps.resize (cComp);
+				for (auto i = 0; i < cComp; i++)
+				{
+					auto &comp = comps[i];
+					auto c = body + 6 + 3 * i;
+					comp.id = c[0];
+					comp.h = c[1] >> 4;
+					comp.v = c[1] & 15;
+					comp.tq = c[2] & 3;
+					if (comp.h < 1 || comp.h > 4 || comp.v < 1 || comp.v > 4)
+						return nullptr;
+					hMax = std::max (hMax, comp.h);
+					vMax = std::max (vMax, comp.v);
+				}
+
+				// Planes are padded to whole MCUs
+				wMcu = (w + hMax * 8 - 1) / (hMax * 8);
+				hMcu = (h + vMax * 8 - 1) / (vMax * 8);
+				for (auto &comp : comps)
+				{
+					comp.wBlock = (w * comp.h + hMax * 8 - 1) / (hMax * 8);
+					comp.hBlock = (h * comp.v + vMax * 8 - 1) / (vMax * 8);
+					comp.stride = (ptrdiff_t) wMcu * comp.h * 8;
+					comp.plane.assign ((size_t) comp.stride * hMcu * comp.v * 8, 0);
+				}
+				isFrameRead = true;
+				break;
+			}
+
+			case 0xDA:		// SOS
+			{
+				if (!isFrameRead || len < 6)
+					return nullptr;
+				auto cScan = body[0];
+				if (cScan < 1 || cScan > comps.size () || len < 6 + 2u * cScan)
+					return nullptr;
+
+				std::vector<Component *> scan;
+				for (auto i = 0; i < cScan; i++)
+				{
+					auto s = body + 1 + 2 * i;
+					auto it = std::find_if (comps.begin (), comps.end (),
+											[s] (const Component &c) { return c.id == s[0]; });
+					if (it == comps.end ())
+						return nullptr;
+					it->td = s[1] >> 4 & 3;
+					it->ta = s[1] & 3;
+					it->dcPred = 0;
+					scan.push_back (&*it);
+				}
+
+				// Entropy-coded Data follows the Header
+				BitReader reader (bodyEnd, end);
+				auto decode = [&] (Component &comp, int bx, int by)
+				{
+					return DecodeBlock (reader, comp,
+										huffmans[comp.td], huffmans[4 + comp.ta],
+										qts[comp.tq], bx, by);
+				};
+
+				// A Single Component Scan is not Interleaved
+				auto isInterleaved = scan.size () > 1;
+				auto cUnitX = isInterleaved ? wMcu : scan[0]->wBlock;
+				auto cUnitY = isInterleaved ? hMcu : scan[0]->hBlock;
+				auto cUnit = 0;
+				for (auto uy = 0; uy < cUnitY; uy++)
+					for (auto ux = 0; ux < cUnitX; ux++)
+					{
+						if (restartInterval && cUnit && cUnit % restartInterval == 0)
+						{
+							if (!reader.Restart ())
+								return nullptr;
+							for (auto comp : scan)
+								comp->dcPred = 0;
+						}
+						cUnit++;
+
+						if (!isInterleaved)
+						{
+							if (!decode (*scan[0], ux, uy))
+								return nullptr;
+							continue;
+						}
+						for (auto comp : scan)
+							for (auto by = 0; by < comp->v; by++)
+								for (auto bx = 0; bx < comp->h; bx++)
+									if (!decode (*comp, ux * comp->h + bx, uy * comp->v + by))
+										return nullptr;
+					}
+
+				p = reader.Position ();
+				isScanRead = true;
+				break;
+			}
+
+			case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+			case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+				return nullptr;					// Progressive, Lossless or Arithmetic
+
+			default:
+				break;							// APPn, COM...
+			}
+		}
+
+		if (!isScanRead)
+			return nullptr;
+
+		// Replicate the Subsampled Components, and Convert Colors
+		auto image = std::make_shared<ImageData> ();
+		image->w = w;
+		image->h = h;
+		image->hasAlpha = false;
+		image->pixels.resize ((size_t) w * h);
+
+		auto cComp = comps.size ();
+		std::vector<unsigned char> rows (cComp * w);
+		std::vector<std::vector<int>> xSrcs (cComp);
+		for (size_t c = 0; c < cComp; c++)
+		{
+			xSrcs[c].resize (w);
+			for (auto x = 0; x < w; x++)
+				xSrcs[c][x] = x * comps[c].h / hMax;
+		}
+
+		for (auto y = 0; y < h; y++)
+		{
+			for (size_t c = 0; c < cComp; c++)
+			{
+				auto &comp = comps[c];
+				auto src = &comp.plane[(size_t) (y * comp.v / vMax) * comp.stride];
+				auto row = &rows[c * w];
+				if (comp.h == hMax)
+					memcpy (row, src, w);
+				else
+					for (auto x = 0; x < w; x++)
+						row[x] = src[xSrcs[c][x]];
+			}
+
+			auto dst = &image->pixels[(size_t) y * w];
+			if (cComp == 1)
+			{
+				for (auto x = 0; x < w; x++)
+					dst[x] = 0xFF000000 | (rows[x] * 0x010101u);
+			}
+			else if (transform == 0)
+			{
+				for (auto x = 0; x < w; x++)
+					dst[x] = 0xFF000000 | (rows[x] << 16) |
+					(rows[w + x] << 8) | rows[2 * w + x];
+			}
+			else
+				ConvertYCbCr (&rows[0], &rows[w], &rows[2 * w], w, dst);
+		}
+
+		image->bits = (const unsigned char *) image->pixels.data ();
+		image->stride = (ptrdiff_t) w * 4;
+		return image;
+	}
+
+	// JPEG Encoding
+
+	namespace
+	{
+		// Tables of Annex K, Quantization in Natural Order
+		const unsigned char LUMA_QUANT[64] = {
+			16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+			14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+			18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+			49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99 };
+
+		const unsigned char CHROMA_QUANT[64] = {
+			17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+			24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+			99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+			99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99 };
+
+		const unsigned char DC_LUMA_BITS[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+		const unsigned char DC_CHROMA_BITS[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+		const unsigned char DC_VALUES[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+		const unsigned char AC_LUMA_BITS[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D };
+		const unsigned char AC_LUMA_VALUES[162] = {
+			0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+			0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+			0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+			0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+			0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+			0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+			0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+			0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+			0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+			0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+			0xF9, 0xFA };
+
+		const unsigned char AC_CHROMA_BITS[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+		const unsigned char AC_CHROMA_VALUES[162] = {
+			0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+			0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+			0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+			0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+			0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+			0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+			0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+			0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+			0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+			0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+			0xF9, 0xFA };
+
+		// Scale Factors of the AAN DCT
+		const float AAN_SCALES[8] = {
+			1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+			1.0f, 0.785694958f, 0.541196100f, 0.275899379f };
+
+		// Baseline Huffman Categories are at most 11 Bits
+		const int MAX_COEFF = 1023;
+
+		// Code and Length of each Symbol
+		struct HuffmanCodes
+		{
+			unsigned short codes[256];
+			unsigned char sizes[256];
+
+			HuffmanCodes (const unsigned char *bits, const unsigned char *values)
+			{
+				memset (sizes, 0, sizeof (sizes));
+				unsigned code = 0;
+				auto k = 0;
+				for (auto len = 1; len <= 16; len++, code <<= 1)
+					for (auto i = 0; i < bits[len - 1]; i++, code++, k++)
+					{
+						codes[values[k]] = (unsigned short) code;
+						sizes[values[k]] = (unsigned char) len;
+					}
+			}
+		};
+
+		// Entropy-coded Bits, MSB first, with 0xFF00 Stuffing
+		class BitWriter
+		{
+		public:
+			BitWriter (std::vector<unsigned char> &out)
+				: out (out), bits (0), cBits (0)
+			{}
+
+			void Put (uint32_t value, int n)
+			{
+				// Bytes are Flushed 4 at a time
+				bits = (bits << n) | value;
+				cBits += n;
+				if (cBits >= 32)
+				{
+					cBits -= 32;
+					auto word = (uint32_t) (bits >> cBits);
+					for (auto i = 24; i >= 0; i -= 8)
+					{
+						auto b = (unsigned char) (word >> i);
+						out.push_back (b);
+						if (b == 0xFF)
+							out.push_back (0);
+					}
+				}
+			}
+
+			void Flush ()
+			{
+				// Pad with 1 Bits to a whole Byte
+				auto cPad = (8 - cBits % 8) % 8;
+				bits = (bits << cPad) | ((1u << cPad) - 1);
+				cBits += cPad;
+				while (cBits)
+				{
+					cBits -= 8;
+					auto b = (unsigned char) (bits >> cBits);
+					out.push_back (b);
+					if (b == 0xFF)
+						out.push_back (0);
+				}
+			}
+
+		private:
+			std::vector<unsigned char> &out;
+			uint64_t bits;
+			int cBits;
+		};
+
+		inline float Add (float a, float b) { return a + b; }
+		inline float Sub (float a, float b) { return a - b; }
+		inline float Mul (float a, float c) { return a * c; }
+#ifdef EGGACHE_GL_SSE2
+		inline __m128 Add (__m128 a, __m128 b) { return _mm_add_ps (a, b); }
+		inline __m128 Sub (__m128 a, __m128 b) { return _mm_sub_ps (a, b); }
+		inline __m128 Mul (__m128 a, float c) { return _mm_mul_ps (a, _mm_set1_ps (c)); }
+#endif
+
+		// AAN Forward DCT (Float of the IJG) on 8 Samples,
+		// scaled by AAN_SCALES of both Axes and 8
+		template <typename T>
+		inline void Fdct8 (T *d, ptrdiff_t step)
+		{
+			auto t0 = Add (d[0], d[7 * step]), t7 = Sub (d[0], d[7 * step]);
+			auto t1 = Add (d[step], d[6 * step]), t6 = Sub (d[step], d[6 * step]);
+			auto t2 = Add (d[2 * step], d[5 * step]), t5 = Sub (d[2 * step], d[5 * step]);
+			auto t3 = Add (d[3 * step], d[4 * step]), t4 = Sub (d[3 * step], d[4 * step]);
+
+			// Even Part
+			auto t10 = Add (t0, t3), t13 = Sub (t0, t3);
+			auto t11 = Add (t1, t2), t12 = Sub (t1, t2);
+			d[0] = Add (t10, t11);
+			d[4 * step] = Sub (t10, t11);
+			auto z1 = Mul (Add (t12, t13), 0.707106781f);
+			d[2 * step] = Add (t13, z1);
+			d[6 * step] = Sub (t13, z1);
+
+			// Odd Part
+			t10 = Add (t4, t5);
+			t11 = Add (t5, t6);
+			t12 = Add (t6, t7);
+			auto z5 = Mul (Sub (t10, t12), 0.382683433f);
+			auto z2 = Add (Mul (t10, 0.541196100f), z5);
+			auto z4 = Add (Mul (t12, 1.306562965f), z5);
+			auto z3 = Mul (t11, 0.707106781f);
+			auto z11 = Add (t7, z3), z13 = Sub (t7, z3);
+			d[5 * step] = Add (z13, z2);
+			d[3 * step] = Sub (z13, z2);
+			d[step] = Add (z11, z4);
+			d[7 * step] = Sub (z11, z4);
+		}
+
+		inline int16_t ClampQuantized (int x)
+		{
+			return (int16_t) (x < -MAX_COEFF ? -MAX_COEFF : x > MAX_COEFF ? MAX_COEFF : x);
+		}
+
+		// DCT of the 8x8 Samples at src, Quantized by Reciprocals
+		// Both are in Transposed Order (Column * 8 + Row)
+		void FdctQuantize (const float *src, size_t stride,
+						   const float *recips, int16_t *out)
+		{
+#ifdef EGGACHE_GL_SSE2
+			// Columns (Rows Vertically), Transpose, and then Rows
+			__m128 lo[8], hi[8];
+			for (auto r = 0; r < 8; r++)
+			{
+				lo[r] = _mm_loadu_ps (src + r * stride);
+				hi[r] = _mm_loadu_ps (src + r * stride + 4);
+			}
+			Fdct8 (lo, 1);
+			Fdct8 (hi, 1);
+
+			__m128 tlo[8] = { lo[0], lo[1], lo[2], lo[3], hi[0], hi[1], hi[2], hi[3] };
+			__m128 thi[8] = { lo[4], lo[5], lo[6], lo[7], hi[4], hi[5], hi[6], hi[7] };
+			_MM_TRANSPOSE4_PS (tlo[0], tlo[1], tlo[2], tlo[3]);
+			_MM_TRANSPOSE4_PS (tlo[4], tlo[5], tlo[6], tlo[7]);
+			_MM_TRANSPOSE4_PS (thi[0], thi[1], thi[2], thi[3]);
+			_MM_TRANSPOSE4_PS (thi[4], thi[5], thi[6], thi[7]);
+			Fdct8 (tlo, 1);
+			Fdct8 (thi, 1);
+
+			auto maxCoeff = _mm_set1_epi16 (MAX_COEFF);
+			auto minCoeff = _mm_set1_epi16 (-MAX_COEFF);
+			for (auto u = 0; u < 8; u++)
+			{
+				auto q0 = _mm_cvtps_epi32 (_mm_mul_ps (tlo[u], _mm_loadu_ps (recips + u * 8)));
+				auto q1 = _mm_cvtps_epi32 (_mm_mul_ps (thi[u], _mm_loadu_ps (recips + u * 8 + 4)));
+				auto q = _mm_max_epi16 (_mm_min_epi16 (_mm_packs_epi32 (q0, q1), maxCoeff), minCoeff);
+				_mm_storeu_si128 ((__m128i *) (out + u * 8), q);
+			}
+#else
+			float temp[64];
+			for (auto r = 0; r < 8; r++)
+				memcpy (temp + r * 8, src + r * stride, 8 * sizeof (float));
+			for (auto c = 0; c < 8; c++)
+				Fdct8 (temp + c, 8);
+			for (auto r = 0; r < 8; r++)
+				Fdct8 (temp + r * 8, 1);
+
+			for (auto u = 0; u < 8; u++)
+				for (auto k = 0; k < 8; k++)
+					out[u * 8 + k] = ClampQuantized (
+						(int) std::lrint (temp[k * 8 + u] * recips[u * 8 + k]));
+#endif
+		}
+
+		// Huffman Category (Bit Length) of Magnitudes below 2048
+		struct Categories
+		{
+			unsigned char bits[2048];
+
+			Categories ()
+			{
+				bits[0] = 0;
+				for (auto i = 1; i < 2048; i++)
+					bits[i] = (unsigned char) (bits[i / 2] + 1);
+			}
+		};
+		const Categories categories;
+
+		inline int BitLength (unsigned x)
+		{
+			return categories.bits[x];
+		}
+
+		void EncodeBlock (BitWriter &writer, const int16_t *coeffs,
+						  const unsigned char *order, int &dcPred,
+						  const HuffmanCodes &dc, const HuffmanCodes &ac)
+		{
+			auto diff = coeffs[0] - dcPred;
+			dcPred = coeffs[0];
+			auto n = BitLength ((unsigned) (diff < 0 ? -diff : diff));
+			writer.Put (dc.codes[n], dc.sizes[n]);
+			if (n)
+				writer.Put ((unsigned) (diff < 0 ? diff - 1 : diff) & ((1u << n) - 1), n);
+
+			auto run = 0;
+			for (auto k = 1; k < 64; k++)
+			{
+				int value = coeffs[order[k]];
+				if (!value)
+				{
+					run++;
+					continue;
+				}
+				for (; run >= 16; run -= 16)
+					writer.Put (ac.codes[0xF0], ac.sizes[0xF0]);
+
+				n = BitLength ((unsigned) (value < 0 ? -value : value));
+				auto symbol = (run << 4) | n;
+				writer.Put (ac.codes[symbol], ac.sizes[symbol]);
+				writer.Put ((unsigned) (value < 0 ? value - 1 : value) & ((1u << n) - 1), n);
+				run = 0;
+			}
+			if (run)
+				writer.Put (ac.codes[0], ac.sizes[0]);
+		}
+
+		// RGB to Level-shifted YCbCr (JFIF)
+		void ConvertRGB (const uint32_t *src, int w,
+						 float *ys, float *cbs, float *crs)
+		{
+			auto x = 0;
+#ifdef EGGACHE_GL_SSE2
+			auto byte = _mm_set1_epi32 (0xFF);
+			for (; x + 4 <= w; x += 4)
+			{
+				auto p = _mm_loadu_si128 ((const __m128i *) (src + x));
+				auto r = _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (p, 16), byte));
+				auto g = _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (p, 8), byte));
+				auto b = _mm_cvtepi32_ps (_mm_and_si128 (p, byte));
+				_mm_storeu_ps (ys + x, _mm_sub_ps (Add (Add (Mul (r, 0.299f), Mul (g, 0.587f)),
+														Mul (b, 0.114f)), _mm_set1_ps (128.0f)));
+				_mm_storeu_ps (cbs + x, Add (Sub (Mul (b, 0.5f), Mul (r, 0.168736f)),
+											 Mul (g, -0.331264f)));
+				_mm_storeu_ps (crs + x, Sub (Sub (Mul (r, 0.5f), Mul (g, 0.418688f)),
+											 Mul (b, 0.081312f)));
+			}
+#endif
+			for (; x < w; x++)
+			{
+				auto r = (float) ((src[x] >> 16) & 0xFF);
+				auto g = (float) ((src[x] >> 8) & 0xFF);
+				auto b = (float) (src[x] & 0xFF);
+				ys[x] = r * 0.299f + g * 0.587f + b * 0.114f - 128.0f;
+				cbs[x] = b * 0.5f - r * 0.168736f + g * -0.331264f;
+				crs[x] = r * 0.5f - g * 0.418688f - b * 0.081312f;
+			}
+		}
+
+		inline void PutMarker (std::vector<unsigned char> &out, int marker, size_t length)
+		{
+			out.push_back (0xFF);
+			out.push_back ((unsigned char) marker);
+			out.push_back ((unsigned char) (length >> 8));
+			out.push_back ((unsigned char) length);
+		}
+
+		void PutHuffmanTable (std::vector<unsigned char> &out, int classId,
+							  const unsigned char *bits, const unsigned char *values)
+		{
+			auto count = 0;
+			for (auto i = 0; i < 16; i++)
+				count += bits[i];
+			out.push_back ((unsigned char) classId);
+			out.insert (out.end (), bits, bits + 16);
+			out.insert (out.end (), values, values + count);
+		}
+	}
+
+	bool EncodeJpeg (const Surface &surface, int quality,
+					 std::vector<unsigned char> &out)
+	{
+		auto w = surface.w, h = surface.h;
+		if (w <= 0 || h <= 0 || w > 0xFFFF || h > 0xFFFF)
+			return false;
+
+		// Quality Scaling as libjpeg
+		quality = std::min (std::max (quality, 1), 100);
+		auto scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+		auto isSubsampled = quality < 90;
+		auto sub = isSubsampled ? 2 : 1;
+
+		unsigned char quants[2][64];
+		float recips[2][64];
+		for (auto i = 0; i < 64; i++)
+		{
+			const unsigned char *bases[2] = { LUMA_QUANT, CHROMA_QUANT };
+			for (auto t = 0; t < 2; t++)
+			{
+				auto q = std::min (std::max ((bases[t][i] * scale + 50) / 100, 1), 255);
+				quants[t][i] = (unsigned char) q;
+
+				// Transposed, with the AAN Scales folded in
+				auto k = i / 8, u = i % 8;
+				recips[t][u * 8 + k] = 1.0f / (q * AAN_SCALES[k] * AAN_SCALES[u] * 8.0f);
+			}
+		}
+
+		// Headers: SOI, JFIF, DQT, SOF0, DHT and SOS
+		out.clear ();
+		out.reserve ((size_t) w * h / 4 + 1024);
+		const unsigned char jfif[] = {
+			0xFF, 0xD8, 0xFF, 0xE0, 0, 16, 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 };
+		out.insert (out.end (), jfif, jfif + sizeof (jfif));
+
+		PutMarker (out, 0xDB, 2 + 65 * 2);
+		for (auto t = 0; t < 2; t++)
+		{
+			out.push_back ((unsigned char) t);
+			for (auto k = 0; k < 64; k++)
+				out.push_back (quants[t][ZIGZAG[k]]);
+		}
+
+		PutMarker (out, 0xC0, 17);
+		const unsigned char frame[] = {
+			8, (unsigned char) (h >> 8), (unsigned char) h, (unsigned char) (w >> 8), (unsigned char) w,
+			3, 1, (unsigned char) ((sub << 4) | sub), 0, 2, 0x11, 1, 3, 0x11, 1 };
+		out.insert (out.end (), frame, frame + sizeof (frame));
+
+		PutMarker (out, 0xC4, 2 + 4 * 17 + 2 * 12 + 2 * 162);
+		PutHuffmanTable (out, 0x00, DC_LUMA_BITS, DC_VALUES);
+		PutHuffmanTable (out, 0x10, AC_LUMA_BITS, AC_LUMA_VALUES);
+		PutHuffmanTable (out, 0x01, DC_CHROMA_BITS, DC_VALUES);
+		PutHuffmanTable (out, 0x11, AC_CHROMA_BITS, AC_CHROMA_VALUES);
+
+		PutMarker (out, 0xDA, 12);
+		const unsigned char scan[] = { 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 };
+		out.insert (out.end (), scan, scan + sizeof (scan));
+
+		static const HuffmanCodes dcLuma (DC_LUMA_BITS, DC_VALUES);
+		static const HuffmanCodes acLuma (AC_LUMA_BITS, AC_LUMA_VALUES);
+		static const HuffmanCodes dcChroma (DC_CHROMA_BITS, DC_VALUES);
+		static const HuffmanCodes acChroma (AC_CHROMA_BITS, AC_CHROMA_VALUES);
+
+		// Zigzag into the Transposed Order of FdctQuantize
+		unsigned char order[64];
+		for (auto k = 0; k < 64; k++)
+			order[k] = (unsigned char) ((ZIGZAG[k] % 8) * 8 + ZIGZAG[k] / 8);
+
+		// Planes of an MCU Row, Padded by the Edge Pixels
+		auto mcuSize = 8 * sub;
+		auto stride = (size_t) (w + mcuSize - 1) / mcuSize * mcuSize;
+		std::vector<float> planes (stride * mcuSize * 3);
+		auto ys = planes.data (), cbs = ys + stride * mcuSize, crs = cbs + stride * mcuSize;
+
+		BitWriter writer (out);
+		int dcPreds[3] = { 0, 0, 0 };
+		int16_t coeffs[64];
+		for (auto y0 = 0; y0 < h; y0 += mcuSize)
+		{
+			for (auto j = 0; j < mcuSize; j++)
+			{
+				auto offset = j * stride;
+				if (y0 + j < h)
+				{
+					ConvertRGB (surface.Row (y0 + j), w, ys + offset, cbs + offset, crs + offset);
+					for (auto x = (size_t) w; x < stride; x++)
+					{
+						ys[offset + x] = ys[offset + w - 1];
+						cbs[offset + x] = cbs[offset + w - 1];
+						crs[offset + x] = crs[offset + w - 1];
+					}
+				}
+				else
+				{
+					memcpy (ys + offset, ys + offset - stride, stride * sizeof (float));
+					memcpy (cbs + offset, cbs + offset - stride, stride * sizeof (float));
+					memcpy (crs + offset, crs + offset - stride, stride * sizeof (float));
+				}
+			}
+
+			// 2x2 Averaged in place, into the Top-left Quarter
+			if (isSubsampled)
+				for (auto j = 0; j < 8; j++)
+					for (size_t x = 0; x < stride / 2; x++)
+					{
+						auto p = 2 * j * stride + 2 * x;
+						cbs[j * stride + x] = (cbs[p] + cbs[p + 1] +
+											   cbs[p + stride] + cbs[p + stride + 1]) * 0.25f;
+						crs[j * stride + x] = (crs[p] + crs[p + 1] +
+											   crs[p + stride] + crs[p + stride + 1]) * 0.25f;
+					}
+
+			for (size_t x0 = 0; x0 < stride; x0 += mcuSize)
+			{
+				for (auto by = 0; by < sub; by++)
+					for (auto bx = 0; bx < sub; bx++)
+					{
+						FdctQuantize (ys + by * 8 * stride + x0 + bx * 8, stride, recips[0], coeffs);
+						EncodeBlock (writer, coeffs, order, dcPreds[0], dcLuma, acLuma);
+					}
+
+				auto xChroma = x0 / sub;
+				FdctQuantize (cbs + xChroma, stride, recips[1], coeffs);
+				EncodeBlock (writer, coeffs, order, dcPreds[1], dcChroma, acChroma);
+				FdctQuantize (crs + xChroma, stride, recips[1], coeffs);
+				EncodeBlock (writer, coeffs, order, dcPreds[2], dcChroma, acChroma);
+			}
+		}
+
+		writer.Flush ();
+		out.push_back (0xFF);
+		out.push_back (0xD9);
+		return true;
+	}
+}
@@ -0,0 +1,233 @@
+//
+// Portable Asset Pack of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#include <algorithm>
+#include <fstream>
+
+#include "EggAche_Pack.h"
+
+namespace EggAche_Impl
+{
+	// Asset Pack
+
+	namespace
+	{
+		const char PACK_MAGIC[8] = { 'E', 'G', 'G', 'A', 'P', 'A', 'C', 'K' };
+		const uint32_t PACK_VERSION = 1;
+		const size_t HEADER_SIZE = 32;
+		const size_t ENTRY_SIZE = 32;
+		const size_t PIXEL_ALIGN = 16;
+
+		// Layout:
+		// Header:  Magic, Version, cEntry, cBucket, cbNames, Reserved (8)
+		// Buckets: cBucket * (Entry Index + 1, or 0 if Empty), Linear Probing
+		// Entries: Hash, Name Offset, Name Length, w, h, Flags, Pixel Offset (8)
+		// Names:   cbNames Bytes, not Terminated
+		// Pixels:  w * h * 4 Bytes of each Entry, Aligned to 16
+
+		inline uint32_t U32 (const unsigned char *p)
+		{
+			return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+		}
+
+		inline unsigned long long U64 (const unsigned char *p)
+		{
+			return U32 (p) | ((unsigned long long) U32 (p + 4) << 32);
+		}
+
+		inline void Put32 (std::vector<unsigned char> &out, uint32_t value)
+		{
+			for (auto i = 0; i < 4; i++)
+				out.push_back ((unsigned char) (value >> (8 * i)));
+		}
+
+		// FNV-1a
+		inline uint32_t HashName (const std::string &name)
+		{
+			uint32_t hash = 2166136261u;
+			for (auto ch : name)
+				hash = (hash ^ (unsigned char) ch) * 16777619u;
+			return hash;
+		}
+	}
+
+	std::string AssetPackData::NormalizeName (const char *name)
+	{
+		std::string ret (name ? name : "");
+		std::replace (ret.begin (), ret.end (), '\\', '/');
+		while (ret.compare (0, 2, "./") == 0)
+			ret.erase (0, 2);
+		return ret;
+	}
+
+	bool AssetPackData::Save (const char *fileName,
+							  const std::vector<std::string> &names,
+							  const std::vector<std::shared_ptr<const ImageData>> &images)
+	{
+		if (names.size () != images.size ())
+			return false;
+
+		// Buckets at most Half Full
+		size_t cBucket = 1;
+		while (cBucket < names.size () * 2)
+			cBucket *= 2;
+		std::vector<uint32_t> buckets (cBucket, 0);
+
+		std::vector<std::string> keys;
+		size_t cbNames = 0;
+		for (size_t i = 0; i < names.size (); i++)
+		{
+			keys.push_back (NormalizeName (names[i].c_str ()));
+			cbNames += keys[i].size ();
+
+			auto slot = HashName (keys[i]) & (cBucket - 1);
+			for (; buckets[slot]; slot = (slot + 1) & (cBucket - 1))
+				if (keys[buckets[slot] - 1] == keys[i])
+					return false;
+			buckets[slot] = (uint32_t) i + 1;
+		}
+
+		// Header, Buckets, Entries and Names, followed by the Aligned Pixels
+		std::vector<unsigned char> index (PACK_MAGIC, PACK_MAGIC + 8);
+		Put32 (index, PACK_VERSION);
+		Put32 (index, (uint32_t) names.size ());
+		Put32 (index, (uint32_t) cBucket);
+		Put32 (index, (uint32_t) cbNames);
+		Put32 (index, 0);
+		Put32 (index, 0);
+		for (auto bucket : buckets)
+			Put32 (index, bucket);
+
+		auto offset = HEADER_SIZE + cBucket * 4 + names.size () * ENTRY_SIZE + cbNames;
+		std::vector<size_t> offsets;
+		size_t nameOffset = 0;
+		for (size_t i = 0; i < names.size (); i++)
+		{
+			offset = (offset + PIXEL_ALIGN - 1) / PIXEL_ALIGN * PIXEL_ALIGN;
+			offsets.push_back (offset);
+			Put32 (index, HashName (keys[i]));
+			Put32 (index, (uint32_t) nameOffset);
+			Put32 (index, (uint32_t) keys[i].size ());
+			Put32 (index, (uint32_t) images[i]->w);
+			Put32 (index, (uint32_t) images[i]->h);
+			Put32 (index, images[i]->hasAlpha ? 1 : 0);
+			Put32 (index, (uint32_t) offset);
+			Put32 (index, (uint32_t) ((unsigned long long) offset >> 32));
+			nameOffset += keys[i].size ();
+			offset += (size_t) images[i]->w * images[i]->h * 4;
+		}
+		for (const auto &key : keys)
+			index.insert (index.end (), key.begin (), key.end ());
+
+		std::ofstream file (fileName, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+		file.write ((const char *) index.data (), (std::streamsize) index.size ());
+
+		// Opaque Images get their Undefined Alpha filled
+		auto written = index.size ();
+		const char padding[PIXEL_ALIGN] = { 0 };
+		std::vector<uint32_t> row;
+		for (size_t i = 0; i < images.size (); i++)
+		{
+			const auto &image = *images[i];
+			auto alpha = image.hasAlpha ? 0u : 0xFF000000u;
+			file.write (padding, (std::streamsize) (offsets[i] - written));
+			row.resize ((size_t) image.w);
+			for (auto y = 0; y < image.h; y++)
+			{
+				for (auto x = 0; x < image.w; x++)
+					row[x] = image.Pixel (x, y) | alpha;
+				file.write ((const char *) row.data (), (std::streamsize) image.w * 4);
+			}
+			written = offsets[i] + (size_t) image.w * image.h * 4;
+		}
+		return (bool) file;
+	}
+
+	std::unique_ptr<AssetPackData> AssetPackData::Load (const char *fileName)
+	{
+		auto file = MappedFile::Map (fileName);
+		if (!file)
+			return nullptr;
+
+		auto data = file->Data ();
+		auto size = file->Size ();
+		if (size < HEADER_SIZE || !std::equal (PACK_MAGIC, PACK_MAGIC + 8, (const char *) data) ||
+			U32 (data + 8) != PACK_VERSION)
+			return nullptr;
+
+		auto cEntry = (size_t) U32 (data + 12);
+		auto cBucket = (size_t) U32 (data + 16);
+		auto cbNames = (size_t) U32 (data + 20);
+		if (!cBucket || (cBucket & (cBucket - 1)) || cEntry > cBucket ||
+			cBucket > (size - HEADER_SIZE) / 4 ||
+			cEntry > (size - HEADER_SIZE - cBucket * 4) / ENTRY_SIZE ||
+			cbNames > size - HEADER_SIZE - cBucket * 4 - cEntry * ENTRY_SIZE)
+			return nullptr;
+
+		std::unique_ptr<AssetPackData> pack (new AssetPackData ());
+		pack->buckets = data + HEADER_SIZE;
+		pack->entries = pack->buckets + cBucket * 4;
+		pack->names = pack->entries + cEntry * ENTRY_SIZE;
+		pack->cEntry = cEntry;
+		pack->cBucket = cBucket;
+
+		// Check the Index only, so the Pixels stay untouched until Drawn
+		for (size_t i = 0; i < cEntry; i++)
+		{
+			auto p = pack->entries + i * ENTRY_SIZE;
+			auto nameEnd = (unsigned long long) U32 (p + 4) + U32 (p + 8);
+			auto w = (unsigned long long) U32 (p + 12), h = (unsigned long long) U32 (p + 16);
+			auto offset = U64 (p + 24);
+			if (nameEnd > cbNames ||
+				!w || !h || w > (1 << 16) || h > (1 << 16) ||
+				offset % 4 || offset > size || w * h * 4 > size - offset)
+				return nullptr;
+		}
+
+		pack->file = file;
+		pack->views.resize (cEntry);
+		return pack;
+	}
+
+	std::shared_ptr<const ImageData> AssetPackData::Find (const char *name) const
+	{
+		// Probe from the Bucket of the Hash, until an Empty one
+		auto key = NormalizeName (name);
+		auto hash = HashName (key);
+		auto slot = hash & (cBucket - 1);
+		for (size_t cProbe = 0; cProbe < cBucket; cProbe++, slot = (slot + 1) & (cBucket - 1))
+		{
+			auto bucket = (size_t) U32 (buckets + slot * 4);
+			if (!bucket)
+				return nullptr;
+			if (bucket > cEntry)
+				continue;
+
+			auto p = entries + (bucket - 1) * ENTRY_SIZE;
+			if (U32 (p) != hash || U32 (p + 8) != key.size () ||
+				!std::equal (key.begin (), key.end (), (const char *) names + U32 (p + 4)))
+				continue;
+
+			// Views are Made on first Find, and Shared later
+			std::lock_guard<std::mutex> lg (mtx);
+			auto &view = views[bucket - 1];
+			if (!view)
+			{
+				auto image = std::make_shared<ImageData> ();
+				image->w = (int) U32 (p + 12);
+				image->h = (int) U32 (p + 16);
+				image->bits = file->Data () + U64 (p + 24);
+				image->stride = (ptrdiff_t) image->w * 4;
+				image->hasAlpha = (U32 (p + 20) & 1) != 0;
+				image->file = file;
+				view = image;
+			}
+			return view;
+		}
+		return nullptr;
+	}
+}
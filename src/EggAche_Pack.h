@@ -0,0 +1,59 @@
+//
+// Portable Asset Pack of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#ifndef EGGACHE_GL_PACK
+#define EGGACHE_GL_PACK
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "EggAche_Image.h"
+
+namespace EggAche_Impl
+{
+	// Decoded Images in a single File, Indexed by Name
+	class AssetPackData
+	{
+	public:
+		static std::unique_ptr<AssetPackData> Load (const char *fileName);
+		// Remarks:
+		// 1. Only the Index is Checked, and no Pixel is Touched,
+		//    so Opening costs the same for any Size;
+		// 2. Return nullptr if the File is not a Saved Pack;
+
+		static bool Save (const char *fileName,
+						  const std::vector<std::string> &names,
+						  const std::vector<std::shared_ptr<const ImageData>> &images);
+		// Remarks:
+		// 1. Pixels are Saved as the Canvas-native 32-bit BGRA Rows,
+		//    each Image Aligned to 16 Bytes;
+		// 2. Return false if a Name is Duplicated;
+
+		static std::string NormalizeName (const char *name);
+		// Remarks:
+		// Use '/' as the Separator, and drop the Leading "./";
+
+		size_t Count () const { return cEntry; }
+
+		std::shared_ptr<const ImageData> Find (const char *name) const;
+		// Remarks:
+		// 1. Return the same View of the Mapped Pixels for the same Name,
+		//    so Caches keyed by Images keep working;
+		// 2. Return nullptr if name is not in the Pack;
+
+	private:
+		AssetPackData () {}
+
+		std::shared_ptr<const MappedFile> file;
+		const unsigned char *buckets, *entries, *names;
+		size_t cEntry, cBucket;
+
+		mutable std::mutex mtx;
+		mutable std::vector<std::shared_ptr<const ImageData>> views;
+	};
+}
+
+#endif  //EGGACHE_GL_PACK
@@ -0,0 +1,761 @@
+//
+// Portable PNG Codec of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "EggAche_Image.h"
+#include "EggAche_Zlib.h"
+
+#ifdef EGGACHE_GL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace EggAche_Impl
+{
+	// PNG Decoding
+
+	namespace
+	{
+		// Guard against Headers claiming Gigantic Sizes
+		const long long MAX_PIXELS = 1 << 28;
+
+		enum
+		{
+			COLOR_GRAY = 0,
+			COLOR_RGB = 2,
+			COLOR_PALETTE = 3,
+			COLOR_GRAY_ALPHA = 4,
+			COLOR_RGBA = 6
+		};
+
+		enum
+		{
+			FILTER_NONE = 0,
+			FILTER_SUB = 1,
+			FILTER_UP = 2,
+			FILTER_AVG = 3,
+			FILTER_PAETH = 4
+		};
+
+		inline uint32_t U32BE (const unsigned char *p)
+		{
+			return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+		}
+
+		inline int Paeth (int a, int b, int c)
+		{
+			auto pa = abs (b - c), pb = abs (a - c), pc = abs (a + b - 2 * c);
+			if (pa <= pb && pa <= pc) return a;
+			return pb <= pc ? b : c;
+		}
+
+#ifdef EGGACHE_GL_SSE2
+		// Avg and Paeth chain Pixel by Pixel, but the Channels
+		// of a 3/4-byte Pixel are done at once in 16-bit Lanes
+		inline __m128i LoadPixel (const unsigned char *p, int bpp)
+		{
+			uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) |
+				(bpp == 4 ? (uint32_t) p[3] << 24 : 0);
+			return _mm_unpacklo_epi8 (_mm_cvtsi32_si128 ((int) v),
+									  _mm_setzero_si128 ());
+		}
+
+		inline void StorePixel (unsigned char *p, __m128i v, int bpp)
+		{
+			auto u = (uint32_t) _mm_cvtsi128_si32 (_mm_packus_epi16 (v, v));
+			p[0] = (unsigned char) u;
+			p[1] = (unsigned char) (u >> 8);
+			p[2] = (unsigned char) (u >> 16);
+			if (bpp == 4) p[3] = (unsigned char) (u >> 24);
+		}
+
+		// Paeth Predictor of 16-bit Lanes
+		inline __m128i PaethSse2 (__m128i a, __m128i b, __m128i c)
+		{
+			// pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|
+			auto zero = _mm_setzero_si128 ();
+			auto bc = _mm_sub_epi16 (b, c);
+			auto ac = _mm_sub_epi16 (a, c);
+			auto pa = _mm_max_epi16 (bc, _mm_sub_epi16 (zero, bc));
+			auto pb = _mm_max_epi16 (ac, _mm_sub_epi16 (zero, ac));
+			auto abc = _mm_add_epi16 (ac, bc);
+			auto pc = _mm_max_epi16 (abc, _mm_sub_epi16 (zero, abc));
+
+			// a if (pa <= pb && pa <= pc), else b if (pb <= pc), else c
+			auto notA = _mm_or_si128 (_mm_cmpgt_epi16 (pa, pb),
+									  _mm_cmpgt_epi16 (pa, pc));
+			auto isC = _mm_cmpgt_epi16 (pb, pc);
+			auto bOrC = _mm_or_si128 (_mm_and_si128 (isC, c),
+									  _mm_andnot_si128 (isC, b));
+			return _mm_or_si128 (_mm_and_si128 (notA, bOrC),
+								 _mm_andnot_si128 (notA, a));
+		}
+
+		void UnfilterAvgSse2 (unsigned char *cur, const unsigned char *prev,
+							  size_t cb, int bpp)
+		{
+			auto mask = _mm_set1_epi16 (0xFF);
+			auto a = _mm_setzero_si128 ();
+			for (size_t i = 0; i + bpp <= cb; i += bpp)
+			{
+				auto b = LoadPixel (prev + i, bpp);
+				auto x = LoadPixel (cur + i, bpp);
+				a = _mm_and_si128 (_mm_add_epi16 (
+					x, _mm_srli_epi16 (_mm_add_epi16 (a, b), 1)), mask);
+				StorePixel (cur + i, a, bpp);
+			}
+		}
+
+		void UnfilterPaethSse2 (unsigned char *cur, const unsigned char *prev,
+								size_t cb, int bpp)
+		{
+			auto zero = _mm_setzero_si128 ();
+			auto mask = _mm_set1_epi16 (0xFF);
+			auto a = zero, c = zero;
+			for (size_t i = 0; i + bpp <= cb; i += bpp)
+			{
+				auto b = LoadPixel (prev + i, bpp);
+				auto x = LoadPixel (cur + i, bpp);
+				a = _mm_and_si128 (_mm_add_epi16 (x, PaethSse2 (a, b, c)), mask);
+				c = b;
+				StorePixel (cur + i, a, bpp);
+			}
+		}
+#endif
+
+		bool Unfilter (unsigned char filter, unsigned char *cur,
+					   const unsigned char *prev, size_t cb, int bpp)
+		{
+			switch (filter)
+			{
+			case FILTER_NONE:
+				break;
+
+			case FILTER_SUB:
+				for (size_t i = bpp; i < cb; i++)
+					cur[i] = (unsigned char) (cur[i] + cur[i - bpp]);
+				break;
+
+			case FILTER_UP:
+				for (size_t i = 0; i < cb; i++)
+					cur[i] = (unsigned char) (cur[i] + prev[i]);
+				break;
+
+			case FILTER_AVG:
+#ifdef EGGACHE_GL_SSE2
+				if (bpp == 3 || bpp == 4)
+				{
+					UnfilterAvgSse2 (cur, prev, cb, bpp);
+					break;
+				}
+#endif
+				for (size_t i = 0; i < (size_t) bpp && i < cb; i++)
+					cur[i] = (unsigned char) (cur[i] + prev[i] / 2);
+				for (size_t i = bpp; i < cb; i++)
+					cur[i] = (unsigned char) (cur[i] + (cur[i - bpp] + prev[i]) / 2);
+				break;
+
+			case FILTER_PAETH:
+#ifdef EGGACHE_GL_SSE2
+				if (bpp == 3 || bpp == 4)
+				{
+					UnfilterPaethSse2 (cur, prev, cb, bpp);
+					break;
+				}
+#endif
+				for (size_t i = 0; i < (size_t) bpp && i < cb; i++)
+					cur[i] = (unsigned char) (cur[i] + prev[i]);
+				for (size_t i = bpp; i < cb; i++)
+					cur[i] = (unsigned char) (cur[i] +
+						Paeth (cur[i - bpp], prev[i], prev[i - bpp]));
+				break;
+
+			default:
+				return false;
+			}
+			return true;
+		}
+
+		struct PngHeader
+		{
+			int w, h;
+			int depth, colorType, channels;
+			std::vector<uint32_t> palette;		// BGRA
+			bool hasKey;						// tRNS of Gray/RGB
+			unsigned key[3];
+		};
+
+		// Unpack a Row of Samples into BGRA
+		void ConvertRow (const PngHeader &hdr, const unsigned char *row,
+						 int w, uint32_t *dst)
+		{
+			auto depth = hdr.depth;
+			auto sample = [&] (int index) -> unsigned
+			{
+				if (depth == 8) return row[index];
+				if (depth == 16) return (row[index * 2] << 8) | row[index * 2 + 1];
+				auto bit = index * depth;
+				return (row[bit / 8] >> (8 - depth - bit % 8)) & ((1u << depth) - 1);
+			};
+			auto to8 = [&] (unsigned v) -> uint32_t
+			{
+				if (depth == 16) return v >> 8;
+				if (depth == 8) return v;
+				return v * 255 / ((1u << depth) - 1);
+			};
+
+			for (auto x = 0; x < w; x++)
+			{
+				uint32_t r, g, b, a = 255;
+				switch (hdr.colorType)
+				{
+				case COLOR_PALETTE:
+				{
+					auto index = sample (x);
+					dst[x] = index < hdr.palette.size () ?
+						hdr.palette[index] : 0xFF000000;
+					continue;
+				}
+				case COLOR_GRAY:
+				{
+					auto v = sample (x);
+					r = g = b = to8 (v);
+					if (hdr.hasKey && v == hdr.key[0]) a = 0;
+					break;
+				}
+				case COLOR_GRAY_ALPHA:
+					r = g = b = to8 (sample (2 * x));
+					a = to8 (sample (2 * x + 1));
+					break;
+				case COLOR_RGB:
+				{
+					auto vr = sample (3 * x), vg = sample (3 * x + 1), vb = sample (3 * x + 2);
+					r = to8 (vr); g = to8 (vg); b = to8 (vb);
+					if (hdr.hasKey && vr == hdr.key[0] &&
+						vg == hdr.key[1] && vb == hdr.key[2]) a = 0;
+					break;
+				}
+				default:
+					r = to8 (sample (4 * x));
+					g = to8 (sample (4 * x + 1));
+					b = to8 (sample (4 * x + 2));
+					a = to8 (sample (4 * x + 3));
+					break;
+				}
+				dst[x] = (a << 24) | (r << 16) | (g << 8) | b;
+			}
+		}
+
+		// Unfilter a (Sub) Image of w * h, and Scatter it into image
+		bool DecodePass (const PngHeader &hdr, const unsigned char *&p,
+						 const unsigned char *end,
+						 int x0, int y0, int dx, int dy,
+						 ImageData &image)
+		{
+			auto w = (image.w - x0 + dx - 1) / dx;
+			auto h = (image.h - y0 + dy - 1) / dy;
+			if (w <= 0 || h <= 0)
+				return true;
+
+			auto bitsPerPixel = hdr.depth * hdr.channels;
+			auto cbRow = ((size_t) w * bitsPerPixel + 7) / 8;
+			auto bpp = std::max (1, bitsPerPixel / 8);
+			if ((size_t) (end - p) < (cbRow + 1) * h)
+				return false;
+
+			std::vector<unsigned char> rows (cbRow * 2, 0);
+			auto cur = &rows[0], prev = &rows[cbRow];
+			std::vector<uint32_t> pixels (w);
+			for (auto y = 0; y < h; y++)
+			{
+				std::swap (cur, prev);
+				auto filter = *p++;
+				std::copy (p, p + cbRow, cur);
+				p += cbRow;
+				if (!Unfilter (filter, cur, prev, cbRow, bpp))
+					return false;
+
+				if (dx == 1)
+				{
+					ConvertRow (hdr, cur, w, &image.pixels[(size_t) (y0 + y * dy) * image.w]);
+					continue;
+				}
+				ConvertRow (hdr, cur, w, pixels.data ());
+				auto dst = &image.pixels[(size_t) (y0 + y * dy) * image.w];
+				for (auto x = 0; x < w; x++)
+					dst[x0 + x * dx] = pixels[x];
+			}
+			return true;
+		}
+	}
+
+	std::shared_ptr<const ImageData> DecodePng (const unsigned char *data,
+												size_t size)
+	{
+		static const unsigned char SIGNATURE[8] = {
+			0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		if (size < 8 || !std::equal (SIGNATURE, SIGNATURE + 8, data))
+			return nullptr;
+
+		PngHeader hdr;
+		hdr.hasKey = false;
+		auto interlace = 0;
+		auto isHeaderRead = false;
+		std::vector<unsigned char> idat;
+		std::vector<unsigned char> alphas;
+
+		// Walk the Chunks (CRCs are not checked)
+		for (auto p = data + 8; ;)
+		{
+			// Tolerate a Missing IEND
+			if ((size_t) (data + size - p) < 12)
+			{
+				if (idat.empty ())
+					return nullptr;
+				break;
+			}
+			auto len = (size_t) U32BE (p);
+			auto type = p + 4;
+			auto body = p + 8;
+			if (len > (size_t) (data + size - body) - 4)
+				return nullptr;
+			p = body + len + 4;
+
+			if (std::equal (type, type + 4, "IHDR"))
+			{
+				if (len < 13)
+					return nullptr;
+				hdr.w = (int) U32BE (body);
+				hdr.h = (int) U32BE (body + 4);
+				hdr.depth = body[8];
+				hdr.colorType = body[9];
+				interlace = body[12];
+				if (hdr.w <= 0 || hdr.h <= 0 ||
+					(long long) hdr.w * hdr.h > MAX_PIXELS ||
+					body[10] != 0 || body[11] != 0 || interlace > 1)
+					return nullptr;
+
+				auto depth = hdr.depth;
+				switch (hdr.colorType)
+				{
+				case COLOR_GRAY: hdr.channels = 1;
+					if (depth != 1 && depth != 2 && depth != 4 &&
+						depth != 8 && depth != 16) return nullptr;
+					break;
+				case COLOR_PALETTE: hdr.channels = 1;
+					if (depth != 1 && depth != 2 && depth != 4 &&
+						depth != 8) return nullptr;
+					break;
+				case COLOR_RGB: hdr.channels = 3; break;
+				case COLOR_GRAY_ALPHA: hdr.channels = 2; break;
+				case COLOR_RGBA: hdr.channels = 4; break;
+				default: return nullptr;
+				}
+				if (hdr.colorType != COLOR_GRAY && hdr.colorType != COLOR_PALETTE &&
+					depth != 8 && depth != 16)
+					return nullptr;
+				isHeaderRead = true;
+			}
+			else if (!isHeaderRead)
+				return nullptr;
+			else if (std::equal (type, type + 4, "PLTE"))
+			{
+				hdr.palette.clear ();
+				for (size_t i = 0; i + 3 <= len && i < 256 * 3; i += 3)
+					hdr.palette.push_back (0xFF000000 |
+						(body[i] << 16) | (body[i + 1] << 8) | body[i + 2]);
+			}
+			else if (std::equal (type, type + 4, "tRNS"))
+			{
+				if (hdr.colorType == COLOR_PALETTE)
+					alphas.assign (body, body + std::min (len, (size_t) 256));
+				else if (hdr.colorType == COLOR_GRAY && len >= 2)
+				{
+					hdr.hasKey = true;
+					hdr.key[0] = (body[0] << 8) | body[1];
+				}
+				else if (hdr.colorType == COLOR_RGB && len >= 6)
+				{
+					hdr.hasKey = true;
+					for (auto i = 0; i < 3; i++)
+						hdr.key[i] = (body[2 * i] << 8) | body[2 * i + 1];
+				}
+			}
+			else if (std::equal (type, type + 4, "IDAT"))
+				idat.insert (idat.end (), body, body + len);
+			else if (std::equal (type, type + 4, "IEND"))
+				break;
+			else if (!(type[0] & 0x20))
+				return nullptr;					// Unknown Critical Chunk
+		}
+
+		if (hdr.colorType == COLOR_PALETTE && hdr.palette.empty ())
+			return nullptr;
+		for (size_t i = 0; i < alphas.size () && i < hdr.palette.size (); i++)
+			hdr.palette[i] = (hdr.palette[i] & 0xFFFFFF) | ((uint32_t) alphas[i] << 24);
+
+		// Filtered Rows of all Passes
+		auto bitsPerPixel = (size_t) hdr.depth * hdr.channels;
+		auto sizeHint = ((size_t) hdr.w * bitsPerPixel + 7) / 8 * hdr.h + hdr.h;
+		std::vector<unsigned char> raw;
+		if (!Inflate (idat.data (), idat.size (), raw,
+					  interlace ? sizeHint + sizeHint / 8 : sizeHint))
+			return nullptr;
+		idat.clear ();
+
+		auto image = std::make_shared<ImageData> ();
+		image->w = hdr.w;
+		image->h = hdr.h;
+		image->pixels.resize ((size_t) hdr.w * hdr.h);
+
+		auto p = (const unsigned char *) raw.data ();
+		auto end = p + raw.size ();
+		if (!interlace)
+		{
+			if (!DecodePass (hdr, p, end, 0, 0, 1, 1, *image))
+				return nullptr;
+		}
+		else
+		{
+			// Adam7 Passes: (x0, y0, dx, dy)
+			static const int PASSES[7][4] = {
+				{ 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 },
+				{ 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+			for (const auto &pass : PASSES)
+				if (!DecodePass (hdr, p, end,
+								 pass[0], pass[1], pass[2], pass[3], *image))
+					return nullptr;
+		}
+
+		image->bits = (const unsigned char *) image->pixels.data ();
+		image->stride = (ptrdiff_t) hdr.w * 4;
+		image->hasAlpha = std::any_of (
+			image->pixels.begin (), image->pixels.end (),
+			[] (uint32_t pixel) { return (pixel >> 24) != 0xFF; });
+		return image;
+	}
+
+	// PNG Encoding
+
+	namespace
+	{
+		const size_t IDAT_SIZE = 65536;
+		const uint32_t RGB_MASK = 0xFFFFFF;
+		const int CENSUS_SLOTS = 512;			// Twice MAX_COLORS, for Short Probes
+
+		inline unsigned char *Put32BE (unsigned char *p, uint32_t value)
+		{
+			p[0] = (unsigned char) (value >> 24);
+			p[1] = (unsigned char) (value >> 16);
+			p[2] = (unsigned char) (value >> 8);
+			p[3] = (unsigned char) value;
+			return p + 4;
+		}
+
+		// Filter the Row cur (above it prev) by type into out,
+		// and return the Sum of the Bytes taken as Signed
+		unsigned FilterRow (int type, const unsigned char *cur,
+							const unsigned char *prev, size_t size,
+							size_t bpp, unsigned char *out)
+		{
+			// The first Pixel has no Left Neighbors (a = c = 0),
+			// so Paeth picks b, as Up does
+			size_t i = 0;
+			for (; i < bpp && i < size; i++)
+				out[i] = (unsigned char) (cur[i] -
+					(type == FILTER_UP || type == FILTER_PAETH ? prev[i] :
+					 type == FILTER_AVG ? prev[i] >> 1 : 0));
+			unsigned sum = 0;
+			for (size_t j = 0; j < i; j++)
+				sum += (unsigned) abs ((signed char) out[j]);
+
+#ifdef EGGACHE_GL_SSE2
+			// Unlike Unfiltering, no Byte depends on another's Result,
+			// so 16 Bytes are Filtered at a time
+			{
+				auto zero = _mm_setzero_si128 ();
+				auto one = _mm_set1_epi8 (1);
+				auto acc = zero;
+				for (; i + 16 <= size; i += 16)
+				{
+					auto x = _mm_loadu_si128 ((const __m128i *) (cur + i));
+					auto a = _mm_loadu_si128 ((const __m128i *) (cur + i - bpp));
+					auto b = _mm_loadu_si128 ((const __m128i *) (prev + i));
+					__m128i pred;
+					switch (type)
+					{
+					case FILTER_NONE: pred = zero; break;
+					case FILTER_SUB: pred = a; break;
+					case FILTER_UP: pred = b; break;
+					case FILTER_AVG:
+						// avg_epu8 Rounds up, but Avg Rounds down
+						pred = _mm_sub_epi8 (_mm_avg_epu8 (a, b),
+											 _mm_and_si128 (_mm_xor_si128 (a, b), one));
+						break;
+					default:				// FILTER_PAETH
+					{
+						auto c = _mm_loadu_si128 ((const __m128i *) (prev + i - bpp));
+						pred = _mm_packus_epi16 (
+							PaethSse2 (_mm_unpacklo_epi8 (a, zero),
+									   _mm_unpacklo_epi8 (b, zero),
+									   _mm_unpacklo_epi8 (c, zero)),
+							PaethSse2 (_mm_unpackhi_epi8 (a, zero),
+									   _mm_unpackhi_epi8 (b, zero),
+									   _mm_unpackhi_epi8 (c, zero)));
+						break;
+					}
+					}
+					auto d = _mm_sub_epi8 (x, pred);
+					_mm_storeu_si128 ((__m128i *) (out + i), d);
+
+					// |d| as Signed is min (d, -d) as Unsigned
+					acc = _mm_add_epi64 (acc, _mm_sad_epu8 (
+						_mm_min_epu8 (d, _mm_sub_epi8 (zero, d)), zero));
+				}
+				sum += (unsigned) (_mm_cvtsi128_si32 (acc) +
+								   _mm_cvtsi128_si32 (_mm_srli_si128 (acc, 8)));
+			}
+#endif
+
+			// The rest, with the Switch out of the Loops
+			auto begin = i;
+			switch (type)
+			{
+			case FILTER_SUB:
+				for (; i < size; i++)
+					out[i] = (unsigned char) (cur[i] - cur[i - bpp]);
+				break;
+			case FILTER_UP:
+				for (; i < size; i++)
+					out[i] = (unsigned char) (cur[i] - prev[i]);
+				break;
+			case FILTER_AVG:
+				for (; i < size; i++)
+					out[i] = (unsigned char) (cur[i] - ((cur[i - bpp] + prev[i]) >> 1));
+				break;
+			case FILTER_PAETH:
+				for (; i < size; i++)
+					out[i] = (unsigned char) (cur[i] -
+						Paeth (cur[i - bpp], prev[i], prev[i - bpp]));
+				break;
+			default:
+				memcpy (out + i, cur + i, size - i);
+				break;
+			}
+			for (; begin < size; begin++)
+				sum += (unsigned) abs ((signed char) out[begin]);
+			return sum;
+		}
+
+		inline unsigned HashColor (uint32_t color)
+		{
+			return (color * 2654435761u) >> 23;
+		}
+
+		// Count the Pixels from row[x] on having the Color of prev
+		inline int RunLength (const uint32_t *row, int x, int w, uint32_t prev)
+		{
+			auto begin = x;
+#ifdef EGGACHE_GL_SSE2
+			auto rgb = _mm_set1_epi32 ((int) RGB_MASK);
+			auto key = _mm_set1_epi32 ((int) prev);
+			for (; x + 4 <= w; x += 4)
+				if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (_mm_and_si128 (
+					_mm_loadu_si128 ((const __m128i *) (row + x)), rgb), key)) != 0xFFFF)
+					break;
+#endif
+			while (x < w && (row[x] & RGB_MASK) == prev)
+				x++;
+			return x - begin;
+		}
+	}
+
+	const int ColorCensus::MAX_COLORS;
+
+	ColorCensus::ColorCensus ()
+		: slots (CENSUS_SLOTS, -1), isOver (false)
+	{
+		colors.reserve (MAX_COLORS);
+	}
+
+	bool ColorCensus::Add (const Surface &rows)
+	{
+		if (isOver)
+			return false;
+
+		for (auto y = 0; y < rows.h; y++)
+		{
+			auto row = rows.Row (y);
+			for (auto x = 0; x < rows.w;)
+			{
+				auto color = row[x] & RGB_MASK;
+				auto slot = HashColor (color);
+				while (slots[slot] >= 0 && colors[slots[slot]] != color)
+					slot = (slot + 1) % CENSUS_SLOTS;
+				if (slots[slot] < 0)
+				{
+					if (colors.size () == MAX_COLORS)
+					{
+						isOver = true;
+						return false;
+					}
+					slots[slot] = (int) colors.size ();
+					colors.push_back (color);
+				}
+				x += RunLength (row, x, rows.w, color);
+			}
+		}
+		return true;
+	}
+
+	int ColorCensus::IndexOf (uint32_t color) const
+	{
+		color &= RGB_MASK;
+		for (auto slot = HashColor (color); slots[slot] >= 0;
+			 slot = (slot + 1) % CENSUS_SLOTS)
+			if (colors[slots[slot]] == color)
+				return slots[slot];
+		return -1;
+	}
+
+	PngEncoder::PngEncoder (int w, int h, const ImageWriter &writer,
+							const ColorCensus *census, int level)
+		: w (w), h (h), y (0), isOk (w > 0 && h > 0), writer (writer), depth (0),
+		deflater (level)
+	{
+		// Fewer Colors are Packed into fewer Bits
+		if (census && !census->IsOver ())
+		{
+			palette = *census;
+			auto cColor = palette.Colors ().size ();
+			depth = cColor <= 2 ? 1 : cColor <= 4 ? 2 : cColor <= 16 ? 4 : 8;
+		}
+	}
+
+	bool PngEncoder::AddRows (const Surface &rows)
+	{
+		if (!isOk || rows.w != w || rows.h > h - y)
+			return isOk = false;
+
+		if (prev.empty ())
+		{
+			// Signature, IHDR (not Interlaced) and PLTE (if Indexed)
+			static const unsigned char SIGNATURE[8] = {
+				0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			unsigned char header[13];
+			Put32BE (Put32BE (header, (uint32_t) w), (uint32_t) h);
+			header[8] = (unsigned char) (depth ? depth : 8);
+			header[9] = depth ? COLOR_PALETTE : COLOR_RGB;
+			header[10] = header[11] = header[12] = 0;
+			if (!writer (SIGNATURE, sizeof (SIGNATURE)) ||
+				!WriteChunk ("IHDR", header, sizeof (header)))
+				return isOk = false;
+
+			if (depth)
+			{
+				std::vector<unsigned char> entries;
+				for (auto color : palette.Colors ())
+				{
+					entries.push_back ((unsigned char) (color >> 16));
+					entries.push_back ((unsigned char) (color >> 8));
+					entries.push_back ((unsigned char) color);
+				}
+				if (!WriteChunk ("PLTE", entries.data (), entries.size ()))
+					return isOk = false;
+			}
+
+			// The Row above the First is taken as Zeros
+			auto cbRow = depth ? ((size_t) w * depth + 7) / 8 : (size_t) w * 3;
+			prev.assign (cbRow, 0);
+			cur.resize (cbRow);
+			best.resize (cbRow + 1);
+			filtered.resize (cbRow + 1);
+		}
+
+		auto cbRow = cur.size ();
+		for (auto i = 0; i < rows.h; i++)
+		{
+			auto row = rows.Row (i);
+			if (depth)
+			{
+				// Indexes are Packed from the MSB
+				std::fill (cur.begin (), cur.end (), 0);
+				auto index = 0;
+				auto last = ~0u;
+				for (auto x = 0; x < w; x++)
+				{
+					if ((row[x] & RGB_MASK) != last)
+					{
+						last = row[x] & RGB_MASK;
+						index = palette.IndexOf (last);
+						if (index < 0)
+							return isOk = false;
+					}
+					auto bit = (size_t) x * depth;
+					cur[bit / 8] |= (unsigned char) (
+						index << (8 - depth - (int) (bit % 8)));
+				}
+			}
+			else
+				for (auto x = 0; x < w; x++)
+				{
+					cur[x * 3] = (unsigned char) (row[x] >> 16);
+					cur[x * 3 + 1] = (unsigned char) (row[x] >> 8);
+					cur[x * 3 + 2] = (unsigned char) row[x];
+				}
+
+			// Each Filter is tried, and the Best kept
+			auto bestSum = ~0u;
+			for (auto type = (int) FILTER_NONE; type <= FILTER_PAETH; type++)
+			{
+				filtered[0] = (unsigned char) type;
+				auto sum = FilterRow (type, cur.data (), prev.data (), cbRow,
+									  depth ? 1 : 3, filtered.data () + 1);
+				if (sum < bestSum)
+				{
+					bestSum = sum;
+					best.swap (filtered);
+				}
+			}
+			prev.swap (cur);
+
+			deflater.Write (best.data (), best.size (), idat);
+			if (idat.size () >= IDAT_SIZE)
+			{
+				if (!WriteChunk ("IDAT", idat.data (), idat.size ()))
+					return isOk = false;
+				idat.clear ();
+			}
+		}
+		y += rows.h;
+		return true;
+	}
+
+	bool PngEncoder::Finish ()
+	{
+		if (!isOk || y != h)
+			return false;
+
+		deflater.Finish (idat);
+		isOk = WriteChunk ("IDAT", idat.data (), idat.size ()) &&
+			WriteChunk ("IEND", nullptr, 0);
+		idat.clear ();
+		return isOk;
+	}
+
+	bool PngEncoder::WriteChunk (const char *type, const unsigned char *data,
+								 size_t size)
+	{
+		// Length, Type, Data, and CRC of Type and Data
+		unsigned char header[8], trailer[4];
+		Put32BE (header, (uint32_t) size);
+		memcpy (header + 4, type, 4);
+		Put32BE (trailer, Crc32 (Crc32 (0, header + 4, 4), data, size));
+		return writer (header, sizeof (header)) &&
+			(!size || writer (data, size)) &&
+			writer (trailer, sizeof (trailer));
+	}
+}
@@ -0,0 +1,269 @@
+//
+// Portable QOI Codec of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#include <algorithm>
+
+#include "EggAche_Image.h"
+
+#ifdef EGGACHE_GL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace EggAche_Impl
+{
+	// QOI (Quite OK Image)
+
+	namespace
+	{
+		// Guard against Headers claiming Gigantic Sizes
+		const long long MAX_PIXELS = 1 << 28;
+
+		const size_t HEADER_SIZE = 14;
+		const size_t PADDING_SIZE = 8;
+		const unsigned char PADDING[PADDING_SIZE] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+		enum
+		{
+			OP_INDEX = 0x00,
+			OP_DIFF = 0x40,
+			OP_LUMA = 0x80,
+			OP_RUN = 0xC0,
+			OP_RGB = 0xFE,
+			OP_RGBA = 0xFF,
+			OP_MASK = 0xC0
+		};
+
+		const int MAX_RUN = 62;
+		const uint32_t RGB_MASK = 0xFFFFFF;
+		const uint32_t OPAQUE = 0xFF000000;
+
+		// (r * 3 + g * 5 + b * 7 + a * 11) % 64 of 0xAARRGGBB in one Multiply:
+		// Spread the Channels 16 Bits apart, so every Product of the Sum
+		// lands on Bit 56, and the others fall below it or off the Top
+		inline unsigned Hash (uint32_t pixel)
+		{
+			auto v = (uint64_t) (pixel & 0x00FF00FF) |
+				((uint64_t) (pixel & 0xFF00FF00) << 24);
+			return (unsigned) ((v * ((7ull << 56) | (3ull << 40) |
+									 (5ull << 24) | (11ull << 8))) >> 56) & 63;
+		}
+
+		inline uint32_t U32BE (const unsigned char *p)
+		{
+			return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+		}
+
+		inline unsigned char *Put32BE (unsigned char *p, uint32_t value)
+		{
+			p[0] = (unsigned char) (value >> 24);
+			p[1] = (unsigned char) (value >> 16);
+			p[2] = (unsigned char) (value >> 8);
+			p[3] = (unsigned char) value;
+			return p + 4;
+		}
+
+		// Count the Pixels from row[x] on having the Color of prev
+		inline int RunLength (const uint32_t *row, int x, int w, uint32_t prev)
+		{
+			auto begin = x;
+			prev &= RGB_MASK;
+#ifdef EGGACHE_GL_SSE2
+			auto rgb = _mm_set1_epi32 ((int) RGB_MASK);
+			auto key = _mm_set1_epi32 ((int) prev);
+			for (; x + 4 <= w; x += 4)
+				if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (_mm_and_si128 (
+					_mm_loadu_si128 ((const __m128i *) (row + x)), rgb), key)) != 0xFFFF)
+					break;
+#endif
+			while (x < w && (row[x] & RGB_MASK) == prev)
+				x++;
+			return x - begin;
+		}
+	}
+
+	bool EncodeQoi (const Surface &surface, std::vector<unsigned char> &out)
+	{
+		auto w = surface.w, h = surface.h;
+		if (w <= 0 || h <= 0 || (long long) w * h > MAX_PIXELS)
+			return false;
+
+		unsigned char header[HEADER_SIZE] = { 'q', 'o', 'i', 'f' };
+		Put32BE (Put32BE (header + 4, (uint32_t) w), (uint32_t) h);
+		header[12] = 3;							// RGB, since Alpha is Undefined
+		header[13] = 0;							// sRGB
+		out.assign (header, header + HEADER_SIZE);
+
+		// Each Row is Encoded into chunk and then Appended,
+		// so out is never Filled to the Worst Case of 4 Bytes a Pixel
+		// (plus a Run carried in, the last Run and the Padding)
+		std::vector<unsigned char> chunk ((size_t) w * 4 + 2 + PADDING_SIZE);
+		uint32_t index[64] = { 0 };
+		auto prev = OPAQUE;
+		auto run = 0;
+		for (auto y = 0; y < h; y++)
+		{
+			auto row = surface.Row (y);
+			auto p = chunk.data ();
+			for (auto x = 0; x < w;)
+			{
+				auto pixel = row[x] | OPAQUE;
+				if (pixel == prev)
+				{
+					// Runs go on across Rows
+					auto len = RunLength (row, x, w, prev);
+					x += len;
+					run += len;
+					for (; run >= MAX_RUN; run -= MAX_RUN)
+						*p++ = (unsigned char) (OP_RUN | (MAX_RUN - 1));
+					continue;
+				}
+				if (run)
+				{
+					*p++ = (unsigned char) (OP_RUN | (run - 1));
+					run = 0;
+				}
+
+				auto hash = Hash (pixel);
+				if (index[hash] == pixel)
+					*p++ = (unsigned char) (OP_INDEX | hash);
+				else
+				{
+					index[hash] = pixel;
+
+					// Differences wrap around as Bytes, and are Biased
+					// to be Checked in a single Compare of each Op
+					auto dr = (signed char) ((pixel >> 16) - (prev >> 16));
+					auto dg = (signed char) ((pixel >> 8) - (prev >> 8));
+					auto db = (signed char) (pixel - prev);
+					if (((unsigned) (dr + 2) | (unsigned) (dg + 2) | (unsigned) (db + 2)) < 4)
+						*p++ = (unsigned char) (OP_DIFF |
+							((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+					else if (((unsigned) (dr - dg + 8) | (unsigned) (db - dg + 8)) < 16 &&
+							 (unsigned) (dg + 32) < 64)
+					{
+						*p++ = (unsigned char) (OP_LUMA | (dg + 32));
+						*p++ = (unsigned char) (((dr - dg + 8) << 4) | (db - dg + 8));
+					}
+					else
+					{
+						*p++ = OP_RGB;
+						*p++ = (unsigned char) (pixel >> 16);
+						*p++ = (unsigned char) (pixel >> 8);
+						*p++ = (unsigned char) pixel;
+					}
+				}
+				prev = pixel;
+				x++;
+			}
+
+			if (y == h - 1)
+			{
+				if (run)
+					*p++ = (unsigned char) (OP_RUN | (run - 1));
+				p = std::copy (PADDING, PADDING + PADDING_SIZE, p);
+			}
+			out.insert (out.end (), chunk.data (), p);
+		}
+		return true;
+	}
+
+	std::shared_ptr<const ImageData> DecodeQoi (
+		const unsigned char *data, size_t size)
+	{
+		if (size < HEADER_SIZE + PADDING_SIZE || memcmp (data, "qoif", 4))
+			return nullptr;
+		auto w = (int) U32BE (data + 4);
+		auto h = (int) U32BE (data + 8);
+		auto channels = data[12];
+		if (w <= 0 || h <= 0 || (long long) w * h > MAX_PIXELS ||
+			(channels != 3 && channels != 4))
+			return nullptr;
+
+		auto image = std::make_shared<ImageData> ();
+		image->w = w;
+		image->h = h;
+		image->pixels.resize ((size_t) w * h);
+
+		// Ops never reach into the Padding
+		auto p = data + HEADER_SIZE;
+		auto end = data + size - PADDING_SIZE;
+		auto dst = image->pixels.data ();
+		auto dstEnd = dst + image->pixels.size ();
+
+		uint32_t index[64] = { 0 };
+		auto pixel = OPAQUE;
+		while (dst < dstEnd)
+		{
+			if (p >= end)
+				return nullptr;
+
+			auto op = *p++;
+			if (op == OP_RGB || op == OP_RGBA)
+			{
+				auto n = op == OP_RGB ? 3 : 4;
+				if (end - p < n)
+					return nullptr;
+				pixel = (op == OP_RGB ? pixel & OPAQUE : (uint32_t) p[3] << 24) |
+					(p[0] << 16) | (p[1] << 8) | p[2];
+				p += n;
+			}
+			else
+			{
+				switch (op & OP_MASK)
+				{
+				case OP_INDEX:
+					pixel = index[op];
+					*dst++ = pixel;
+					continue;					// Already in the Index
+
+				case OP_DIFF:
+				{
+					auto dr = ((op >> 4) & 3) - 2;
+					auto dg = ((op >> 2) & 3) - 2;
+					auto db = (op & 3) - 2;
+					pixel = (pixel & OPAQUE) |
+						(((pixel >> 16) + dr) & 0xFF) << 16 |
+						(((pixel >> 8) + dg) & 0xFF) << 8 |
+						((pixel + db) & 0xFF);
+					break;
+				}
+
+				case OP_LUMA:
+				{
+					if (p >= end)
+						return nullptr;
+					auto dg = (op & 0x3F) - 32;
+					auto dr = dg + (*p >> 4) - 8;
+					auto db = dg + (*p & 0xF) - 8;
+					p++;
+					pixel = (pixel & OPAQUE) |
+						(((pixel >> 16) + dr) & 0xFF) << 16 |
+						(((pixel >> 8) + dg) & 0xFF) << 8 |
+						((pixel + db) & 0xFF);
+					break;
+				}
+
+				default:						// OP_RUN
+				{
+					// The Initial Pixel goes into the Index by a Leading Run
+					index[Hash (pixel)] = pixel;
+					auto len = std::min ((ptrdiff_t) (op & 0x3F) + 1, dstEnd - dst);
+					dst = std::fill_n (dst, len, pixel);
+					continue;
+				}
+				}
+			}
+			index[Hash (pixel)] = pixel;
+			*dst++ = pixel;
+		}
+
+		image->bits = (const unsigned char *) image->pixels.data ();
+		image->stride = (ptrdiff_t) w * 4;
+		image->hasAlpha = channels == 4 && std::any_of (
+			image->pixels.begin (), image->pixels.end (),
+			[] (uint32_t pixel) { return (pixel >> 24) != 0xFF; });
+		return image;
+	}
+}
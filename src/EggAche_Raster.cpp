@@ -0,0 +1,218 @@
+//
+// Portable Rasterization Helpers of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "EggAche_Raster.h"
+
+namespace EggAche_Impl
+{
+	// Curve Flattening
+
+	namespace
+	{
+		// Max Distance between a Chord and the Curve (in Pixels)
+		const double FLATNESS = 0.25;
+
+		// Avoid Degenerated Curves exploding into Millions of Segments
+		const size_t MAX_SEGMENTS = 1024;
+
+		size_t SegmentCount (double dd, double degreeFactor)
+		{
+			// Wang's Formula:
+			// n = sqrt (d * (d - 1) / (8 * tol) * max |P(i) - 2 P(i+1) + P(i+2)|)
+			auto n = (size_t) std::ceil (std::sqrt (degreeFactor * dd / (8 * FLATNESS)));
+			return std::max ((size_t) 1, std::min (n, MAX_SEGMENTS));
+		}
+	}
+
+	void FlattenQuad (Contour &contour,
+					  PointF ctrl, PointF end)
+	{
+		auto beg = contour.back ();
+		auto dd = std::hypot (beg.x - 2 * ctrl.x + end.x,
+							  beg.y - 2 * ctrl.y + end.y);
+		auto n = SegmentCount (dd, 2);
+
+		for (size_t i = 1; i < n; i++)
+		{
+			auto t = (double) i / n, s = 1 - t;
+			contour.push_back ({
+				s * s * beg.x + 2 * s * t * ctrl.x + t * t * end.x,
+				s * s * beg.y + 2 * s * t * ctrl.y + t * t * end.y });
+		}
+		contour.push_back (end);
+	}
+
+	void FlattenCubic (Contour &contour,
+					   PointF ctrl1, PointF ctrl2, PointF end)
+	{
+		auto beg = contour.back ();
+		auto dd = std::max (
+			std::hypot (beg.x - 2 * ctrl1.x + ctrl2.x,
+						beg.y - 2 * ctrl1.y + ctrl2.y),
+			std::hypot (ctrl1.x - 2 * ctrl2.x + end.x,
+						ctrl1.y - 2 * ctrl2.y + end.y));
+		auto n = SegmentCount (dd, 6);
+
+		for (size_t i = 1; i < n; i++)
+		{
+			auto t = (double) i / n, s = 1 - t;
+			auto a = s * s * s, b = 3 * s * s * t, c = 3 * s * t * t, d = t * t * t;
+			contour.push_back ({
+				a * beg.x + b * ctrl1.x + c * ctrl2.x + d * end.x,
+				a * beg.y + b * ctrl1.y + c * ctrl2.y + d * end.y });
+		}
+		contour.push_back (end);
+	}
+
+	Rect BoundingRect (const std::vector<Contour> &contours)
+	{
+		auto xMin = 0.0, yMin = 0.0, xMax = 0.0, yMax = 0.0;
+		auto isFirst = true;
+		for (const auto &contour : contours)
+			for (const auto &point : contour)
+			{
+				if (isFirst)
+				{
+					xMin = xMax = point.x;
+					yMin = yMax = point.y;
+					isFirst = false;
+				}
+				xMin = std::min (xMin, point.x);
+				xMax = std::max (xMax, point.x);
+				yMin = std::min (yMin, point.y);
+				yMax = std::max (yMax, point.y);
+			}
+
+		return Rect {
+			(int) std::floor (xMin), (int) std::floor (yMin),
+			(int) std::ceil (xMax) + 1, (int) std::ceil (yMax) + 1 };
+	}
+
+	// Scanline Polygon Filling
+
+	namespace
+	{
+		struct Edge
+		{
+			double x;			// x at the Center of the current Scanline
+			double dxdy;
+			int yBeg, yEnd;		// Covered Scanlines [yBeg, yEnd)
+			int dir;			// +1 Downward, -1 Upward
+		};
+
+		// First Scanline whose Center is at or below y
+		inline int ScanlineOf (double y)
+		{
+			return (int) std::ceil (y - 0.5);
+		}
+	}
+
+	void FillPolygon (const std::vector<Contour> &contours,
+					  bool isNonZero, const Rect &clip,
+					  const SpanFn &fnSpan)
+	{
+		if (clip.IsEmpty ())
+			return;
+
+		// Build the Edge Table
+		std::vector<Edge> edges;
+		for (const auto &contour : contours)
+		{
+			auto cPoint = contour.size ();
+			for (size_t i = 0; i < cPoint; i++)
+			{
+				auto p0 = contour[i];
+				auto p1 = contour[(i + 1) % cPoint];
+				if (p0.y == p1.y)
+					continue;
+
+				auto dir = 1;
+				if (p0.y > p1.y)
+				{
+					std::swap (p0, p1);
+					dir = -1;
+				}
+
+				Edge edge;
+				edge.yBeg = std::max (ScanlineOf (p0.y), clip.top);
+				edge.yEnd = std::min (ScanlineOf (p1.y), clip.bottom);
+				if (edge.yBeg >= edge.yEnd)
+					continue;
+
+				edge.dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+				edge.x = p0.x + (edge.yBeg + 0.5 - p0.y) * edge.dxdy;
+				edge.dir = dir;
+				edges.push_back (edge);
+			}
+		}
+		if (edges.empty ())
+			return;
+
+		std::sort (edges.begin (), edges.end (),
+				   [] (const Edge &a, const Edge &b) { return a.yBeg < b.yBeg; });
+
+		// Walk the Scanlines with the Active Edge Table
+		std::vector<Edge> active;
+		auto iNext = (size_t) 0;
+		auto y = edges.front ().yBeg;
+		while (iNext < edges.size () || !active.empty ())
+		{
+			// Skip the Gap between Polygons
+			if (active.empty () && edges[iNext].yBeg > y)
+				y = edges[iNext].yBeg;
+
+			// Retire finished Edges, and Enter new Edges
+			active.erase (std::remove_if (active.begin (), active.end (),
+										  [y] (const Edge &e) { return e.yEnd <= y; }),
+						  active.end ());
+			while (iNext < edges.size () && edges[iNext].yBeg == y)
+				active.push_back (edges[iNext++]);
+
+			// Keep the Table sorted by x
+			// Insertion Sort is linear when only a few Edges cross
+			for (size_t i = 1; i < active.size (); i++)
+			{
+				auto edge = active[i];
+				auto j = i;
+				for (; j > 0 && active[j - 1].x > edge.x; j--)
+					active[j] = active[j - 1];
+				active[j] = edge;
+			}
+
+			// Emit Spans by the Fill Rule
+			auto winding = 0;
+			auto xSpanBeg = 0.0;
+			for (auto &edge : active)
+			{
+				auto wasInside = isNonZero ? winding != 0 : (winding & 1) != 0;
+				winding += edge.dir;
+				auto isInside = isNonZero ? winding != 0 : (winding & 1) != 0;
+
+				if (!wasInside && isInside)
+					xSpanBeg = edge.x;
+				else if (wasInside && !isInside)
+				{
+					auto xBeg = std::max (ScanlineOf (xSpanBeg), clip.left);
+					auto xEnd = std::min (ScanlineOf (edge.x), clip.right);
+					if (xBeg < xEnd)
+						fnSpan (y, xBeg, xEnd);
+				}
+				edge.x += edge.dxdy;
+			}
+
+			if (++y >= clip.bottom)
+				break;
+		}
+	}
+
+	void FillSpan (const Surface &surface,
+				   int y, int xBeg, int xEnd, uint32_t pixel)
+	{
+		std::fill (surface.Row (y) + xBeg, surface.Row (y) + xEnd, pixel);
+	}
+}
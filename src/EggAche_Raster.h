@@ -0,0 +1,87 @@
+//
+// Portable Rasterization Helpers of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#ifndef EGGACHE_GL_RASTER
+#define EGGACHE_GL_RASTER
+
+#include <functional>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// SSE2 is always available on x64, and opted in on x86
+#if defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EGGACHE_GL_SSE2
+#endif
+
+namespace EggAche_Impl
+{
+	struct PointF
+	{
+		double x, y;
+	};
+
+	// A Closed (or Open) run of Points
+	typedef std::vector<PointF> Contour;
+
+	struct Rect
+	{
+		int left, top, right, bottom;		// [left, right) * [top, bottom)
+
+		bool IsEmpty () const
+		{
+			return left >= right || top >= bottom;
+		}
+	};
+
+	// Pixels of a 32-bit BGRX Surface, Row by Row
+	struct Surface
+	{
+		unsigned char *bits;				// First Pixel of the Top Row
+		ptrdiff_t stride;					// Bytes between Rows (Negative if Bottom-up)
+		int w, h;
+
+		uint32_t *Row (int y) const
+		{
+			return (uint32_t *) (bits + stride * y);
+		}
+	};
+
+	// Curve Flattening
+
+	void FlattenQuad (Contour &contour,
+					  PointF ctrl, PointF end);
+	void FlattenCubic (Contour &contour,
+					   PointF ctrl1, PointF ctrl2, PointF end);
+	// Remarks:
+	// 1. Append the Curve from contour.back () to end as Line Segments;
+	// 2. The Segment Count is chosen by Wang's Formula, so that
+	//    the Chords stay within a Quarter Pixel from the Curve;
+
+	Rect BoundingRect (const std::vector<Contour> &contours);
+	// Remarks:
+	// Return the Smallest Rect covering all the Points;
+
+	// Scanline Polygon Filling
+
+	typedef std::function<void (int y, int xBeg, int xEnd)> SpanFn;
+
+	void FillPolygon (const std::vector<Contour> &contours,
+					  bool isNonZero, const Rect &clip,
+					  const SpanFn &fnSpan);
+	// Remarks:
+	// 1. Each Contour is implicitly Closed;
+	// 2. Edges are bucketed by their Top Scanline, and only the Edges crossing
+	//    the current Scanline are kept (sorted by x) in the Active Edge Table;
+	// 3. A Pixel is inside if its Center is inside by the Fill Rule
+	//    (Even-Odd or Non-Zero Winding);
+	// 4. Spans [xBeg, xEnd) are emitted Top-down, already trimmed by clip;
+
+	void FillSpan (const Surface &surface,
+				   int y, int xBeg, int xEnd, uint32_t pixel);
+}
+
+#endif  //EGGACHE_GL_RASTER
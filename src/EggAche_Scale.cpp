@@ -0,0 +1,271 @@
+//
+// Portable Image Scaling of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <mutex>
+
+#include "EggAche_Image.h"
+
+#ifdef EGGACHE_GL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace EggAche_Impl
+{
+	// Image Scaling
+
+	namespace
+	{
+		const int WEIGHT_BITS = 14;				// Weights of a Pixel sum to 1 << 14
+		const int WEIGHT_ONE = 1 << WEIGHT_BITS;
+
+		const size_t SCALE_CACHE_SIZE = 16;		// Scaled Copies kept
+		const size_t SCALE_CACHE_BUDGET = 64 << 20;
+
+		// Source Pixels and Weights of each Destination Pixel along an Axis;
+		// Every Pixel has the same Even Count of Taps (padded by Zero Weights)
+		struct Taps
+		{
+			int cTap;
+			std::vector<int> indices;
+			std::vector<int> weights;
+
+			Taps (int cSrc, int cDst)
+			{
+				auto scale = (double) cSrc / cDst;
+				auto isBox = scale > 1;
+				cTap = isBox ? (int) std::ceil (scale) + 1 : 2;
+				cTap += cTap & 1;
+				indices.resize ((size_t) cDst * cTap);
+				weights.resize ((size_t) cDst * cTap);
+
+				std::vector<double> w (cTap);
+				for (auto i = 0; i < cDst; i++)
+				{
+					int first;
+					std::fill (w.begin (), w.end (), 0.0);
+					if (isBox)
+					{
+						// Area covered by [i, i + 1) in Source
+						auto beg = i * scale, end = (i + 1) * scale;
+						first = (int) beg;
+						for (auto k = 0; k < cTap; k++)
+						{
+							auto lo = std::max (beg, (double) (first + k));
+							auto hi = std::min (end, (double) (first + k + 1));
+							w[k] = hi > lo ? (hi - lo) / scale : 0;
+						}
+					}
+					else
+					{
+						// Linear between the 2 nearest Centers
+						auto center = (i + 0.5) * scale - 0.5;
+						first = (int) std::floor (center);
+						w[1] = center - first;
+						w[0] = 1 - w[1];
+					}
+
+					// Round to Fixed Point, giving the Error to the Heaviest
+					auto sum = 0, heaviest = 0;
+					for (auto k = 0; k < cTap; k++)
+					{
+						auto index = std::min (std::max (first + k, 0), cSrc - 1);
+						auto weight = (int) std::lround (w[k] * WEIGHT_ONE);
+						indices[(size_t) i * cTap + k] = index;
+						weights[(size_t) i * cTap + k] = weight;
+						sum += weight;
+						if (weight > weights[(size_t) i * cTap + heaviest])
+							heaviest = k;
+					}
+					weights[(size_t) i * cTap + heaviest] += WEIGHT_ONE - sum;
+				}
+			}
+		};
+
+		inline uint32_t Round (const int acc[4])
+		{
+			uint32_t out = 0;
+			for (auto c = 0; c < 4; c++)
+				out |= (uint32_t) ((acc[c] + WEIGHT_ONE / 2) >> WEIGHT_BITS) << (8 * c);
+			return out;
+		}
+
+		void ScaleRow (const unsigned char *src, uint32_t *dst,
+					   int cDst, const Taps &taps)
+		{
+			auto indices = taps.indices.data ();
+			auto weights = taps.weights.data ();
+			for (auto x = 0; x < cDst; x++, indices += taps.cTap, weights += taps.cTap)
+			{
+#ifdef EGGACHE_GL_SSE2
+				// 2 Taps a Step: Channels of both are Interleaved,
+				// and Multiplied by (w0, w1) Pairs
+				auto zero = _mm_setzero_si128 ();
+				auto acc = zero;
+				for (auto k = 0; k < taps.cTap; k += 2)
+				{
+					uint32_t p0, p1;
+					memcpy (&p0, src + 4 * indices[k], 4);
+					memcpy (&p1, src + 4 * indices[k + 1], 4);
+					auto v = _mm_unpacklo_epi16 (
+						_mm_unpacklo_epi8 (_mm_cvtsi32_si128 ((int) p0), zero),
+						_mm_unpacklo_epi8 (_mm_cvtsi32_si128 ((int) p1), zero));
+					auto w = _mm_set1_epi32 ((weights[k + 1] << 16) | weights[k]);
+					acc = _mm_add_epi32 (acc, _mm_madd_epi16 (v, w));
+				}
+				acc = _mm_srai_epi32 (_mm_add_epi32 (acc, _mm_set1_epi32 (WEIGHT_ONE / 2)),
+									  WEIGHT_BITS);
+				acc = _mm_packs_epi32 (acc, acc);
+				dst[x] = (uint32_t) _mm_cvtsi128_si32 (_mm_packus_epi16 (acc, acc));
+#else
+				int acc[4] = { 0 };
+				for (auto k = 0; k < taps.cTap; k++)
+				{
+					auto p = src + 4 * indices[k];
+					for (auto c = 0; c < 4; c++)
+						acc[c] += p[c] * weights[k];
+				}
+				dst[x] = Round (acc);
+#endif
+			}
+		}
+
+		void ScaleColumns (const uint32_t *const *rows, const int *weights, int cTap,
+						   uint32_t *dst, int w)
+		{
+			auto x = 0;
+#ifdef EGGACHE_GL_SSE2
+			// 4 Pixels a Step, 2 Rows a Tap Pair
+			auto zero = _mm_setzero_si128 ();
+			for (; x + 4 <= w; x += 4)
+			{
+				__m128i acc[4] = { zero, zero, zero, zero };
+				for (auto k = 0; k < cTap; k += 2)
+				{
+					auto r0 = _mm_loadu_si128 ((const __m128i *) (rows[k] + x));
+					auto r1 = _mm_loadu_si128 ((const __m128i *) (rows[k + 1] + x));
+					auto weight = _mm_set1_epi32 ((weights[k + 1] << 16) | weights[k]);
+
+					auto lo0 = _mm_unpacklo_epi8 (r0, zero), lo1 = _mm_unpacklo_epi8 (r1, zero);
+					auto hi0 = _mm_unpackhi_epi8 (r0, zero), hi1 = _mm_unpackhi_epi8 (r1, zero);
+					acc[0] = _mm_add_epi32 (acc[0], _mm_madd_epi16 (_mm_unpacklo_epi16 (lo0, lo1), weight));
+					acc[1] = _mm_add_epi32 (acc[1], _mm_madd_epi16 (_mm_unpackhi_epi16 (lo0, lo1), weight));
+					acc[2] = _mm_add_epi32 (acc[2], _mm_madd_epi16 (_mm_unpacklo_epi16 (hi0, hi1), weight));
+					acc[3] = _mm_add_epi32 (acc[3], _mm_madd_epi16 (_mm_unpackhi_epi16 (hi0, hi1), weight));
+				}
+
+				auto half = _mm_set1_epi32 (WEIGHT_ONE / 2);
+				for (auto &a : acc)
+					a = _mm_srai_epi32 (_mm_add_epi32 (a, half), WEIGHT_BITS);
+				_mm_storeu_si128 ((__m128i *) (dst + x), _mm_packus_epi16 (
+					_mm_packs_epi32 (acc[0], acc[1]), _mm_packs_epi32 (acc[2], acc[3])));
+			}
+#endif
+			for (; x < w; x++)
+			{
+				int acc[4] = { 0 };
+				for (auto k = 0; k < cTap; k++)
+				{
+					auto p = rows[k][x];
+					for (auto c = 0; c < 4; c++)
+						acc[c] += (int) ((p >> (8 * c)) & 0xFF) * weights[k];
+				}
+				dst[x] = Round (acc);
+			}
+		}
+
+		struct ScaledCopy
+		{
+			std::weak_ptr<const ImageData> source;
+			const ImageData *key;
+			int w, h;
+			std::shared_ptr<const ImageData> image;
+		};
+
+		std::mutex scaleMtx;
+		std::list<ScaledCopy> scaledCopies;		// Most Recently Used first
+	}
+
+	std::shared_ptr<const ImageData> ScaleImage (const ImageData &image,
+												 int w, int h)
+	{
+		if (w <= 0 || h <= 0 || (long long) w * h > (1 << 28))
+			return nullptr;
+
+		// Columns first, into Rows of w Pixels
+		Taps xTaps (image.w, w), yTaps (image.h, h);
+		std::vector<uint32_t> temp ((size_t) image.h * w);
+		for (auto y = 0; y < image.h; y++)
+			ScaleRow (image.Row (y), &temp[(size_t) y * w], w, xTaps);
+
+		auto scaled = std::make_shared<ImageData> ();
+		scaled->w = w;
+		scaled->h = h;
+		scaled->hasAlpha = image.hasAlpha;
+		scaled->pixels.resize ((size_t) w * h);
+
+		std::vector<const uint32_t *> rows (yTaps.cTap);
+		for (auto y = 0; y < h; y++)
+		{
+			for (auto k = 0; k < yTaps.cTap; k++)
+				rows[k] = &temp[(size_t) yTaps.indices[(size_t) y * yTaps.cTap + k] * w];
+			ScaleColumns (rows.data (), &yTaps.weights[(size_t) y * yTaps.cTap],
+						  yTaps.cTap, &scaled->pixels[(size_t) y * w], w);
+		}
+
+		scaled->bits = (const unsigned char *) scaled->pixels.data ();
+		scaled->stride = (ptrdiff_t) w * 4;
+		return scaled;
+	}
+
+	std::shared_ptr<const ImageData> ScaleImageCached (
+		const std::shared_ptr<const ImageData> &image, int w, int h)
+	{
+		if (!image)
+			return nullptr;
+		if (image->w == w && image->h == h)
+			return image;
+
+		{
+			std::lock_guard<std::mutex> lg (scaleMtx);
+			for (auto it = scaledCopies.begin (); it != scaledCopies.end (); ++it)
+			{
+				// A Dead Source may have its Address reused
+				if (it->key != image.get () || it->w != w || it->h != h ||
+					it->source.lock () != image)
+					continue;
+				scaledCopies.splice (scaledCopies.begin (), scaledCopies, it);
+				return it->image;
+			}
+		}
+
+		// Scale outside the Lock, so other Threads are not Blocked
+		auto scaled = ScaleImage (*image, w, h);
+		if (!scaled)
+			return nullptr;
+
+		std::lock_guard<std::mutex> lg (scaleMtx);
+		scaledCopies.push_front (ScaledCopy { image, image.get (), w, h, scaled });
+
+		// Evict the Least Recently Used, and the Copies of Dead Sources
+		size_t cb = 0, count = 0;
+		for (auto it = scaledCopies.begin (); it != scaledCopies.end ();)
+		{
+			auto cbCopy = (size_t) it->w * it->h * 4;
+			if (it->source.expired () ||
+				(count && (count >= SCALE_CACHE_SIZE || cb + cbCopy > SCALE_CACHE_BUDGET)))
+			{
+				it = scaledCopies.erase (it);
+				continue;
+			}
+			cb += cbCopy;
+			count++;
+			++it;
+		}
+		return scaled;
+	}
+}
@@ -0,0 +1,479 @@
+//
+// Portable Snapshot Log of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#include <algorithm>
+#include <cstring>
+
+#include "EggAche_Snapshot.h"
+
+#ifdef EGGACHE_GL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace EggAche_Impl
+{
+	// Tile Hashing
+
+	namespace
+	{
+		const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+		const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+		const uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+		const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+		const uint32_t PRIME32 = 0x9E3779B1u;
+
+		const uint64_t KEY_LO = 0xBE4BA423396CFEB8ull;
+		const uint64_t KEY_HI = 0x1CAD21F72C81017Cull;
+		const uint64_t KEY_STEP = 0x9E3779B97F4A7C15ull;
+		const uint64_t RGB_MASK64 = 0x00FFFFFF00FFFFFFull;
+
+		inline uint64_t Rotl (uint64_t x, int r)
+		{
+			return (x << r) | (x >> (64 - r));
+		}
+
+		inline uint64_t Avalanche (uint64_t h)
+		{
+			h ^= h >> 33;
+			h *= PRIME64_2;
+			h ^= h >> 29;
+			h *= PRIME64_3;
+			h ^= h >> 32;
+			return h;
+		}
+
+		// Four 64-bit Lanes, as two Pairs taking 16 Bytes in turn:
+		// lane[k] += d[1 - k] + lo32 (d[k] ^ key[k]) * hi32 (d[k] ^ key[k]),
+		// where the Keys step on every 16 Bytes;
+		// Lanes are Scrambled (lane *= PRIME32) after each Row
+		struct HashState
+		{
+#ifdef EGGACHE_GL_SSE2
+			__m128i lanes[2], key, step, mask;
+
+			HashState ()
+			{
+				lanes[0] = _mm_set_epi32 ((int) (PRIME64_2 >> 32), (int) PRIME64_2,
+										  (int) (PRIME64_1 >> 32), (int) PRIME64_1);
+				lanes[1] = _mm_set_epi32 ((int) (PRIME64_4 >> 32), (int) PRIME64_4,
+										  (int) (PRIME64_3 >> 32), (int) PRIME64_3);
+				key = _mm_set_epi32 ((int) (KEY_HI >> 32), (int) KEY_HI,
+									 (int) (KEY_LO >> 32), (int) KEY_LO);
+				step = _mm_set_epi32 ((int) (KEY_STEP >> 32), (int) KEY_STEP,
+									  (int) (KEY_STEP >> 32), (int) KEY_STEP);
+				mask = _mm_set_epi32 (0x00FFFFFF, 0x00FFFFFF, 0x00FFFFFF, 0x00FFFFFF);
+			}
+
+			void Accumulate (const unsigned char *p, int pair)
+			{
+				auto d = _mm_and_si128 (_mm_loadu_si128 ((const __m128i *) p), mask);
+				auto keyed = _mm_xor_si128 (d, key);
+				auto product = _mm_mul_epu32 (keyed, _mm_srli_epi64 (keyed, 32));
+				auto swapped = _mm_shuffle_epi32 (d, _MM_SHUFFLE (1, 0, 3, 2));
+				lanes[pair] = _mm_add_epi64 (lanes[pair], _mm_add_epi64 (product, swapped));
+				key = _mm_add_epi64 (key, step);
+			}
+
+			void Scramble ()
+			{
+				// lane * PRIME32 = lo32 * PRIME32 + (hi32 * PRIME32 << 32)
+				auto prime = _mm_set1_epi32 ((int) PRIME32);
+				for (auto &lane : lanes)
+				{
+					auto lo = _mm_mul_epu32 (lane, prime);
+					auto hi = _mm_mul_epu32 (_mm_srli_epi64 (lane, 32), prime);
+					lane = _mm_add_epi64 (lo, _mm_slli_epi64 (hi, 32));
+				}
+			}
+
+			void Store (uint64_t out[4]) const
+			{
+				_mm_storeu_si128 ((__m128i *) out, lanes[0]);
+				_mm_storeu_si128 ((__m128i *) (out + 2), lanes[1]);
+			}
+#else
+			uint64_t lanes[4], key[2];
+
+			HashState ()
+				: lanes { PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4 },
+				key { KEY_LO, KEY_HI }
+			{}
+
+			void Accumulate (const unsigned char *p, int pair)
+			{
+				uint64_t d[2];
+				memcpy (d, p, 16);
+				d[0] &= RGB_MASK64;
+				d[1] &= RGB_MASK64;
+				for (auto k = 0; k < 2; k++)
+				{
+					auto keyed = d[k] ^ key[k];
+					lanes[2 * pair + k] += d[1 - k] +
+						(keyed & 0xFFFFFFFF) * (keyed >> 32);
+					key[k] += KEY_STEP;
+				}
+			}
+
+			void Scramble ()
+			{
+				for (auto &lane : lanes)
+					lane *= PRIME32;
+			}
+
+			void Store (uint64_t out[4]) const
+			{
+				std::copy (lanes, lanes + 4, out);
+			}
+#endif
+		};
+	}
+
+	TileHash HashTile (const Surface &tile)
+	{
+		HashState state;
+		auto cbRow = (size_t) tile.w * 4;
+		auto pair = 0;
+		for (auto y = 0; y < tile.h; y++)
+		{
+			auto row = (const unsigned char *) tile.Row (y);
+			size_t i = 0;
+			for (; i + 16 <= cbRow; i += 16, pair ^= 1)
+				state.Accumulate (row + i, pair);
+
+			// Pad the Tail of the Row with Zeros
+			if (i < cbRow)
+			{
+				unsigned char tail[16] = { 0 };
+				memcpy (tail, row + i, cbRow - i);
+				state.Accumulate (tail, pair);
+				pair ^= 1;
+			}
+			state.Scramble ();
+		}
+
+		uint64_t lanes[4];
+		state.Store (lanes);
+		auto size = ((uint64_t) tile.w << 32) | (uint32_t) tile.h;
+		TileHash hash;
+		hash.lo = Avalanche (lanes[0] + Rotl (lanes[1], 17) +
+							 Rotl (lanes[2], 31) + Rotl (lanes[3], 47) + size * PRIME64_1);
+		hash.hi = Avalanche (lanes[3] + Rotl (lanes[2], 23) +
+							 Rotl (lanes[1], 41) + Rotl (lanes[0], 53) + size * PRIME64_4);
+		return hash;
+	}
+
+	// Snapshot Store
+
+	namespace
+	{
+		const char SNAPSHOT_MAGIC[8] = { 'E', 'G', 'G', 'A', 'S', 'N', 'A', 'P' };
+		const uint32_t SNAPSHOT_VERSION = 1;
+		const size_t HEADER_SIZE = 16;
+		const size_t RECORD_HEADER_SIZE = 8;
+		const size_t HASH_SIZE = 16;
+
+		// Layout:
+		// Header:  Magic, Version, Tile Size
+		// Records: Type, Payload Size, Payload; in the Order Appended
+		// Tile:    Hash (lo, hi), QOI of the Tile; ids count from 0 in Order
+		// Frame:   w, h, Tile id of each Tile, Row by Row
+		enum
+		{
+			RECORD_TILE = 1,
+			RECORD_FRAME = 2
+		};
+
+		inline uint32_t U32 (const unsigned char *p)
+		{
+			return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+		}
+
+		inline uint64_t U64 (const unsigned char *p)
+		{
+			return U32 (p) | ((uint64_t) U32 (p + 4) << 32);
+		}
+
+		inline void Put32 (std::vector<unsigned char> &out, uint32_t value)
+		{
+			for (auto i = 0; i < 4; i++)
+				out.push_back ((unsigned char) (value >> (8 * i)));
+		}
+
+		inline void Put64 (std::vector<unsigned char> &out, uint64_t value)
+		{
+			Put32 (out, (uint32_t) value);
+			Put32 (out, (uint32_t) (value >> 32));
+		}
+
+		inline size_t TileCountOf (uint32_t w, uint32_t h)
+		{
+			auto tile = (uint32_t) SnapshotStore::TILE_SIZE;
+			return (size_t) ((w + tile - 1) / tile) * ((h + tile - 1) / tile);
+		}
+	}
+
+	const int SnapshotStore::TILE_SIZE;
+
+	std::unique_ptr<SnapshotStore> SnapshotStore::Open (const char *fileName)
+	{
+		std::unique_ptr<SnapshotStore> store (new SnapshotStore ());
+		store->in.open (fileName, std::ios::binary);
+		if (!store->in)
+		{
+			// Create the File with a Header
+			std::vector<unsigned char> header (SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 8);
+			Put32 (header, SNAPSHOT_VERSION);
+			Put32 (header, TILE_SIZE);
+			std::ofstream file (fileName, std::ios::binary | std::ios::trunc);
+			if (!file.write ((const char *) header.data (), (std::streamsize) header.size ()))
+				return nullptr;
+			file.close ();
+			store->in.clear ();
+			store->in.open (fileName, std::ios::binary);
+			if (!store->in)
+				return nullptr;
+		}
+
+		unsigned char header[HEADER_SIZE];
+		if (!store->in.read ((char *) header, HEADER_SIZE) ||
+			!std::equal (SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 8, (const char *) header) ||
+			U32 (header + 8) != SNAPSHOT_VERSION || U32 (header + 12) != TILE_SIZE)
+			return nullptr;
+
+		// Scan the Records, reading only the Hashes and Frame Sizes
+		store->in.seekg (0, std::ios::end);
+		auto fileSize = (unsigned long long) store->in.tellg ();
+		auto offset = (unsigned long long) HEADER_SIZE;
+		while (offset < fileSize)
+		{
+			unsigned char head[RECORD_HEADER_SIZE + HASH_SIZE];
+			if (fileSize - offset < RECORD_HEADER_SIZE)
+				return nullptr;
+			store->in.seekg ((std::streamoff) offset);
+			if (!store->in.read ((char *) head, RECORD_HEADER_SIZE))
+				return nullptr;
+
+			auto type = U32 (head);
+			auto cbPayload = (unsigned long long) U32 (head + 4);
+			if (cbPayload > fileSize - offset - RECORD_HEADER_SIZE)
+				return nullptr;
+
+			if (type == RECORD_TILE)
+			{
+				if (cbPayload < HASH_SIZE ||
+					!store->in.read ((char *) head + RECORD_HEADER_SIZE, HASH_SIZE))
+					return nullptr;
+				auto hash = TileHash { U64 (head + RECORD_HEADER_SIZE),
+					U64 (head + RECORD_HEADER_SIZE + 8) };
+				store->tileIds.emplace (hash, (uint32_t) store->tileOffsets.size ());
+				store->tileOffsets.push_back (offset);
+			}
+			else if (type == RECORD_FRAME)
+			{
+				if (cbPayload < 8 || !store->in.read ((char *) head, 8) ||
+					cbPayload != 8 + 4 * (unsigned long long) TileCountOf (
+						U32 (head), U32 (head + 4)))
+					return nullptr;
+				store->frameOffsets.push_back (offset);
+			}
+			else
+				return nullptr;
+			offset += RECORD_HEADER_SIZE + cbPayload;
+		}
+
+		store->size = offset;
+		store->out.open (fileName, std::ios::binary | std::ios::app);
+		if (!store->out)
+			return nullptr;
+		return store;
+	}
+
+	bool SnapshotStore::Append (const Surface &surface)
+	{
+		if (surface.w <= 0 || surface.h <= 0)
+			return false;
+
+		std::lock_guard<std::mutex> lg (mtx);
+		auto storeTile = [this] (const TileHash &hash, const Surface &tile) -> bool
+		{
+			if (!EncodeQoi (tile, qoi))
+				return false;
+			std::vector<unsigned char> head;
+			Put32 (head, RECORD_TILE);
+			Put32 (head, (uint32_t) (HASH_SIZE + qoi.size ()));
+			Put64 (head, hash.lo);
+			Put64 (head, hash.hi);
+			if (!out.write ((const char *) head.data (), (std::streamsize) head.size ()) ||
+				!out.write ((const char *) qoi.data (), (std::streamsize) qoi.size ()))
+				return false;
+
+			tileIds.emplace (hash, (uint32_t) tileOffsets.size ());
+			tileOffsets.push_back (size);
+			size += head.size () + qoi.size ();
+			return true;
+		};
+
+		std::vector<unsigned char> manifest;
+		Put32 (manifest, RECORD_FRAME);
+		Put32 (manifest, (uint32_t) (8 + 4 * TileCountOf (surface.w, surface.h)));
+		Put32 (manifest, (uint32_t) surface.w);
+		Put32 (manifest, (uint32_t) surface.h);
+		for (auto y = 0; y < surface.h; y += TILE_SIZE)
+			for (auto x = 0; x < surface.w; x += TILE_SIZE)
+			{
+				auto tile = Surface {
+					(unsigned char *) (surface.Row (y) + x), surface.stride,
+					std::min (TILE_SIZE, surface.w - x), std::min (TILE_SIZE, surface.h - y) };
+				auto hash = HashTile (tile);
+				auto it = tileIds.find (hash);
+				if (it == tileIds.end ())
+				{
+					if (!storeTile (hash, tile))
+						return false;
+					it = tileIds.find (hash);
+				}
+				Put32 (manifest, it->second);
+			}
+
+		if (!out.write ((const char *) manifest.data (), (std::streamsize) manifest.size ()) ||
+			!out.flush ())
+			return false;
+		frameOffsets.push_back (size);
+		size += manifest.size ();
+		return true;
+	}
+
+	size_t SnapshotStore::FrameCount () const
+	{
+		std::lock_guard<std::mutex> lg (mtx);
+		return frameOffsets.size ();
+	}
+
+	size_t SnapshotStore::TileCount () const
+	{
+		std::lock_guard<std::mutex> lg (mtx);
+		return tileOffsets.size ();
+	}
+
+	bool SnapshotStore::ReadRecord (unsigned long long offset, uint32_t type,
+									std::vector<unsigned char> &payload) const
+	{
+		unsigned char head[RECORD_HEADER_SIZE];
+		in.clear ();
+		if (!in.seekg ((std::streamoff) offset) ||
+			!in.read ((char *) head, RECORD_HEADER_SIZE) || U32 (head) != type)
+			return false;
+		payload.resize (U32 (head + 4));
+		return (bool) in.read ((char *) payload.data (), (std::streamsize) payload.size ());
+	}
+
+	std::shared_ptr<const ImageData> SnapshotStore::Frame (size_t index) const
+	{
+		std::lock_guard<std::mutex> lg (mtx);
+		std::vector<unsigned char> manifest, tile;
+		if (index >= frameOffsets.size () ||
+			!ReadRecord (frameOffsets[index], RECORD_FRAME, manifest) ||
+			manifest.size () < 8)
+			return nullptr;
+
+		auto w = (int) U32 (manifest.data ());
+		auto h = (int) U32 (manifest.data () + 4);
+		if (w <= 0 || h <= 0 ||
+			manifest.size () != 8 + 4 * TileCountOf ((uint32_t) w, (uint32_t) h))
+			return nullptr;
+		auto image = std::make_shared<ImageData> ();
+		image->w = w;
+		image->h = h;
+		image->pixels.resize ((size_t) w * h);
+
+		// Tiles Repeated within a Frame are Decoded once
+		std::unordered_map<uint32_t, std::shared_ptr<const ImageData>> decoded;
+		auto p = manifest.data () + 8;
+		for (auto y = 0; y < h; y += TILE_SIZE)
+			for (auto x = 0; x < w; x += TILE_SIZE, p += 4)
+			{
+				auto id = U32 (p);
+				auto &pixels = decoded[id];
+				if (!pixels)
+				{
+					if (id >= tileOffsets.size () ||
+						!ReadRecord (tileOffsets[id], RECORD_TILE, tile) ||
+						tile.size () < HASH_SIZE ||
+						!(pixels = DecodeQoi (tile.data () + HASH_SIZE,
+											  tile.size () - HASH_SIZE)))
+						return nullptr;
+				}
+
+				auto tileW = std::min (TILE_SIZE, w - x), tileH = std::min (TILE_SIZE, h - y);
+				if (pixels->w != tileW || pixels->h != tileH)
+					return nullptr;
+				for (auto row = 0; row < tileH; row++)
+					memcpy (&image->pixels[(size_t) (y + row) * w + x],
+							pixels->Row (row), (size_t) tileW * 4);
+			}
+
+		image->bits = (const unsigned char *) image->pixels.data ();
+		image->stride = (ptrdiff_t) w * 4;
+		image->hasAlpha = false;
+		return image;
+	}
+
+	// Snapshot Budget
+
+	namespace
+	{
+		// Nanoseconds a Pixel of each Mode (Composing and Writing included)
+		// on UI-like Frames, until it's Measured
+		const double PRIOR_COSTS[SnapshotBudget::MODE_COUNT] =
+		{
+			2, 5, 10, 13, 18, 30
+		};
+		const int PNG_LEVELS[SnapshotBudget::MODE_COUNT] =
+		{
+			0, 0, 1, 3, 6, 9
+		};
+
+		const double DECAY = 0.97;				// Halved in about 23 Frames
+		const double AVERAGE_WEIGHT = 0.25;
+	}
+
+	int SnapshotBudget::PngLevel (Mode mode)
+	{
+		return PNG_LEVELS[mode];
+	}
+
+	SnapshotBudget::SnapshotBudget (double seconds)
+		: budget (seconds), last (MODE_BMP)
+	{
+		for (auto i = 0; i < MODE_COUNT; i++)
+			costs[i] = PRIOR_COSTS[i] * 1e-9;
+	}
+
+	SnapshotBudget::Mode SnapshotBudget::Choose (long long pixels)
+	{
+		auto top = std::min ((int) last + 1, (int) MODE_COUNT - 1);
+		auto choice = MODE_BMP;
+		auto cost = 0.0;
+		for (auto i = 0; i <= top; i++)
+		{
+			cost = std::max (cost, costs[i]);
+			if (cost * pixels > budget)
+				break;
+			choice = (Mode) i;
+		}
+
+		for (auto i = 0; i < MODE_COUNT; i++)
+			if (i != choice)
+				costs[i] *= DECAY;
+		return last = choice;
+	}
+
+	void SnapshotBudget::Record (Mode mode, long long pixels, double seconds)
+	{
+		auto cost = seconds / std::max (pixels, 1ll);
+		auto &old = costs[mode];
+		old = cost > old ? cost : old + (cost - old) * AVERAGE_WEIGHT;
+	}
+}
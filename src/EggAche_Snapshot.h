@@ -0,0 +1,126 @@
+//
+// Portable Snapshot Log of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#ifndef EGGACHE_GL_SNAPSHOT
+#define EGGACHE_GL_SNAPSHOT
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "EggAche_Image.h"
+
+namespace EggAche_Impl
+{
+	// 128-bit Hash of the Pixels of a Tile
+	struct TileHash
+	{
+		uint64_t lo, hi;
+
+		bool operator== (const TileHash &other) const
+		{
+			return lo == other.lo && hi == other.hi;
+		}
+	};
+
+	TileHash HashTile (const Surface &tile);
+	// Remarks:
+	// 1. Keyed by the Position of each 16 Bytes, and by the Size of tile;
+	// 2. Alpha Bytes (Undefined) are not Hashed;
+	// 3. The SSE2 and the Scalar Path give the same Hash;
+
+	// Frames Split into Tiles, each distinct Tile Stored only once
+	class SnapshotStore
+	{
+	public:
+		static const int TILE_SIZE = 64;
+
+		static std::unique_ptr<SnapshotStore> Open (const char *fileName);
+		// Remarks:
+		// 1. Create the File, or Scan the Records of an existing one,
+		//    so new Frames are Appended sharing its Tiles;
+		// 2. Return nullptr if the File is not a Snapshot Log,
+		//    or its last Record is cut off;
+
+		bool Append (const Surface &surface);
+		// Remarks:
+		// 1. Split surface into Tiles, and Store those not Stored yet
+		//    (by their Hashes, in QOI), then a Manifest of the Tile ids;
+		// 2. Return false if the File can't be Written;
+
+		size_t FrameCount () const;
+		size_t TileCount () const;
+
+		std::shared_ptr<const ImageData> Frame (size_t index) const;
+		// Remarks:
+		// Return nullptr if index is out of range, or the Records are broken;
+
+	private:
+		SnapshotStore () {}
+
+		struct TileHasher
+		{
+			size_t operator() (const TileHash &hash) const
+			{
+				return (size_t) hash.lo;
+			}
+		};
+
+		mutable std::mutex mtx;
+		std::ofstream out;							// Appending
+		mutable std::ifstream in;					// Reading Frames back
+		unsigned long long size;					// End of the last Record
+
+		std::unordered_map<TileHash, uint32_t, TileHasher> tileIds;
+		std::vector<unsigned long long> tileOffsets, frameOffsets;
+		std::vector<unsigned char> qoi;				// Reused for Encoding Tiles
+
+		bool ReadRecord (unsigned long long offset, uint32_t type,
+						 std::vector<unsigned char> &payload) const;
+	};
+
+	// Snapshot Encodings Chosen to fit a Time Budget, by their Measured Costs
+	class SnapshotBudget
+	{
+	public:
+		// From the Fastest (and Largest) to the Smallest
+		enum Mode
+		{
+			MODE_BMP, MODE_QOI, MODE_PNG1, MODE_PNG3, MODE_PNG6, MODE_PNG9,
+			MODE_COUNT
+		};
+
+		static int PngLevel (Mode mode);
+
+		SnapshotBudget (double seconds);
+
+		void SetBudget (double seconds) { budget = seconds; }
+		double Budget () const { return budget; }
+
+		Mode Choose (long long pixels);
+		// Remarks:
+		// 1. Return the Smallest Mode Expected to be Done within the Budget
+		//    (by its Cost a Pixel, never less than a Faster Mode's),
+		//    or MODE_BMP if none is;
+		// 2. At most one Mode above the last Chosen, so Probing a Slower one
+		//    runs over the Budget by a single Step at most;
+		// 3. Costs of the Modes not Chosen Decay, so they are Probed again
+		//    once the Content gets easier;
+
+		void Record (Mode mode, long long pixels, double seconds);
+		// Remarks:
+		// A Slower Measure is taken at once (to Stop Stalling the next Frame),
+		// and a Faster one is Averaged in;
+
+	private:
+		double budget;
+		double costs[MODE_COUNT];				// Seconds a Pixel
+		Mode last;
+	};
+}
+
+#endif  //EGGACHE_GL_SNAPSHOT
@@ -0,0 +1,216 @@
+//
+// Portable Masked Sprites of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <mutex>
+
+#include "EggAche_Image.h"
+
+#ifdef EGGACHE_GL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace EggAche_Impl
+{
+	// Masked Sprites
+
+	namespace
+	{
+		const size_t SPRITE_CACHE_SIZE = 64;	// Sprites kept
+
+		const uint32_t RGB_MASK = 0xFFFFFF;
+
+		// Copy Source with Alpha Cleared
+		inline void CopyRun (uint32_t *dst, const uint32_t *src, int len)
+		{
+			auto i = 0;
+#ifdef EGGACHE_GL_SSE2
+			auto rgb = _mm_set1_epi32 ((int) RGB_MASK);
+			for (; i + 4 <= len; i += 4)
+				_mm_storeu_si128 ((__m128i *) (dst + i), _mm_and_si128 (
+					_mm_loadu_si128 ((const __m128i *) (src + i)), rgb));
+#endif
+			for (; i < len; i++)
+				dst[i] = src[i] & RGB_MASK;
+		}
+
+		// Raster Operation of SRCAND and then SRCPAINT
+		inline void MaskRun (uint32_t *dst, const uint32_t *src,
+							 const uint32_t *mask, int len)
+		{
+			auto i = 0;
+#ifdef EGGACHE_GL_SSE2
+			auto rgb = _mm_set1_epi32 ((int) RGB_MASK);
+			for (; i + 4 <= len; i += 4)
+			{
+				auto d = _mm_loadu_si128 ((const __m128i *) (dst + i));
+				auto s = _mm_loadu_si128 ((const __m128i *) (src + i));
+				auto m = _mm_loadu_si128 ((const __m128i *) (mask + i));
+				_mm_storeu_si128 ((__m128i *) (dst + i), _mm_and_si128 (
+					_mm_or_si128 (_mm_and_si128 (d, m), s), rgb));
+			}
+#endif
+			for (; i < len; i++)
+				dst[i] = ((dst[i] & mask[i]) | src[i]) & RGB_MASK;
+		}
+
+		enum class PixelKind { Transparent, Opaque, Masked };
+
+		inline PixelKind Classify (uint32_t s, uint32_t m)
+		{
+			m &= RGB_MASK;
+			if (m == RGB_MASK && !(s & RGB_MASK))
+				return PixelKind::Transparent;
+			if (!m)
+				return PixelKind::Opaque;
+			return PixelKind::Masked;
+		}
+
+		struct CachedSprite
+		{
+			std::weak_ptr<const ImageData> source, mask;
+			const ImageData *srcKey, *mskKey;
+			int xSrc, ySrc, xMsk, yMsk, w, h;
+			std::shared_ptr<const MaskedSprite> sprite;
+		};
+
+		std::mutex spriteMtx;
+		std::list<CachedSprite> cachedSprites;	// Most Recently Used first
+	}
+
+	std::shared_ptr<const MaskedSprite> BuildMaskedSprite (
+		const ImageData &src, int xSrc, int ySrc,
+		const ImageData &mask, int xMsk, int yMsk, int w, int h)
+	{
+		// Trim by both Sources, as BlitImageMask does
+		if (xSrc < 0 || ySrc < 0 || xMsk < 0 || yMsk < 0)
+			return nullptr;
+		w = std::min (w, std::min (src.w - xSrc, mask.w - xMsk));
+		h = std::min (h, std::min (src.h - ySrc, mask.h - yMsk));
+		if (w <= 0 || h <= 0)
+			return nullptr;
+
+		auto sprite = std::make_shared<MaskedSprite> ();
+		sprite->w = w;
+		sprite->h = h;
+		sprite->pixels.resize ((size_t) w * h);
+		sprite->masks.resize ((size_t) w * h);
+		sprite->rowRuns.reserve ((size_t) h + 1);
+
+		for (auto y = 0; y < h; y++)
+		{
+			auto pixels = &sprite->pixels[(size_t) y * w];
+			auto masks = &sprite->masks[(size_t) y * w];
+			memcpy (pixels, src.Row (y + ySrc) + 4 * xSrc, (size_t) w * 4);
+			memcpy (masks, mask.Row (y + yMsk) + 4 * xMsk, (size_t) w * 4);
+
+			// Split the Row where the Kind changes
+			sprite->rowRuns.push_back (sprite->runs.size ());
+			for (auto x = 0; x < w;)
+			{
+				auto kind = Classify (pixels[x], masks[x]);
+				auto end = x + 1;
+				while (end < w && Classify (pixels[end], masks[end]) == kind)
+					end++;
+				if (kind != PixelKind::Transparent)
+					sprite->runs.push_back (MaskedSprite::Run {
+						x, end - x, kind == PixelKind::Opaque });
+				x = end;
+			}
+		}
+		sprite->rowRuns.push_back (sprite->runs.size ());
+		return sprite;
+	}
+
+	std::shared_ptr<const MaskedSprite> BuildMaskedSpriteCached (
+		const std::shared_ptr<const ImageData> &src, int xSrc, int ySrc,
+		const std::shared_ptr<const ImageData> &mask, int xMsk, int yMsk,
+		int w, int h)
+	{
+		if (!src || !mask)
+			return nullptr;
+
+		{
+			std::lock_guard<std::mutex> lg (spriteMtx);
+			for (auto it = cachedSprites.begin (); it != cachedSprites.end (); ++it)
+			{
+				// A Dead Source may have its Address reused
+				if (it->srcKey != src.get () || it->mskKey != mask.get () ||
+					it->xSrc != xSrc || it->ySrc != ySrc ||
+					it->xMsk != xMsk || it->yMsk != yMsk ||
+					it->w != w || it->h != h ||
+					it->source.lock () != src || it->mask.lock () != mask)
+					continue;
+				cachedSprites.splice (cachedSprites.begin (), cachedSprites, it);
+				return it->sprite;
+			}
+		}
+
+		// Build outside the Lock, so other Threads are not Blocked
+		auto sprite = BuildMaskedSprite (*src, xSrc, ySrc, *mask, xMsk, yMsk, w, h);
+		if (!sprite)
+			return nullptr;
+
+		std::lock_guard<std::mutex> lg (spriteMtx);
+		cachedSprites.push_front (CachedSprite {
+			src, mask, src.get (), mask.get (),
+			xSrc, ySrc, xMsk, yMsk, w, h, sprite });
+
+		// Evict the Least Recently Used, and the Sprites of Dead Sources
+		size_t count = 0;
+		for (auto it = cachedSprites.begin (); it != cachedSprites.end ();)
+		{
+			if (it->source.expired () || it->mask.expired () ||
+				count >= SPRITE_CACHE_SIZE)
+			{
+				it = cachedSprites.erase (it);
+				continue;
+			}
+			count++;
+			++it;
+		}
+		return sprite;
+	}
+
+	void BlitMaskedSprite (const Surface &surface, const Rect &clip,
+						   int xDst, int yDst, const MaskedSprite &sprite)
+	{
+		auto xBeg = std::max (xDst, clip.left);
+		auto yBeg = std::max (yDst, clip.top);
+		auto xEnd = std::min (xDst + sprite.w, clip.right);
+		auto yEnd = std::min (yDst + sprite.h, clip.bottom);
+		if (xBeg >= xEnd)
+			return;
+
+		for (auto y = yBeg; y < yEnd; y++)
+		{
+			auto row = (size_t) (y - yDst);
+			auto dst = surface.Row (y) + xDst;
+			auto pixels = &sprite.pixels[row * sprite.w];
+			auto masks = &sprite.masks[row * sprite.w];
+
+			// Runs are Sorted, so only those across [xBeg, xEnd) are Visited
+			for (auto i = sprite.rowRuns[row]; i < sprite.rowRuns[row + 1]; i++)
+			{
+				const auto &run = sprite.runs[i];
+				auto beg = std::max (run.x, xBeg - xDst);
+				auto end = std::min (run.x + run.len, xEnd - xDst);
+				if (end <= beg)
+				{
+					if (run.x >= xEnd - xDst)
+						break;
+					continue;
+				}
+
+				if (run.isOpaque)
+					CopyRun (dst + beg, pixels + beg, end - beg);
+				else
+					MaskRun (dst + beg, pixels + beg, masks + beg, end - beg);
+			}
+		}
+	}
+}
@@ -0,0 +1,298 @@
+//
+// Portable Text Rendering Helpers of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include "EggAche_Text.h"
+
+namespace EggAche_Impl
+{
+	// Font Face
+
+	namespace
+	{
+		// Longer Texts are seldom drawn again
+		const size_t MAX_BLOB_CHARS = 256;
+
+		// Coverage Bytes kept by the Blobs of a Face
+		const size_t BLOB_BUDGET = 1 << 20;
+
+		// Hashes remembered to admit Blobs on the Second Draw
+		const size_t MAX_TEXTS_SEEN = 4096;
+	}
+
+	FontFace::FontFace ()
+		: isAdvanceLoaded (false),
+		atlasW (256), atlasH (0),
+		shelfX (0), shelfY (0), shelfH (0),
+		cbBlobs (0)
+	{
+		memset (isCached, 0, sizeof (isCached));
+	}
+
+	void FontFace::Pack (int w, int h, int &x, int &y)
+	{
+		// Grow the Atlas for wide Glyphs of large Fonts
+		if (w > atlasW)
+		{
+			auto newW = atlasW;
+			while (newW < w) newW *= 2;
+
+			std::vector<unsigned char> newAtlas ((size_t) newW * atlasH, 0);
+			for (auto row = 0; row < atlasH; row++)
+				memcpy (&newAtlas[(size_t) row * newW],
+						&atlas[(size_t) row * atlasW], atlasW);
+			atlas.swap (newAtlas);
+			atlasW = newW;
+		}
+
+		// Open a new Shelf if the current one is full
+		if (shelfX + w > atlasW)
+		{
+			shelfY += shelfH;
+			shelfX = 0;
+			shelfH = 0;
+		}
+
+		x = shelfX;
+		y = shelfY;
+		shelfX += w + 1;
+		shelfH = std::max (shelfH, h + 1);
+
+		// Rows are appended, so Glyphs packed before stay in place
+		if (shelfY + shelfH > atlasH)
+		{
+			atlasH = std::max (shelfY + shelfH, atlasH * 2);
+			atlas.resize ((size_t) atlasW * atlasH, 0);
+		}
+	}
+
+	const Glyph &FontFace::GetGlyph (unsigned char ch)
+	{
+		auto &glyph = glyphs[ch];
+		if (isCached[ch])
+			return glyph;
+
+		GlyphBitmap bitmap {};
+		if (!RasterizeGlyph (ch, bitmap) ||
+			bitmap.coverage.size () < (size_t) bitmap.w * bitmap.h)
+			bitmap.w = bitmap.h = 0;
+
+		glyph.x = glyph.y = 0;
+		glyph.w = bitmap.w;
+		glyph.h = bitmap.h;
+		glyph.xOff = bitmap.xOff;
+		glyph.yOff = bitmap.yOff;
+		glyph.advance = bitmap.advance;
+
+		if (glyph.w > 0 && glyph.h > 0)
+		{
+			Pack (glyph.w, glyph.h, glyph.x, glyph.y);
+			for (auto row = 0; row < glyph.h; row++)
+				memcpy (&atlas[(size_t) (glyph.y + row) * atlasW + glyph.x],
+						&bitmap.coverage[(size_t) row * glyph.w], glyph.w);
+		}
+
+		isCached[ch] = true;
+		return glyph;
+	}
+
+	void FontFace::DrawTxt (const Surface &surface, const Rect &clip,
+							int xBeg, int yBeg, const char *szText,
+							uint32_t pixel)
+	{
+		std::lock_guard<std::mutex> lg (mtx);
+
+		auto cch = strlen (szText);
+		if (auto blob = GetBlob (szText, cch))
+		{
+			if (blob->w > 0 && blob->h > 0)
+				BlitCoverage (surface, clip,
+							  xBeg + blob->xOff, yBeg + blob->yOff,
+							  blob->coverage.data (),
+							  blob->w, blob->w, blob->h, pixel);
+			return;
+		}
+
+		auto xPen = xBeg;
+		for (auto p = (const unsigned char *) szText; *p; p++)
+		{
+			const auto &glyph = GetGlyph (*p);
+			if (glyph.w > 0 && glyph.h > 0)
+				BlitCoverage (surface, clip,
+							  xPen + glyph.xOff, yBeg + glyph.yOff,
+							  &atlas[(size_t) glyph.y * atlasW + glyph.x],
+							  atlasW, glyph.w, glyph.h, pixel);
+			xPen += glyph.advance;
+
+			// The rest is out of the Clip
+			if (xPen >= clip.right)
+				break;
+		}
+	}
+
+	const FontFace::TextBlob *FontFace::GetBlob (const char *szText,
+												 size_t cch)
+	{
+		if (cch == 0 || cch > MAX_BLOB_CHARS)
+			return nullptr;
+
+		std::string key (szText, cch);
+		auto it = blobs.find (key);
+		if (it != blobs.end ())
+		{
+			blobLru.splice (blobLru.begin (), blobLru, it->second.itLru);
+			return &it->second;
+		}
+
+		// Texts drawn only once are not worth a Blob
+		if (textsSeen.size () >= MAX_TEXTS_SEEN)
+			textsSeen.clear ();
+		if (textsSeen.insert (std::hash<std::string> () (key)).second)
+			return nullptr;
+
+		// Large Blobs are Measured and Dropped before being Composed,
+		// so they cost no more than drawing Glyph by Glyph
+		TextBlob blob;
+		if (!BuildBlob (szText, cch, BLOB_BUDGET / 4 - key.size (), blob))
+			return nullptr;
+		auto cbBlob = blob.coverage.size () + key.size ();
+
+		// Evict the Least Recently Used Blobs
+		while (cbBlobs + cbBlob > BLOB_BUDGET && !blobLru.empty ())
+		{
+			auto itOld = blobs.find (blobLru.back ());
+			cbBlobs -= itOld->second.coverage.size () + itOld->first.size ();
+			blobs.erase (itOld);
+			blobLru.pop_back ();
+		}
+
+		blobLru.push_front (key);
+		blob.itLru = blobLru.begin ();
+		cbBlobs += cbBlob;
+		return &(blobs[std::move (key)] = std::move (blob));
+	}
+
+	bool FontFace::BuildBlob (const char *szText, size_t cch,
+							  size_t cbMax, TextBlob &blob)
+	{
+		auto text = (const unsigned char *) szText;
+
+		// Rasterize all Glyphs first, since the Atlas may Grow
+		auto xMin = 0, yMin = 0, xMax = 0, yMax = 0;
+		auto isFirst = true;
+		auto xPen = 0;
+		for (size_t i = 0; i < cch; i++)
+		{
+			const auto &glyph = GetGlyph (text[i]);
+			if (glyph.w > 0 && glyph.h > 0)
+			{
+				auto x = xPen + glyph.xOff, y = glyph.yOff;
+				if (isFirst)
+				{
+					xMin = x; yMin = y;
+					xMax = x + glyph.w; yMax = y + glyph.h;
+					isFirst = false;
+				}
+				xMin = std::min (xMin, x);
+				yMin = std::min (yMin, y);
+				xMax = std::max (xMax, x + glyph.w);
+				yMax = std::max (yMax, y + glyph.h);
+			}
+			xPen += glyph.advance;
+		}
+
+		blob.xOff = xMin;
+		blob.yOff = yMin;
+		blob.w = xMax - xMin;
+		blob.h = yMax - yMin;
+		if ((size_t) blob.w * blob.h > cbMax)
+			return false;
+		blob.coverage.assign ((size_t) blob.w * blob.h, 0);
+
+		// Compose the Run, keeping the Max Coverage where Glyphs overlap
+		xPen = 0;
+		for (size_t i = 0; i < cch; i++)
+		{
+			const auto &glyph = glyphs[text[i]];
+			for (auto row = 0; row < glyph.h; row++)
+			{
+				auto src = &atlas[(size_t) (glyph.y + row) * atlasW + glyph.x];
+				auto dst = &blob.coverage[
+					(size_t) (glyph.yOff - yMin + row) * blob.w +
+						(xPen + glyph.xOff - xMin)];
+				for (auto col = 0; col < glyph.w; col++)
+					dst[col] = std::max (dst[col], src[col]);
+			}
+			xPen += glyph.advance;
+		}
+		return true;
+	}
+
+	bool FontFace::MeasureTexts (const char *const *texts, size_t count,
+								 size_t *widths)
+	{
+		std::lock_guard<std::mutex> lg (mtx);
+
+		if (!isAdvanceLoaded)
+		{
+			if (!LoadAdvances (advances))
+				return false;
+			isAdvanceLoaded = true;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t width = 0;
+			for (auto p = (const unsigned char *) texts[i]; *p; p++)
+				width += advances[*p];
+			widths[i] = width;
+		}
+		return true;
+	}
+
+	// Coverage Blitting
+
+	void BlitCoverage (const Surface &surface, const Rect &clip,
+					   int xDst, int yDst,
+					   const unsigned char *coverage, ptrdiff_t stride,
+					   int w, int h, uint32_t pixel)
+	{
+		auto xBeg = std::max (xDst, clip.left);
+		auto yBeg = std::max (yDst, clip.top);
+		auto xEnd = std::min (xDst + w, clip.right);
+		auto yEnd = std::min (yDst + h, clip.bottom);
+
+		for (auto y = yBeg; y < yEnd; y++)
+		{
+			auto src = coverage + (y - yDst) * stride - xDst;
+			auto dst = surface.Row (y);
+			for (auto x = xBeg; x < xEnd; x++)
+			{
+				unsigned a = src[x];
+				if (a == 0)
+					continue;
+				if (a == 255)
+				{
+					dst[x] = pixel;
+					continue;
+				}
+
+				// Blend each Channel: dst + (src - dst) * a / 255
+				auto d = dst[x];
+				uint32_t out = 0;
+				for (auto shift = 0; shift < 24; shift += 8)
+				{
+					int dc = (d >> shift) & 0xFF;
+					int sc = (pixel >> shift) & 0xFF;
+					out |= (uint32_t) (dc + (sc - dc) * (int) a / 255) << shift;
+				}
+				dst[x] = out;
+			}
+		}
+	}
+}
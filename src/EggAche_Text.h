@@ -0,0 +1,130 @@
+//
+// Portable Text Rendering Helpers of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#ifndef EGGACHE_GL_TEXT
+#define EGGACHE_GL_TEXT
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "EggAche_Raster.h"
+
+namespace EggAche_Impl
+{
+	// Glyph packed in the Atlas of a FontFace
+	struct Glyph
+	{
+		int x, y, w, h;						// Black Box in the Atlas
+		int xOff, yOff;						// Black Box relative to the Pen
+		int advance;						// Pen Movement after the Glyph
+	};
+
+	// Rasterized Glyph handed over by the Platform
+	struct GlyphBitmap
+	{
+		int w, h, xOff, yOff, advance;
+		std::vector<unsigned char> coverage;	// w * h, 0 (Empty) - 255 (Solid)
+	};
+
+	class FontFace
+	{
+	public:
+		FontFace ();
+		virtual ~FontFace () {}
+
+		void DrawTxt (const Surface &surface, const Rect &clip,
+					  int xBeg, int yBeg, const char *szText,
+					  uint32_t pixel);
+		// Remarks:
+		// 1. Draw szText with its upper left at (xBeg, yBeg), tinted by pixel;
+		// 2. Each Glyph is rasterized by the Platform only once,
+		//    and is blitted from the Coverage Atlas afterwards;
+		// 3. A Text drawn again is composed into a Text Blob (Coverage of
+		//    the whole Run), so the next Draws are a single Blit;
+		//    Blobs are tinted at Blit, so Colors share the same Blob;
+
+		bool MeasureTexts (const char *const *texts, size_t count,
+						   size_t *widths);
+		// Remarks:
+		// 1. Sum up the Advance Widths of each Text into widths[i];
+		// 2. Advance Widths are queried from the Platform only once
+		//    for all the 256 Characters;
+
+	protected:
+		virtual bool RasterizeGlyph (unsigned char ch,
+									 GlyphBitmap &bitmap) = 0;
+		// Remarks:
+		// Pen is at the Top-left of the Line, so xOff and yOff
+		// are usually (Left Bearing, Ascent - Glyph Top);
+
+		virtual bool LoadAdvances (int advances[256]) = 0;
+
+	private:
+		std::mutex mtx;
+
+		int advances[256];
+		bool isAdvanceLoaded;
+
+		Glyph glyphs[256];
+		bool isCached[256];
+
+		// Coverage Atlas packed Shelf by Shelf
+		int atlasW, atlasH;
+		std::vector<unsigned char> atlas;
+		int shelfX, shelfY, shelfH;
+
+		const Glyph &GetGlyph (unsigned char ch);
+		void Pack (int w, int h, int &x, int &y);
+
+		// Text Blobs in LRU Order, bounded by a Byte Budget
+		struct TextBlob
+		{
+			int xOff, yOff, w, h;				// Black Box relative to the Pen
+			std::vector<unsigned char> coverage;
+			std::list<std::string>::iterator itLru;
+		};
+		std::unordered_map<std::string, TextBlob> blobs;
+		std::list<std::string> blobLru;			// Most Recently Used first
+		size_t cbBlobs;
+		std::unordered_set<size_t> textsSeen;	// Hashes of Texts drawn once
+
+		const TextBlob *GetBlob (const char *szText, size_t cch);
+		bool BuildBlob (const char *szText, size_t cch,	// false if over
+						size_t cbMax, TextBlob &blob);	// cbMax Bytes
+
+		FontFace (const FontFace &) = delete;			// Not allow to copy
+		void operator= (const FontFace &) = delete;		// Not allow to copy
+	};
+
+	// Built-in Font needing no Platform Font System
+	class BitmapFontFace : public FontFace
+	{
+	public:
+		BitmapFontFace (unsigned size);
+		// Remarks:
+		// 1. Glyphs are 5 * 7 in a 6 * 8 Cell, compiled in as Tables;
+		// 2. The Cell is scaled by the Integer nearest to size / 8 (up to 4),
+		//    so 8, 16, 24 and 32 are the Sharpest Sizes;
+
+	protected:
+		bool RasterizeGlyph (unsigned char ch, GlyphBitmap &bitmap) override;
+		bool LoadAdvances (int advances[256]) override;
+
+	private:
+		int scale;
+	};
+
+	void BlitCoverage (const Surface &surface, const Rect &clip,
+					   int xDst, int yDst,
+					   const unsigned char *coverage, ptrdiff_t stride,
+					   int w, int h, uint32_t pixel);
+	// Remarks:
+	// Blend pixel onto surface by the Coverage, trimmed by clip;
+}
+
+#endif  //EGGACHE_GL_TEXT
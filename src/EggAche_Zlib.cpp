@@ -0,0 +1,1111 @@
+//
+// Portable Zlib Stream Helpers of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "EggAche_Raster.h"
+#include "EggAche_Zlib.h"
+
+#ifdef EGGACHE_GL_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace EggAche_Impl
+{
+	// Inflate
+
+	namespace
+	{
+		const int MAX_BITS = 15;				// Longest Huffman Code
+		const int FAST_BITS = 9;				// Codes decoded by a single Lookup
+
+		const unsigned short LENGTH_BASE[29] = {
+			3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+			35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		const unsigned char LENGTH_EXTRA[29] = {
+			0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+			3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		const unsigned short DIST_BASE[30] = {
+			1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+			257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+			8193, 12289, 16385, 24577 };
+		const unsigned char DIST_EXTRA[30] = {
+			0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+			7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		// Deflate packs Bits from the LSB of each Byte
+		class BitReader
+		{
+		public:
+			BitReader (const unsigned char *p, const unsigned char *end)
+				: p (p), end (end), bits (0), cBits (0), cOverrun (0)
+			{}
+
+			void Refill ()
+			{
+				while (cBits <= 56)
+				{
+					if (p < end) bits |= (uint64_t) *p++ << cBits;
+					else cOverrun++;
+					cBits += 8;
+				}
+			}
+
+			unsigned Peek (int n)
+			{
+				if (cBits < n) Refill ();
+				return (unsigned) (bits & ((1ull << n) - 1));
+			}
+
+			void Skip (int n)
+			{
+				bits >>= n;
+				cBits -= n;
+			}
+
+			unsigned Get (int n)
+			{
+				auto value = Peek (n);
+				Skip (n);
+				return value;
+			}
+
+			// Drop the Bits to the next Byte Boundary, and Copy Bytes
+			bool CopyBytes (unsigned char *dst, size_t cb)
+			{
+				Skip (cBits % 8);
+				for (; cb && cBits > 0; cb--)
+					*dst++ = (unsigned char) Get (8);
+				if (IsOverrun () || (size_t) (end - p) < cb)
+					return false;
+				memcpy (dst, p, cb);
+				p += cb;
+				return true;
+			}
+
+			// Consuming the Zeros padded past the End
+			// means a Truncated Stream
+			bool IsOverrun () const
+			{
+				return cOverrun * 8 > cBits;
+			}
+
+		private:
+			const unsigned char *p, *end;
+			uint64_t bits;
+			int cBits;
+			int cOverrun;						// Bytes padded past the End
+		};
+
+		// Canonical Huffman Decoder
+		class Huffman
+		{
+		public:
+			bool Build (const unsigned char *lengths, int count)
+			{
+				unsigned short cCode[MAX_BITS + 1] = { 0 };
+				for (auto i = 0; i < count; i++)
+					cCode[lengths[i]]++;
+				cCode[0] = 0;
+
+				// Reject Over-subscribed Code Sets
+				auto left = 1;
+				for (auto len = 1; len <= MAX_BITS; len++)
+				{
+					left = (left << 1) - cCode[len];
+					if (left < 0) return false;
+				}
+
+				// First Code and First Sorted Index of each Length
+				unsigned short nextCode[MAX_BITS + 2];
+				auto code = 0, index = 0;
+				for (auto len = 1; len <= MAX_BITS; len++)
+				{
+					firstCode[len] = (unsigned short) code;
+					firstIndex[len] = (unsigned short) index;
+					count_[len] = cCode[len];
+					nextCode[len] = (unsigned short) code;
+					code = (code + cCode[len]) << 1;
+					index += cCode[len];
+				}
+
+				std::fill (fast, fast + (1 << FAST_BITS), 0);
+				for (auto sym = 0; sym < count; sym++)
+				{
+					auto len = lengths[sym];
+					if (!len) continue;
+
+					auto codeOf = nextCode[len]++;
+					symbols[firstIndex[len] + codeOf - firstCode[len]] =
+						(unsigned short) sym;
+
+					// Codes are read Bit-reversed from the Stream
+					if (len > FAST_BITS) continue;
+					unsigned rev = 0;
+					for (auto i = 0; i < len; i++)
+						rev |= ((codeOf >> i) & 1u) << (len - 1 - i);
+					for (auto j = rev; j < (1u << FAST_BITS); j += 1u << len)
+						fast[j] = (unsigned short) ((len << FAST_BITS) | sym);
+				}
+				return true;
+			}
+
+			int Decode (BitReader &reader) const
+			{
+				auto entry = fast[reader.Peek (FAST_BITS)];
+				if (entry)
+				{
+					reader.Skip (entry >> FAST_BITS);
+					return entry & ((1 << FAST_BITS) - 1);
+				}
+
+				// Walk the Longer Codes Bit by Bit
+				auto bits = reader.Peek (MAX_BITS);
+				auto code = 0;
+				for (auto len = 1; len <= MAX_BITS; len++)
+				{
+					code |= (bits >> (len - 1)) & 1;
+					if ((unsigned) (code - firstCode[len]) < count_[len])
+					{
+						reader.Skip (len);
+						return symbols[firstIndex[len] + code - firstCode[len]];
+					}
+					code <<= 1;
+				}
+				return -1;
+			}
+
+		private:
+			unsigned short fast[1 << FAST_BITS];	// (Length << FAST_BITS) | Symbol
+			unsigned short firstCode[MAX_BITS + 1];
+			unsigned short firstIndex[MAX_BITS + 1];
+			unsigned short count_[MAX_BITS + 1];
+			unsigned short symbols[288];			// Sorted by (Length, Symbol)
+		};
+
+		bool BuildFixed (Huffman &lit, Huffman &dist)
+		{
+			unsigned char lengths[288];
+			std::fill (lengths, lengths + 144, 8);
+			std::fill (lengths + 144, lengths + 256, 9);
+			std::fill (lengths + 256, lengths + 280, 7);
+			std::fill (lengths + 280, lengths + 288, 8);
+			if (!lit.Build (lengths, 288))
+				return false;
+
+			std::fill (lengths, lengths + 30, 5);
+			return dist.Build (lengths, 30);
+		}
+
+		bool BuildDynamic (BitReader &reader, Huffman &lit, Huffman &dist)
+		{
+			static const unsigned char ORDER[19] = {
+				16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+			auto cLit = (int) reader.Get (5) + 257;
+			auto cDist = (int) reader.Get (5) + 1;
+			auto cLen = (int) reader.Get (4) + 4;
+			if (cLit > 286 || cDist > 30)
+				return false;
+
+			unsigned char lengths[286 + 30] = { 0 };
+			for (auto i = 0; i < cLen; i++)
+				lengths[ORDER[i]] = (unsigned char) reader.Get (3);
+
+			Huffman lens;
+			if (!lens.Build (lengths, 19))
+				return false;
+
+			// Literal/Length and Distance Lengths are Run-length Coded together
+			std::fill (lengths, lengths + 19, 0);
+			for (auto i = 0; i < cLit + cDist;)
+			{
+				auto sym = lens.Decode (reader);
+				if (sym < 0 || reader.IsOverrun ())
+					return false;
+
+				if (sym < 16)
+				{
+					lengths[i++] = (unsigned char) sym;
+					continue;
+				}
+
+				unsigned char value = 0;
+				int repeat;
+				if (sym == 16)
+				{
+					if (i == 0) return false;
+					value = lengths[i - 1];
+					repeat = 3 + (int) reader.Get (2);
+				}
+				else if (sym == 17)
+					repeat = 3 + (int) reader.Get (3);
+				else
+					repeat = 11 + (int) reader.Get (7);
+
+				if (i + repeat > cLit + cDist)
+					return false;
+				std::fill (lengths + i, lengths + i + repeat, value);
+				i += repeat;
+			}
+
+			return lit.Build (lengths, cLit) &&
+				dist.Build (lengths + cLit, cDist);
+		}
+	}
+
+	bool Inflate (const unsigned char *data, size_t size,
+				  std::vector<unsigned char> &out,
+				  size_t sizeHint)
+	{
+		// Zlib Header: Deflate with Window <= 32K, no Preset Dictionary
+		if (size < 2 || (data[0] & 0xF) != 8 || (data[0] >> 4) > 7 ||
+			((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20))
+			return false;
+
+		BitReader reader (data + 2, data + size);
+		out.resize (std::max (sizeHint, (size_t) 1024));
+		size_t n = 0;
+
+		auto reserve = [&] (size_t cb)
+		{
+			if (n + cb > out.size ())
+				out.resize (std::max (out.size () * 2, n + cb));
+		};
+
+		Huffman lit, dist;
+		for (auto isFinal = false; !isFinal;)
+		{
+			isFinal = reader.Get (1) != 0;
+			auto type = reader.Get (2);
+
+			if (type == 0)
+			{
+				// Stored Block
+				unsigned char header[4];
+				if (!reader.CopyBytes (header, 4))
+					return false;
+				auto len = (size_t) (header[0] | (header[1] << 8));
+				auto nlen = (size_t) (header[2] | (header[3] << 8));
+				if ((len ^ 0xFFFF) != nlen)
+					return false;
+
+				reserve (len);
+				if (!reader.CopyBytes (&out[n], len))
+					return false;
+				n += len;
+				continue;
+			}
+
+			if (type == 1) { if (!BuildFixed (lit, dist)) return false; }
+			else if (type == 2) { if (!BuildDynamic (reader, lit, dist)) return false; }
+			else return false;
+
+			for (;;)
+			{
+				auto sym = lit.Decode (reader);
+				if (sym < 0 || reader.IsOverrun ())
+					return false;
+
+				if (sym < 256)
+				{
+					reserve (1);
+					out[n++] = (unsigned char) sym;
+					continue;
+				}
+				if (sym == 256)
+					break;
+
+				sym -= 257;
+				if (sym >= 29)
+					return false;
+				auto len = (size_t) LENGTH_BASE[sym] + reader.Get (LENGTH_EXTRA[sym]);
+
+				auto symDist = dist.Decode (reader);
+				if (symDist < 0 || symDist >= 30)
+					return false;
+				auto distance = (size_t) DIST_BASE[symDist] + reader.Get (DIST_EXTRA[symDist]);
+				if (distance > n)
+					return false;
+
+				// Overlapped Copies repeat the last distance Bytes
+				reserve (len);
+				auto dst = &out[n];
+				auto src = dst - distance;
+				if (distance >= len)
+					memcpy (dst, src, len);
+				else
+					for (size_t i = 0; i < len; i++)
+						dst[i] = src[i];
+				n += len;
+			}
+		}
+
+		out.resize (n);
+		return !reader.IsOverrun ();
+	}
+
+	// Deflate
+
+	namespace
+	{
+		const int WINDOW_SIZE = 32768;
+		const int WINDOW_MASK = WINDOW_SIZE - 1;
+		const int BUFFER_SIZE = 2 * WINDOW_SIZE;	// Window and Lookahead
+		const int PADDING = 16;					// Loads of 16 Bytes near the End
+		const int HASH_BITS = 15;
+		const int MIN_MATCH = 3;
+		const int MAX_MATCH = 258;
+		const int MIN_LOOKAHEAD = MAX_MATCH + MIN_MATCH + 1;
+		const int TOO_FAR = 4096;				// Shortest Matches Cost more beyond
+		const size_t BLOCK_SYMBOLS = 16384;
+
+		const unsigned char CODE_LENGTH_ORDER[19] = {
+			16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+		const unsigned char CODE_LENGTH_EXTRA[19] = {
+			0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7 };
+
+		// Codes of Lengths (3 - 258) and Distances (1 - 32768)
+		struct SymbolCodes
+		{
+			unsigned char lengthCode[256];		// By Length - 3
+			unsigned char distCode[512];		// By Dist - 1 (< 256),
+												// or 256 + (Dist - 1) >> 7
+			SymbolCodes ()
+			{
+				for (auto code = 0; code < 29; code++)
+					for (auto len = (int) LENGTH_BASE[code];
+						 len < LENGTH_BASE[code] + (1 << LENGTH_EXTRA[code]) &&
+						 len <= MAX_MATCH; len++)
+						lengthCode[len - MIN_MATCH] = (unsigned char) code;
+				for (auto code = 0; code < 30; code++)
+					for (auto dist = DIST_BASE[code] - 1;
+						 dist < DIST_BASE[code] - 1 + (1 << DIST_EXTRA[code]); dist++)
+					{
+						if (dist < 256) distCode[dist] = (unsigned char) code;
+						else distCode[256 + (dist >> 7)] = (unsigned char) code;
+					}
+			}
+
+			int Length (int len) const
+			{
+				return lengthCode[len - MIN_MATCH];
+			}
+
+			int Dist (int dist) const
+			{
+				return dist <= 256 ? distCode[dist - 1] : distCode[256 + ((dist - 1) >> 7)];
+			}
+		};
+
+		const SymbolCodes &Codes ()
+		{
+			static const SymbolCodes codes;
+			return codes;
+		}
+
+		inline unsigned Hash (const unsigned char *p)
+		{
+			auto v = (uint32_t) p[0] | (p[1] << 8) | (p[2] << 16);
+			return (v * 2654435761u) >> (32 - HASH_BITS);
+		}
+
+		// Count the Bytes of a equal to b, up to maxLen
+		// (16 Bytes may be Read from each, past maxLen)
+		inline int MatchLength (const unsigned char *a, const unsigned char *b,
+								int maxLen)
+		{
+#ifdef EGGACHE_GL_SSE2
+			for (auto len = 0; len < maxLen; len += 16)
+			{
+				auto mask = (unsigned) _mm_movemask_epi8 (_mm_cmpeq_epi8 (
+					_mm_loadu_si128 ((const __m128i *) (a + len)),
+					_mm_loadu_si128 ((const __m128i *) (b + len))));
+				if (mask != 0xFFFF)
+				{
+					// Index of the Lowest Byte Different
+#ifdef _MSC_VER
+					unsigned long index;
+					_BitScanForward (&index, ~mask);
+#else
+					auto index = __builtin_ctz (~mask);
+#endif
+					return std::min (len + (int) index, maxLen);
+				}
+			}
+			return maxLen;
+#else
+			auto len = 0;
+			while (len < maxLen && a[len] == b[len])
+				len++;
+			return len;
+#endif
+		}
+
+		// Code Lengths of Minimum Redundancy (Moffat and Katajainen, in Place),
+		// Limited to maxBits by moving the Deepest Leaves up
+		void BuildLengths (const uint32_t *freqs, int count, int maxBits,
+						   unsigned char *lengths)
+		{
+			struct Leaf
+			{
+				uint32_t key;					// Frequency, then Code Length
+				int sym;
+			} leaves[288];
+
+			auto n = 0;
+			for (auto sym = 0; sym < count; sym++)
+			{
+				lengths[sym] = 0;
+				if (freqs[sym]) leaves[n++] = Leaf { freqs[sym], sym };
+			}
+			if (n == 0)
+				return;
+			if (n == 1)
+			{
+				lengths[leaves[0].sym] = 1;
+				return;
+			}
+			std::stable_sort (leaves, leaves + n, [] (const Leaf &a, const Leaf &b)
+			{
+				return a.key < b.key;
+			});
+
+			// Sum up Internal Nodes (keys become Parent Indexes)
+			leaves[0].key += leaves[1].key;
+			auto root = 0, leaf = 2;
+			for (auto next = 1; next < n - 1; next++)
+			{
+				if (leaf >= n || leaves[root].key < leaves[leaf].key)
+				{
+					leaves[next].key = leaves[root].key;
+					leaves[root++].key = (uint32_t) next;
+				}
+				else
+					leaves[next].key = leaves[leaf++].key;
+
+				if (leaf >= n || (root < next && leaves[root].key < leaves[leaf].key))
+				{
+					leaves[next].key += leaves[root].key;
+					leaves[root++].key = (uint32_t) next;
+				}
+				else
+					leaves[next].key += leaves[leaf++].key;
+			}
+
+			// Depths of Internal Nodes, and then of the Leaves
+			leaves[n - 2].key = 0;
+			for (auto next = n - 3; next >= 0; next--)
+				leaves[next].key = leaves[leaves[next].key].key + 1;
+			auto avail = 1, used = 0, depth = 0;
+			root = n - 2;
+			auto next = n - 1;
+			while (avail > 0)
+			{
+				while (root >= 0 && (int) leaves[root].key == depth)
+				{
+					used++;
+					root--;
+				}
+				while (avail > used)
+				{
+					leaves[next--].key = (uint32_t) depth;
+					avail--;
+				}
+				avail = 2 * used;
+				depth++;
+				used = 0;
+			}
+
+			// Count by Length, and Split Shorter Codes till the Longer fit
+			int cLength[MAX_BITS + 1] = { 0 };
+			for (auto i = 0; i < n; i++)
+				cLength[std::min ((int) leaves[i].key, maxBits)]++;
+			uint32_t total = 0;
+			for (auto len = maxBits; len > 0; len--)
+				total += (uint32_t) cLength[len] << (maxBits - len);
+			for (; total != (1u << maxBits); total--)
+			{
+				cLength[maxBits]--;
+				for (auto len = maxBits - 1; len > 0; len--)
+					if (cLength[len])
+					{
+						cLength[len]--;
+						cLength[len + 1] += 2;
+						break;
+					}
+			}
+
+			// The Rarest get the Longest
+			auto i = 0;
+			for (auto len = maxBits; len > 0; len--)
+				for (auto k = 0; k < cLength[len]; k++)
+					lengths[leaves[i++].sym] = (unsigned char) len;
+		}
+
+		// Canonical Codes, Bit-reversed to be Written from the LSB
+		void BuildCodes (const unsigned char *lengths, int count,
+						 unsigned short *codes)
+		{
+			unsigned short cCode[MAX_BITS + 1] = { 0 }, nextCode[MAX_BITS + 1];
+			for (auto i = 0; i < count; i++)
+				cCode[lengths[i]]++;
+			cCode[0] = 0;
+			auto code = 0;
+			for (auto len = 1; len <= MAX_BITS; len++)
+			{
+				code = (code + cCode[len - 1]) << 1;
+				nextCode[len] = (unsigned short) code;
+			}
+			for (auto sym = 0; sym < count; sym++)
+			{
+				auto len = lengths[sym];
+				if (!len) continue;
+				unsigned value = nextCode[len]++, rev = 0;
+				for (auto i = 0; i < len; i++)
+					rev |= ((value >> i) & 1u) << (len - 1 - i);
+				codes[sym] = (unsigned short) rev;
+			}
+		}
+
+	}
+
+	Deflater::Deflater (int level)
+		: window (BUFFER_SIZE + PADDING), pos (0), end (0),
+		blockStart (0), blockEnd (0),
+		head (1 << HASH_BITS, -1), prev (WINDOW_SIZE, -1),
+		prevLen (0), prevDist (0), isPending (false),
+		adler (1), isStarted (false), bits (0), cBits (0)
+	{
+		// zlib's Parameters: (Chain, Good, Nice, Lazy)
+		static const Config CONFIGS[10] = {
+			{ 0, 0, 0, 0, false },
+			{ 4, 4, 8, 4, false },
+			{ 8, 4, 16, 5, false },
+			{ 32, 4, 32, 6, false },
+			{ 16, 4, 16, 4, true },
+			{ 32, 8, 32, 16, true },
+			{ 128, 8, 128, 16, true },
+			{ 256, 8, 128, 32, true },
+			{ 1024, 32, 258, 128, true },
+			{ 4096, 32, 258, 258, true } };
+		this->level = std::min (std::max (level, 0), 9);
+		config = CONFIGS[this->level];
+		symbols.reserve (BLOCK_SYMBOLS);
+	}
+
+	void Deflater::Write (const unsigned char *data, size_t size,
+						  std::vector<unsigned char> &out)
+	{
+		if (!isStarted)
+		{
+			// Zlib Header: Deflate with 32K Window, and the Level Hinted
+			static const unsigned char FLAGS[10] = {
+				0x01, 0x01, 0x5E, 0x5E, 0x5E, 0x5E, 0x9C, 0xDA, 0xDA, 0xDA };
+			out.push_back (0x78);
+			out.push_back (FLAGS[level]);
+			isStarted = true;
+		}
+		adler = Adler32 (adler, data, size);
+
+		while (size)
+		{
+			if (end == BUFFER_SIZE)
+				Slide (out);
+			auto n = std::min (size, (size_t) (BUFFER_SIZE - end));
+			memcpy (&window[end], data, n);
+			end += (int) n;
+			data += n;
+			size -= n;
+
+			if (!level) pos = blockEnd = end;	// Stored as they are
+			else if (config.isLazy) CompressLazy (false, out);
+			else Compress (false, out);
+		}
+	}
+
+	void Deflater::Finish (std::vector<unsigned char> &out)
+	{
+		Write (nullptr, 0, out);
+		if (config.isLazy) CompressLazy (true, out);
+		else if (level) Compress (true, out);
+		FlushBlock (true, out);
+		AlignBits (out);
+		for (auto shift = 24; shift >= 0; shift -= 8)
+			out.push_back ((unsigned char) (adler >> shift));
+	}
+
+	int Deflater::Insert (int at)
+	{
+		auto hash = Hash (&window[at]);
+		auto cand = head[hash];
+		prev[at & WINDOW_MASK] = cand;
+		head[hash] = at;
+		return cand;
+	}
+
+	int Deflater::FindMatch (int cand, int maxLen, int chain, int &bestLen) const
+	{
+		// Chains go back strictly, and Entries older than
+		// the Window may be Overwritten, so they Stop there
+		auto cur = &window[pos];
+		auto limit = std::max (pos - WINDOW_SIZE, -1);
+		auto bestDist = 0;
+		if (bestLen >= maxLen)
+			return 0;
+
+		for (; cand > limit && chain; chain--)
+		{
+			// The Byte past the Best, and the First Two, tell most Misses
+			auto match = &window[cand];
+			if (match[bestLen] == cur[bestLen] &&
+				match[0] == cur[0] && match[1] == cur[1])
+			{
+				auto len = MatchLength (match, cur, maxLen);
+				if (len > bestLen)
+				{
+					bestLen = len;
+					bestDist = pos - cand;
+					if (len >= config.niceLen || len == maxLen)
+						break;
+				}
+			}
+			cand = prev[cand & WINDOW_MASK];
+		}
+		return bestDist;
+	}
+
+	void Deflater::Compress (bool isFinal, std::vector<unsigned char> &out)
+	{
+		// Greedy Matching; Matches are kept inside the Lookahead,
+		// so only the End of Stream cuts them short
+		while (isFinal ? pos < end : end - pos >= MIN_LOOKAHEAD)
+		{
+			auto maxLen = std::min (end - pos, MAX_MATCH);
+			auto bestLen = MIN_MATCH - 1, bestDist = 0;
+			if (maxLen >= MIN_MATCH)
+			{
+				auto cand = Insert (pos);
+				if (config.maxChain)
+					bestDist = FindMatch (cand, maxLen, config.maxChain, bestLen);
+			}
+
+			if (bestDist && (bestLen > MIN_MATCH || bestDist <= TOO_FAR))
+			{
+				PutSymbol (bestLen, bestDist, bestLen, out);
+
+				// Bytes inside Short Matches are Chained as well
+				if (bestLen <= config.lazyLen)
+					for (auto at = pos + 1; at < pos + bestLen && at + MIN_MATCH <= end; at++)
+						Insert (at);
+				pos += bestLen;
+			}
+			else
+			{
+				PutSymbol (window[pos], 0, 1, out);
+				pos++;
+			}
+		}
+	}
+
+	void Deflater::CompressLazy (bool isFinal, std::vector<unsigned char> &out)
+	{
+		// Each Match is Deferred a Byte, and Dropped (for a Literal)
+		// if the Match from the next Byte is Longer
+		while (isFinal ? pos < end : end - pos >= MIN_LOOKAHEAD)
+		{
+			auto maxLen = std::min (end - pos, MAX_MATCH);
+			auto bestLen = 0, bestDist = 0;
+			if (maxLen >= MIN_MATCH)
+			{
+				auto cand = Insert (pos);
+				if (prevLen < config.lazyLen)
+				{
+					bestLen = std::max (prevLen, MIN_MATCH - 1);
+					bestDist = FindMatch (cand, maxLen, prevLen >= config.goodLen ?
+										  config.maxChain >> 2 : config.maxChain, bestLen);
+					if (bestLen == MIN_MATCH && bestDist > TOO_FAR)
+						bestDist = 0;
+				}
+			}
+			if (!bestDist)
+				bestLen = 0;
+
+			if (prevLen >= MIN_MATCH && bestLen <= prevLen)
+			{
+				// The Deferred Match (from pos - 1) is Taken,
+				// and its Bytes (to pos already) Chained
+				PutSymbol (prevLen, prevDist, prevLen, out);
+				auto matchEnd = pos - 1 + prevLen;
+				for (auto at = pos + 1; at < matchEnd && at + MIN_MATCH <= end; at++)
+					Insert (at);
+				pos = matchEnd;
+				prevLen = 0;
+				isPending = false;
+			}
+			else
+			{
+				if (isPending)
+					PutSymbol (window[pos - 1], 0, 1, out);
+				prevLen = bestLen;
+				prevDist = bestDist;
+				isPending = true;
+				pos++;
+			}
+		}
+
+		if (isFinal && isPending)
+		{
+			PutSymbol (window[pos - 1], 0, 1, out);
+			prevLen = 0;
+			isPending = false;
+		}
+	}
+
+	void Deflater::PutSymbol (int litLen, int dist, int cb,
+							  std::vector<unsigned char> &out)
+	{
+		symbols.push_back (Symbol { (uint16_t) litLen, (uint16_t) dist });
+		blockEnd += cb;
+		if (symbols.size () == BLOCK_SYMBOLS)
+			FlushBlock (false, out);
+	}
+
+	void Deflater::Slide (std::vector<unsigned char> &out)
+	{
+		// Bytes of the Block are kept for a Stored Block
+		if (blockStart < WINDOW_SIZE)
+			FlushBlock (false, out);
+
+		memmove (&window[0], &window[WINDOW_SIZE], (size_t) (end - WINDOW_SIZE));
+		pos -= WINDOW_SIZE;
+		end -= WINDOW_SIZE;
+		blockStart -= WINDOW_SIZE;
+		blockEnd -= WINDOW_SIZE;
+		for (auto &p : head)
+			p = p >= WINDOW_SIZE ? p - WINDOW_SIZE : -1;
+		for (auto &p : prev)
+			p = p >= WINDOW_SIZE ? p - WINDOW_SIZE : -1;
+	}
+
+	void Deflater::FlushBlock (bool isFinal, std::vector<unsigned char> &out)
+	{
+		if (!isFinal && blockEnd == blockStart)
+			return;
+
+		// Level 0 takes no Symbols, and Stores every Block
+		if (!level)
+		{
+			PutStored (isFinal, out);
+			blockStart = blockEnd;
+			return;
+		}
+
+		const auto &codes = Codes ();
+		uint32_t litFreqs[286] = { 0 }, distFreqs[30] = { 0 };
+		for (const auto &symbol : symbols)
+		{
+			if (!symbol.dist)
+				litFreqs[symbol.litLen]++;
+			else
+			{
+				litFreqs[257 + codes.Length (symbol.litLen)]++;
+				distFreqs[codes.Dist (symbol.dist)]++;
+			}
+		}
+		litFreqs[256] = 1;
+
+		// At least one Distance Code, for Decoders rejecting None
+		unsigned char litLengths[286], distLengths[30];
+		BuildLengths (litFreqs, 286, MAX_BITS, litLengths);
+		if (std::all_of (distFreqs, distFreqs + 30, [] (uint32_t freq) { return !freq; }))
+		{
+			distLengths[0] = 1;
+			std::fill (distLengths + 1, distLengths + 30, 0);
+		}
+		else
+			BuildLengths (distFreqs, 30, MAX_BITS, distLengths);
+
+		auto cLit = 286, cDist = 30;
+		while (cLit > 257 && !litLengths[cLit - 1]) cLit--;
+		while (cDist > 1 && !distLengths[cDist - 1]) cDist--;
+
+		// Both Lengths are Run-length Coded together
+		unsigned char lengths[286 + 30];
+		std::copy (litLengths, litLengths + cLit, lengths);
+		std::copy (distLengths, distLengths + cDist, lengths + cLit);
+
+		std::vector<std::pair<unsigned char, unsigned char>> lengthSyms;	// (Symbol, Extra)
+		uint32_t lengthFreqs[19] = { 0 };
+		auto putLength = [&] (int sym, int extra)
+		{
+			lengthSyms.emplace_back ((unsigned char) sym, (unsigned char) extra);
+			lengthFreqs[sym]++;
+		};
+		for (auto i = 0; i < cLit + cDist;)
+		{
+			auto value = lengths[i];
+			auto run = 1;
+			while (i + run < cLit + cDist && lengths[i + run] == value)
+				run++;
+			i += run;
+
+			if (!value)
+			{
+				for (; run >= 11; run -= std::min (run, 138))
+					putLength (18, std::min (run, 138) - 11);
+				if (run >= 3)
+				{
+					putLength (17, run - 3);
+					run = 0;
+				}
+			}
+			else
+			{
+				putLength (value, 0);
+				for (run--; run >= 3; run -= std::min (run, 6))
+					putLength (16, std::min (run, 6) - 3);
+			}
+			for (; run > 0; run--)
+				putLength (value, 0);
+		}
+
+		unsigned char lengthLengths[19];
+		BuildLengths (lengthFreqs, 19, 7, lengthLengths);
+		auto cLength = 19;
+		while (cLength > 4 && !lengthLengths[CODE_LENGTH_ORDER[cLength - 1]])
+			cLength--;
+
+		// Bits of each Block Type
+		unsigned char fixedLengths[288 + 30];
+		std::fill (fixedLengths, fixedLengths + 144, 8);
+		std::fill (fixedLengths + 144, fixedLengths + 256, 9);
+		std::fill (fixedLengths + 256, fixedLengths + 280, 7);
+		std::fill (fixedLengths + 280, fixedLengths + 288, 8);
+		std::fill (fixedLengths + 288, fixedLengths + 288 + 30, 5);
+
+		uint64_t extraBits = 0, dynamicBits = 17 + 3 * (uint64_t) cLength, fixedBits = 3;
+		for (auto sym = 0; sym < 286; sym++)
+		{
+			extraBits += (uint64_t) litFreqs[sym] * (sym > 256 ? LENGTH_EXTRA[sym - 257] : 0);
+			dynamicBits += (uint64_t) litFreqs[sym] * litLengths[sym];
+			fixedBits += (uint64_t) litFreqs[sym] * fixedLengths[sym];
+		}
+		for (auto sym = 0; sym < 30; sym++)
+		{
+			extraBits += (uint64_t) distFreqs[sym] * DIST_EXTRA[sym];
+			dynamicBits += (uint64_t) distFreqs[sym] * distLengths[sym];
+			fixedBits += (uint64_t) distFreqs[sym] * 5;
+		}
+		for (auto sym = 0; sym < 19; sym++)
+			dynamicBits += (uint64_t) lengthFreqs[sym] *
+				(lengthLengths[sym] + CODE_LENGTH_EXTRA[sym]);
+		dynamicBits += extraBits;
+		fixedBits += extraBits;
+
+		// Stored, unless the Codes take Fewer Bits (see PutStored)
+		auto cRaw = (size_t) (blockEnd - blockStart);
+		auto storedBits = (uint64_t) cRaw * 8 +
+			std::max ((cRaw + 65534) / 65535, (size_t) 1) * (3 + 7 + 32);
+
+		if (storedBits <= std::min (dynamicBits, fixedBits))
+			PutStored (isFinal, out);
+		else
+		{
+			const unsigned char *litLens = litLengths, *distLens = distLengths;
+			auto cLitCodes = 286;
+			unsigned short litCodes[288], distCodes[30];
+			if (dynamicBits < fixedBits)
+			{
+				unsigned short lengthCodes[19];
+				BuildCodes (lengthLengths, 19, lengthCodes);
+				PutBits (isFinal ? 5 : 4, 3, out);
+				PutBits ((unsigned) (cLit - 257), 5, out);
+				PutBits ((unsigned) (cDist - 1), 5, out);
+				PutBits ((unsigned) (cLength - 4), 4, out);
+				for (auto i = 0; i < cLength; i++)
+					PutBits (lengthLengths[CODE_LENGTH_ORDER[i]], 3, out);
+				for (const auto &length : lengthSyms)
+				{
+					PutBits (lengthCodes[length.first], lengthLengths[length.first], out);
+					PutBits (length.second, CODE_LENGTH_EXTRA[length.first], out);
+				}
+			}
+			else
+			{
+				// Codes 286 and 287 are never used, but Shift the Longer Codes
+				litLens = fixedLengths;
+				distLens = fixedLengths + 288;
+				cLitCodes = 288;
+				PutBits (isFinal ? 3 : 2, 3, out);
+			}
+			BuildCodes (litLens, cLitCodes, litCodes);
+			BuildCodes (distLens, 30, distCodes);
+
+			for (const auto &symbol : symbols)
+			{
+				if (!symbol.dist)
+				{
+					PutBits (litCodes[symbol.litLen], litLens[symbol.litLen], out);
+					continue;
+				}
+				auto lenCode = codes.Length (symbol.litLen);
+				PutBits (litCodes[257 + lenCode], litLens[257 + lenCode], out);
+				PutBits (symbol.litLen - LENGTH_BASE[lenCode], LENGTH_EXTRA[lenCode], out);
+				auto distCode = codes.Dist (symbol.dist);
+				PutBits (distCodes[distCode], distLens[distCode], out);
+				PutBits (symbol.dist - DIST_BASE[distCode], DIST_EXTRA[distCode], out);
+			}
+			PutBits (litCodes[256], litLens[256], out);
+		}
+
+		symbols.clear ();
+		blockStart = blockEnd;
+	}
+
+	void Deflater::PutStored (bool isFinal, std::vector<unsigned char> &out)
+	{
+		// Stored Blocks hold 65535 Bytes at most, after the Byte Boundary
+		auto raw = &window[blockStart];
+		auto cRaw = (size_t) (blockEnd - blockStart);
+		auto cStored = std::max ((cRaw + 65534) / 65535, (size_t) 1);
+		for (size_t i = 0; i < cStored; i++)
+		{
+			auto n = std::min (cRaw, (size_t) 65535);
+			PutBits (isFinal && i == cStored - 1 ? 1 : 0, 3, out);
+			AlignBits (out);
+			unsigned char header[4] = {
+				(unsigned char) n, (unsigned char) (n >> 8),
+				(unsigned char) ~n, (unsigned char) (~n >> 8) };
+			out.insert (out.end (), header, header + 4);
+			out.insert (out.end (), raw, raw + n);
+			raw += n;
+			cRaw -= n;
+		}
+	}
+
+	void Deflater::PutBits (unsigned value, int n, std::vector<unsigned char> &out)
+	{
+		bits |= (uint64_t) value << cBits;
+		cBits += n;
+		if (cBits >= 32)
+		{
+			unsigned char bytes[4] = {
+				(unsigned char) bits, (unsigned char) (bits >> 8),
+				(unsigned char) (bits >> 16), (unsigned char) (bits >> 24) };
+			out.insert (out.end (), bytes, bytes + 4);
+			bits >>= 32;
+			cBits -= 32;
+		}
+	}
+
+	void Deflater::AlignBits (std::vector<unsigned char> &out)
+	{
+		for (; cBits > 0; cBits -= 8)
+		{
+			out.push_back ((unsigned char) bits);
+			bits >>= 8;
+		}
+		bits = 0;
+		cBits = 0;
+	}
+
+	uint32_t Crc32 (uint32_t crc, const unsigned char *data, size_t size)
+	{
+		// tables[k][n] is the CRC of n followed by k Zero Bytes
+		struct Tables
+		{
+			uint32_t entries[8][256];
+
+			Tables ()
+			{
+				for (uint32_t n = 0; n < 256; n++)
+				{
+					auto c = n;
+					for (auto k = 0; k < 8; k++)
+						c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+					entries[0][n] = c;
+				}
+				for (auto k = 1; k < 8; k++)
+					for (auto n = 0; n < 256; n++)
+						entries[k][n] = (entries[k - 1][n] >> 8) ^
+							entries[0][entries[k - 1][n] & 0xFF];
+			}
+		};
+		static const Tables tables;
+		const auto &t = tables.entries;
+
+		crc = ~crc;
+		for (; size >= 8; size -= 8, data += 8)
+		{
+			auto lo = crc ^ ((uint32_t) data[0] | (data[1] << 8) |
+							 (data[2] << 16) | ((uint32_t) data[3] << 24));
+			crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^
+				t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+				t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+		}
+		for (; size; size--)
+			crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	uint32_t Adler32 (uint32_t adler, const unsigned char *data, size_t size)
+	{
+		// Sums are Reduced every 5552 Bytes, before they could overflow
+		const size_t NMAX = 5552;
+		uint32_t a = adler & 0xFFFF, b = adler >> 16;
+		while (size)
+		{
+			auto n = std::min (size, NMAX);
+			size -= n;
+#ifdef EGGACHE_GL_SSE2
+			// For each 16 Bytes, b gains 16 a and the Bytes Weighted 16 - 1,
+			// and a gains the Bytes; a of the Blocks before is Summed in vPrev
+			auto cBlock = n / 16;
+			if (cBlock)
+			{
+				auto zero = _mm_setzero_si128 ();
+				auto wLo = _mm_set_epi16 (9, 10, 11, 12, 13, 14, 15, 16);
+				auto wHi = _mm_set_epi16 (1, 2, 3, 4, 5, 6, 7, 8);
+				auto vA = zero, vPrev = zero, vB = zero;
+				for (size_t i = 0; i < cBlock; i++, data += 16)
+				{
+					auto bytes = _mm_loadu_si128 ((const __m128i *) data);
+					vPrev = _mm_add_epi32 (vPrev, vA);
+					vA = _mm_add_epi32 (vA, _mm_sad_epu8 (bytes, zero));
+					vB = _mm_add_epi32 (vB, _mm_add_epi32 (
+						_mm_madd_epi16 (_mm_unpacklo_epi8 (bytes, zero), wLo),
+						_mm_madd_epi16 (_mm_unpackhi_epi8 (bytes, zero), wHi)));
+				}
+
+				uint32_t sums[3][4];
+				_mm_storeu_si128 ((__m128i *) sums[0], vA);
+				_mm_storeu_si128 ((__m128i *) sums[1], vPrev);
+				_mm_storeu_si128 ((__m128i *) sums[2], vB);
+				auto sumA = (uint64_t) sums[0][0] + sums[0][2];
+				auto sumPrev = (uint64_t) sums[1][0] + sums[1][2];
+				auto sumB = (uint64_t) sums[2][0] + sums[2][1] + sums[2][2] + sums[2][3];
+				b = (uint32_t) ((b + (uint64_t) a * 16 * cBlock + sumPrev * 16 + sumB) % 65521);
+				a = (uint32_t) ((a + sumA) % 65521);
+				n -= cBlock * 16;
+			}
+#endif
+			for (; n; n--)
+			{
+				a += *data++;
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+		}
+		return (b << 16) | a;
+	}
+}
@@ -0,0 +1,101 @@
+//
+// Portable Zlib Stream Helpers of EggAche Graphics Library
+// By BOT Man, 2016
+//
+
+#ifndef EGGACHE_GL_ZLIB
+#define EGGACHE_GL_ZLIB
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace EggAche_Impl
+{
+	bool Inflate (const unsigned char *data, size_t size,
+				  std::vector<unsigned char> &out,
+				  size_t sizeHint = 0);
+	// Remarks:
+	// 1. Decompress a Zlib Stream (RFC 1950/1951) into out;
+	// 2. sizeHint is the Expected Size of out, if known;
+	// 3. Return false if the Stream is Corrupted;
+	// 4. Only Local States are used, so it's safe to call from any Thread;
+
+	// Zlib Stream Compressed Piece by Piece
+	class Deflater
+	{
+	public:
+		Deflater (int level = 6);
+		// Remarks:
+		// 1. level is 0 - 9 as zlib's: 0 Stores the Bytes as they are,
+		//    1 - 3 take the First Match of Short Hash Chains, and 4 - 9 Defer
+		//    each Match a Byte (Lazy Matching) along Longer and Longer Chains;
+		// 2. Matches are Compared 16 Bytes at a time (by SSE2);
+
+		void Write (const unsigned char *data, size_t size,
+					std::vector<unsigned char> &out);
+		// Remarks:
+		// 1. Compress the next size Bytes of the Stream, and Append to out
+		//    the Blocks Done so far (most Bytes wait for a whole Block);
+		// 2. Only a 64K Window and the Symbols of a Block are held,
+		//    however long the Stream goes on;
+
+		void Finish (std::vector<unsigned char> &out);
+		// Remarks:
+		// End the Stream (with its Adler-32), and Append the rest to out;
+
+	private:
+		struct Symbol
+		{
+			uint16_t litLen;					// Literal, or Length of a Match
+			uint16_t dist;						// 0 for a Literal
+		};
+
+		int level;
+		struct Config
+		{
+			int maxChain;						// Candidates tried for a Match
+			int goodLen;						// Quarter the Chain beyond it
+			int niceLen;						// Stop Trying beyond it
+			int lazyLen;						// No Lazy Match (or Chaining of
+												// the Bytes Matched) beyond it
+			bool isLazy;
+		} config;
+
+		std::vector<unsigned char> window;		// Last 32K Compressed, and Lookahead
+		int pos, end;							// Offsets in window
+		int blockStart, blockEnd;				// Bytes of the Block's Symbols
+		std::vector<int> head, prev;			// Hash Chains of the Positions
+		std::vector<Symbol> symbols;			// Symbols of the Block so far
+		int prevLen, prevDist;					// Match Deferred by Lazy Matching
+		bool isPending;							// Byte before pos not Coded yet
+
+		uint32_t adler;
+		bool isStarted;
+		uint64_t bits;							// Output Bits not Appended yet
+		int cBits;
+
+		void Compress (bool isFinal, std::vector<unsigned char> &out);
+		void CompressLazy (bool isFinal, std::vector<unsigned char> &out);
+		int Insert (int at);
+		int FindMatch (int cand, int maxLen, int chain, int &bestLen) const;
+		void PutSymbol (int litLen, int dist, int cb, std::vector<unsigned char> &out);
+		void Slide (std::vector<unsigned char> &out);
+		void FlushBlock (bool isFinal, std::vector<unsigned char> &out);
+		void PutStored (bool isFinal, std::vector<unsigned char> &out);
+		void PutBits (unsigned value, int n, std::vector<unsigned char> &out);
+		void AlignBits (std::vector<unsigned char> &out);
+	};
+
+	uint32_t Crc32 (uint32_t crc, const unsigned char *data, size_t size);
+	// Remarks:
+	// 1. Update crc (0 to Start) by data, as PNG Chunks are Checked;
+	// 2. 8 Bytes are taken at a time, by 8 Tables (Slicing-by-8);
+
+	uint32_t Adler32 (uint32_t adler, const unsigned char *data, size_t size);
+	// Remarks:
+	// 1. Update adler (1 to Start) by data, as Zlib Streams are Checked;
+	// 2. 16 Bytes are Summed at a time (by SSE2);
+}
+
+#endif  //EGGACHE_GL_ZLIB
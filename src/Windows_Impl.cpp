@@ -4,8 +4,12 @@
 //
 
 #include <exception>
+#include <fstream>
 #include <string>
 #include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
 #include <cmath>
 
 #include <Windows.h>
@@ -20,14 +24,10 @@
 // Only MSVC support #pragma link
 #pragma comment (lib, "Msimg32.lib")
 
-#else
-
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
-
 #endif
 
 #include "EggAche_Impl.h"
+#include "EggAche_Text.h"
 
 namespace EggAche_Impl
 {
@@ -96,6 +96,151 @@ namespace EggAche_Impl
 	std::unordered_map<HWND, WindowImpl_Windows *> *HwndManager::_hwndMapper = nullptr;
 	bool HwndManager::isRegClass = false;
 
+	class GdiObjectManager
+	{
+	private:
+		struct Entry
+		{
+			HGDIOBJ hObj;
+			size_t cSelected;		// Count of DCs selecting it
+		};
+		static std::mutex mtx;
+		static std::unordered_map<const void *, Entry> *_objects;
+
+		// Keep at most this many Unselected Objects alive
+		static const size_t MAX_OBJECTS = 256;
+	public:
+		static HGDIOBJ Select (const void *style,
+							   const std::function<HGDIOBJ ()> &fnCreate)
+		{
+			// Objects are shared by all DCs, keyed by Interned Styles
+			std::lock_guard<std::mutex> lg (mtx);
+			if (_objects == nullptr)
+				_objects = new std::unordered_map<const void *, Entry> ();
+
+			auto it = _objects->find (style);
+			if (it == _objects->end ())
+			{
+				// Sweep the Unselected ones before GDI Handles run out
+				if (_objects->size () >= MAX_OBJECTS)
+				{
+					for (auto p = _objects->begin (); p != _objects->end ();)
+					{
+						if (p->second.cSelected == 0)
+						{
+							DeleteObject (p->second.hObj);
+							p = _objects->erase (p);
+						}
+						else
+							++p;
+					}
+				}
+
+				auto hObj = fnCreate ();
+				if (!hObj)
+					return NULL;
+				it = _objects->emplace (style, Entry { hObj, 0 }).first;
+			}
+			it->second.cSelected++;
+			return it->second.hObj;
+		}
+
+		static void Deselect (const void *style)
+		{
+			std::lock_guard<std::mutex> lg (mtx);
+			auto it = _objects->find (style);
+			if (it != _objects->end () && it->second.cSelected > 0)
+				it->second.cSelected--;
+		}
+	};
+	std::mutex GdiObjectManager::mtx;
+	std::unordered_map<const void *, GdiObjectManager::Entry>
+		*GdiObjectManager::_objects = nullptr;
+
+	class FontFace_Windows : public FontFace
+	{
+	public:
+		FontFace_Windows (unsigned size, const char *family);
+		~FontFace_Windows () override;
+
+		HFONT GetHFont () const { return _hFont; }
+
+	protected:
+		bool RasterizeGlyph (unsigned char ch, GlyphBitmap &bitmap) override;
+		bool LoadAdvances (int advances[256]) override;
+
+	private:
+		HFONT _hFont;
+		HDC _hdc;				// Memory DC for Glyph Outlines
+		int _ascent;
+	};
+
+	class FontManager
+	{
+	private:
+		static std::mutex mtx;
+		static std::unordered_map<std::string,
+			std::unique_ptr<FontFace>> *_fonts;
+		static std::unordered_map<const FontStyle *,
+			FontFace *> *_styles;
+
+		static void _Init ()
+		{
+			if (_fonts == nullptr)
+			{
+				_fonts = new std::unordered_map<std::string,
+					std::unique_ptr<FontFace>> ();
+				_styles = new std::unordered_map<const FontStyle *,
+					FontFace *> ();
+			}
+		}
+
+		static FontFace *_GetFont (unsigned size, const std::string &family)
+		{
+			auto key = family + '\n' + std::to_string (size);
+			auto &font = (*_fonts)[key];
+			if (!font)
+			{
+				// Fall back to the Built-in Font if GDI fails
+				if (family == "Bitmap")
+					font.reset (new BitmapFontFace (size));
+				else
+					try { font.reset (new FontFace_Windows (size, family.c_str ())); }
+					catch (const std::runtime_error &)
+					{
+						font.reset (new BitmapFontFace (size));
+					}
+			}
+			return font.get ();
+		}
+	public:
+		static FontFace *GetFont (const FontStyle *style)
+		{
+			// Fonts are shared by all Contexts, and live until Exit
+			std::lock_guard<std::mutex> lg (mtx);
+			_Init ();
+
+			// Styles differing only in Color share the Face
+			auto &face = (*_styles)[style];
+			if (!face)
+				face = _GetFont (style->size, style->family);
+			return face;
+		}
+
+		static FontFace *GetFont (unsigned size, const char *family)
+		{
+			// Colors not Interned (of SetFont) are not Cached by Style
+			std::lock_guard<std::mutex> lg (mtx);
+			_Init ();
+			return _GetFont (size, family);
+		}
+	};
+	std::mutex FontManager::mtx;
+	std::unordered_map<std::string,
+		std::unique_ptr<FontFace>> *FontManager::_fonts = nullptr;
+	std::unordered_map<const FontStyle *,
+		FontFace *> *FontManager::_styles = nullptr;
+
 	// Window
 
 	class WindowImpl_Windows : public WindowImpl
@@ -180,6 +325,10 @@ namespace EggAche_Impl
 					  unsigned g = 0,
 					  unsigned b = 0) override;
 
+		bool SetStyle (const PenStyle *pen,
+					   const BrushStyle *brush,
+					   const FontStyle *font) override;
+
 		bool DrawLine (int xBeg, int yBeg, int xEnd, int yEnd) override;
 
 		bool DrawRect (int xBeg, int yBeg, int xEnd, int yEnd) override;
@@ -198,8 +347,15 @@ namespace EggAche_Impl
 		bool DrawPie (int xLeft, int yTop, int xRight, int yBottom,
 					  double angleBeg, double cAngle) override;
 
+		bool DrawPolyline (const Contour &points, bool isClosed) override;
+
+		bool FillPolygon (const std::vector<Contour> &contours,
+						  bool isNonZero) override;
+
 		bool DrawTxt (int xBeg, int yBeg, const char *szText) override;
 		size_t GetTxtWidth (const char *szText) override;
+		bool MeasureTexts (const char *const *texts, size_t count,
+						   size_t *widths) override;
 
 		bool DrawImg (const char *fileName,
 					  int x, int y,
@@ -215,11 +371,32 @@ namespace EggAche_Impl
 						  unsigned x_src, unsigned y_src,
 						  unsigned x_msk, unsigned y_msk) override;
 
-		bool SaveAsJpg (const char *fileName) const override;
-		bool SaveAsPng (const char *fileName) const override;
-		bool SaveAsBmp (const char *fileName) const override;
+		bool DrawImg (const ImageData &image,
+					  int x, int y, int width, int height) override;
+
+		bool DrawImgKeyed (const ImageData &image, int x, int y) override;
+
+		bool DrawImgMask (const ImageData &src,
+						  const ImageData &mask,
+						  unsigned width, unsigned height,
+						  int x_pos, int y_pos,
+						  unsigned x_src, unsigned y_src,
+						  unsigned x_msk, unsigned y_msk) override;
+
+		bool DrawSprite (const MaskedSprite &sprite, int x, int y) override;
+
+		bool EncodeJpg (const Rect &rect, unsigned quality,
+						const ImageWriter &writer) const override;
+		bool EncodePng (PngEncoder &png, const Rect &rect) const override;
+		bool CountColors (ColorCensus &census, const Rect &rect) const override;
+		bool EncodeBmp (const Rect &rect, const ImageWriter &writer) const override;
+		bool EncodeQoi (const Rect &rect, const ImageWriter &writer) const override;
+		bool SaveAsSnapshot (SnapshotStore &store, const Rect &rect) const override;
 
 		void Clear () override;
+		bool Scroll (int dx, int dy) override;
+
+		void SetClip (const Rect &clip) override;
 
 		void PaintOnContext (GUIContext *,
 							 size_t x, size_t y) const override;
@@ -229,6 +406,23 @@ namespace EggAche_Impl
 		HBITMAP _hBitmap;
 		size_t _w, _h;
 
+		Surface _surface;				// Pixels of _hBitmap (DIB Section)
+		Rect _clip;						// Clip of both GDI and _surface
+		const PenStyle *_pen;			// Current Interned Styles,
+		const BrushStyle *_brush;		// or _ownPen / _ownBrush
+		const FontStyle *_fontStyle;	// (nullptr if not Interned)
+		PenStyle _ownPen;				// Styles of SetPen / SetBrush,
+		BrushStyle _ownBrush;			// not Interned
+		HGDIOBJ _hOwnPen, _hOwnBrush;	// Created for them (or Stock)
+
+		bool _isBrushTransparent;
+		uint32_t _brushPixel;
+		FontFace *_font;				// Owned by FontManager
+		bool _isFontBitmap;				// No HFONT to fall back to
+		uint32_t _fontPixel;
+		HGDIOBJ _hAbcFont;				// HFONT of _abcWidths
+		int _abcWidths[256];			// Advances without a FontFace
+
 #ifdef _MSC_VER
 		GdiPlusManager _gdiplusManager;
 #endif
@@ -237,15 +431,13 @@ namespace EggAche_Impl
 		static const COLORREF _GetColor (unsigned r,
 										 unsigned g,
 										 unsigned b);
+		static uint32_t _GetPixel (COLORREF color);
 
-#ifdef _MSC_VER
-		bool SaveAsImg (const char *fileName,
-						const wchar_t *mime) const;
-#else
-		bool SaveAsImg (
-			std::function<bool (BYTE *pData,
-								BITMAPINFOHEADER *pbmInfoHeader)> fnSave) const;
-#endif
+		const Surface &_LockSurface () const;
+		Surface _LockSurface (const Rect &rect) const;		// View of rect
+		void _ReleasePen ();			// Deselect, or Delete if Owned,
+		void _ReleaseBrush ();			// the Replaced Object
+		void _UseFont (FontFace *face, COLORREF color);
 		friend bool WindowImpl_Windows::Draw (const GUIContext *, size_t, size_t);
 
 		GUIContext_Windows (const GUIContext_Windows &) = delete;		// Not allow to copy
@@ -567,15 +759,58 @@ namespace EggAche_Impl
 			return RGB (r, g, b) + 1;
 	}
 
+	uint32_t GUIContext_Windows::_GetPixel (COLORREF color)
+	{
+		// COLORREF is 0x00BBGGRR, while DIB Pixel is 0x00RRGGBB
+		return ((uint32_t) GetRValue (color) << 16) |
+			((uint32_t) GetGValue (color) << 8) |
+			(uint32_t) GetBValue (color);
+	}
+
+	const Surface &GUIContext_Windows::_LockSurface () const
+	{
+		// Finish the Batched GDI Calls before touching the Pixels
+		GdiFlush ();
+		return _surface;
+	}
+
+	Surface GUIContext_Windows::_LockSurface (const Rect &rect) const
+	{
+		const auto &surface = _LockSurface ();
+		return Surface {
+			(unsigned char *) (surface.Row (rect.top) + rect.left), surface.stride,
+			rect.right - rect.left, rect.bottom - rect.top };
+	}
+
 	GUIContext_Windows::GUIContext_Windows (size_t width, size_t height)
-		: _hdc (NULL), _hBitmap (NULL), _w (width), _h (height)
+		: _hdc (NULL), _hBitmap (NULL), _w (width), _h (height),
+		_pen (nullptr), _brush (nullptr), _fontStyle (nullptr),
+		_ownPen {}, _ownBrush {}, _hOwnPen (NULL), _hOwnBrush (NULL),
+		_isBrushTransparent (true), _brushPixel (0),
+		_clip { 0, 0, (int) width, (int) height },
+		_font (nullptr), _isFontBitmap (false), _fontPixel (0),
+		_hAbcFont (NULL)
 	{
 		// Get Root HDC
 		auto hdcRoot = GetDC (NULL);
 
 		// New Canvas HDC
 		_hdc = CreateCompatibleDC (hdcRoot);
-		_hBitmap = CreateCompatibleBitmap (hdcRoot, (int) _w, (int) _h);
+
+		// New Canvas Bitmap
+		// Using a 32-bit Top-down DIB Section, so that the Pixels
+		// can be accessed directly by the Portable Rasterizers
+		BITMAPINFO bmInfo = { 0 };
+		bmInfo.bmiHeader.biSize = sizeof (BITMAPINFOHEADER);
+		bmInfo.bmiHeader.biWidth = (LONG) _w;
+		bmInfo.bmiHeader.biHeight = -(LONG) _h;
+		bmInfo.bmiHeader.biPlanes = 1;
+		bmInfo.bmiHeader.biBitCount = 32;
+		bmInfo.bmiHeader.biCompression = BI_RGB;
+
+		void *pBits = nullptr;
+		_hBitmap = CreateDIBSection (hdcRoot, &bmInfo, DIB_RGB_COLORS,
+									 &pBits, NULL, 0);
 
 		if (!_hdc || !_hBitmap)
 		{
@@ -586,6 +821,11 @@ namespace EggAche_Impl
 		}
 		SelectObject (_hdc, _hBitmap);
 
+		_surface.bits = (unsigned char *) pBits;
+		_surface.stride = (ptrdiff_t) _w * 4;
+		_surface.w = (int) _w;
+		_surface.h = (int) _h;
+
 		// Release Root HDC
 		ReleaseDC (NULL, hdcRoot);
 
@@ -601,23 +841,17 @@ namespace EggAche_Impl
 
 	GUIContext_Windows::~GUIContext_Windows ()
 	{
-		HGDIOBJ hObj;
-
-		hObj = SelectObject (this->_hdc,
+		// Pens and Brushes are owned by GdiObjectManager (if Interned)
+		SelectObject (this->_hdc,
 			(HBRUSH) GetStockObject (NULL_BRUSH));
-		if (hObj != GetStockObject (NULL_BRUSH))
-			DeleteObject (hObj);
-
-		hObj = SelectObject (this->_hdc,
+		SelectObject (this->_hdc,
 			(HPEN) GetStockObject (BLACK_PEN));
-		if (hObj != GetStockObject (BLACK_PEN) &&
-			hObj != GetStockObject (NULL_PEN))
-			DeleteObject (hObj);
+		_ReleasePen ();
+		_ReleaseBrush ();
 
-		hObj = SelectObject (this->_hdc,
-			(HPEN) GetStockObject (SYSTEM_FONT));
-		if (hObj != GetStockObject (SYSTEM_FONT))
-			DeleteObject (hObj);
+		// Fonts are owned by FontManager
+		SelectObject (this->_hdc,
+			(HFONT) GetStockObject (SYSTEM_FONT));
 
 		DeleteDC (this->_hdc);
 		DeleteObject (this->_hBitmap);
@@ -628,23 +862,35 @@ namespace EggAche_Impl
 									 unsigned g,
 									 unsigned b)
 	{
-		HPEN hPen;
+		// Share the Object of an Equal Pen, if any
+		if (auto pen = FindPen (width, r, g, b))
+			return SetStyle (pen, nullptr, nullptr);
+
+		// Otherwise, the Pen is not Interned (for Animated Colors),
+		// and its Object is Owned by the Context
+		r = min (r, 255u); g = min (g, 255u); b = min (b, 255u);
+		if (width == 0)
+			r = g = b = 0;
+		if (_pen == &_ownPen && _ownPen.width == width &&
+			_ownPen.r == r && _ownPen.g == g && _ownPen.b == b)
+			return true;
 
+		HGDIOBJ hPen;
 		if (width == 0)
-			hPen = (HPEN) GetStockObject (NULL_PEN);
+			hPen = GetStockObject (NULL_PEN);
 		else if (width == 1 && r == 0 && g == 0 && b == 0)
-			hPen = (HPEN) GetStockObject (BLACK_PEN);
+			hPen = GetStockObject (BLACK_PEN);
 		else
 		{
 			hPen = CreatePen (PS_SOLID, width, _GetColor (r, g, b));
 			if (!hPen) return false;
 		}
 
-		auto hObj = SelectObject (_hdc, hPen);
-		if (hObj != GetStockObject (BLACK_PEN) &&
-			hObj != GetStockObject (NULL_PEN))
-			DeleteObject (hObj);
-
+		SelectObject (this->_hdc, hPen);
+		_ReleasePen ();
+		_hOwnPen = hPen;
+		_ownPen = PenStyle { width, r, g, b };
+		_pen = &_ownPen;
 		return true;
 	}
 
@@ -653,20 +899,35 @@ namespace EggAche_Impl
 									   unsigned g,
 									   unsigned b)
 	{
-		HBRUSH hBrush;
+		// Share the Object of an Equal Brush, if any
+		if (auto brush = FindBrush (isTransparent, r, g, b))
+			return SetStyle (nullptr, brush, nullptr);
 
+		// Otherwise, as SetPen
+		r = min (r, 255u); g = min (g, 255u); b = min (b, 255u);
 		if (isTransparent)
-			hBrush = (HBRUSH) GetStockObject (NULL_BRUSH);
+			r = g = b = 0;
+		if (_brush == &_ownBrush && _ownBrush.isTransparent == isTransparent &&
+			_ownBrush.r == r && _ownBrush.g == g && _ownBrush.b == b)
+			return true;
+
+		HGDIOBJ hBrush;
+		if (isTransparent)
+			hBrush = GetStockObject (NULL_BRUSH);
 		else
 		{
 			hBrush = CreateSolidBrush (_GetColor (r, g, b));
 			if (!hBrush) return false;
 		}
 
-		auto hObj = SelectObject (_hdc, hBrush);
-		if (hObj != GetStockObject (NULL_BRUSH))
-			DeleteObject (hObj);
+		SelectObject (this->_hdc, hBrush);
+		_ReleaseBrush ();
+		_hOwnBrush = hBrush;
+		_ownBrush = BrushStyle { isTransparent, r, g, b };
+		_brush = &_ownBrush;
 
+		_isBrushTransparent = isTransparent;
+		_brushPixel = _GetPixel (_GetColor (r, g, b));
 		return true;
 	}
 
@@ -676,18 +937,103 @@ namespace EggAche_Impl
 									  unsigned g,
 									  unsigned b)
 	{
-		SetTextColor (this->_hdc, _GetColor (r, g, b));
+		// Faces are shared by Family and Size, so the Color is not Interned
+		auto face = FontManager::GetFont (size, family);
+		if (!face) return false;
+
+		_UseFont (face, _GetColor (r, g, b));
+		_fontStyle = nullptr;
+		return true;
+	}
+
+	void GUIContext_Windows::_ReleasePen ()
+	{
+		if (_pen == &_ownPen)
+		{
+			// Stock Objects need no Deleting
+			if (_hOwnPen != GetStockObject (NULL_PEN) &&
+				_hOwnPen != GetStockObject (BLACK_PEN))
+				DeleteObject (_hOwnPen);
+			_hOwnPen = NULL;
+		}
+		else if (_pen)
+			GdiObjectManager::Deselect (_pen);
+	}
+
+	void GUIContext_Windows::_ReleaseBrush ()
+	{
+		if (_brush == &_ownBrush)
+		{
+			if (_hOwnBrush != GetStockObject (NULL_BRUSH))
+				DeleteObject (_hOwnBrush);
+			_hOwnBrush = NULL;
+		}
+		else if (_brush)
+			GdiObjectManager::Deselect (_brush);
+	}
+
+	void GUIContext_Windows::_UseFont (FontFace *face, COLORREF color)
+	{
+		auto winFace = dynamic_cast<FontFace_Windows *> (face);
+		SetTextColor (this->_hdc, color);
+		if (winFace)
+			SelectObject (this->_hdc, winFace->GetHFont ());
+
+		_font = face;
+		_isFontBitmap = winFace == nullptr;
+		_fontPixel = _GetPixel (color);
+	}
+
+	bool GUIContext_Windows::SetStyle (const PenStyle *pen,
+									   const BrushStyle *brush,
+									   const FontStyle *font)
+	{
+		// Interned Styles are compared by Address,
+		// and their GDI Objects are created only once
+		if (pen && pen != _pen)
+		{
+			auto hPen = GdiObjectManager::Select (pen, [pen] () -> HGDIOBJ
+			{
+				if (pen->width == 0)
+					return GetStockObject (NULL_PEN);
+				if (pen->width == 1 && pen->r == 0 && pen->g == 0 && pen->b == 0)
+					return GetStockObject (BLACK_PEN);
+				return CreatePen (PS_SOLID, pen->width,
+								  _GetColor (pen->r, pen->g, pen->b));
+			});
+			if (!hPen) return false;
+
+			SelectObject (this->_hdc, hPen);
+			_ReleasePen ();
+			_pen = pen;
+		}
+
+		if (brush && brush != _brush)
+		{
+			auto hBrush = GdiObjectManager::Select (brush, [brush] () -> HGDIOBJ
+			{
+				if (brush->isTransparent)
+					return GetStockObject (NULL_BRUSH);
+				return CreateSolidBrush (_GetColor (brush->r, brush->g, brush->b));
+			});
+			if (!hBrush) return false;
+
+			SelectObject (this->_hdc, hBrush);
+			_ReleaseBrush ();
+			_brush = brush;
 
-		auto hFont = CreateFontA (size, 0, 0, 0,
-								  FW_DONTCARE, FALSE, FALSE, FALSE,
-								  DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
-								  CLIP_DEFAULT_PRECIS, NONANTIALIASED_QUALITY,
-								  DEFAULT_PITCH, family);
-		if (!hFont) return false;
+			_isBrushTransparent = brush->isTransparent;
+			_brushPixel = _GetPixel (_GetColor (brush->r, brush->g, brush->b));
+		}
 
-		auto hObj = SelectObject (this->_hdc, hFont);
-		if (hObj != GetStockObject (SYSTEM_FONT))
-			DeleteObject (hObj);
+		if (font && font != _fontStyle)
+		{
+			auto face = FontManager::GetFont (font);
+			if (!face) return false;
+
+			_UseFont (face, _GetColor (font->r, font->g, font->b));
+			_fontStyle = font;
+		}
 
 		return true;
 	}
@@ -805,23 +1151,91 @@ namespace EggAche_Impl
 		return !!Pie (this->_hdc, xLeft, yTop, xRight, yBottom, xBeg, yBeg, xEnd, yEnd);
 	}
 
+	bool GUIContext_Windows::DrawPolyline (const Contour &points, bool isClosed)
+	{
+		if (points.size () < 2)
+			return true;
+
+		std::vector<POINT> pts;
+		pts.reserve (points.size () + 1);
+		for (const auto &point : points)
+			pts.push_back ({ (LONG) std::lround (point.x),
+						   (LONG) std::lround (point.y) });
+		if (isClosed)
+			pts.push_back (pts.front ());
+
+		return !!Polyline (this->_hdc, pts.data (), (int) pts.size ());
+	}
+
+	bool GUIContext_Windows::FillPolygon (const std::vector<Contour> &contours,
+										  bool isNonZero)
+	{
+		if (_isBrushTransparent)
+			return true;
+
+		// Write the Spans into the DIB Section directly,
+		// rather than one GDI Call per Span
+		const auto &surface = _LockSurface ();
+		auto pixel = _brushPixel;
+		EggAche_Impl::FillPolygon (contours, isNonZero, _clip,
+								   [&] (int y, int xBeg, int xEnd)
+		{
+			FillSpan (surface, y, xBeg, xEnd, pixel);
+		});
+		return true;
+	}
+
 	bool GUIContext_Windows::DrawTxt (int xBeg, int yBeg, const char * szText)
 	{
-		return !!TextOutA (this->_hdc, xBeg, yBeg, szText, (int) strlen (szText));
+		// Multi-byte Characters (DBCS Code Pages) are left to GDI
+		auto isGlyphCached = _font != nullptr;
+		for (auto p = szText; *p && isGlyphCached && !_isFontBitmap; p++)
+			if ((unsigned char) *p >= 0x80)
+				isGlyphCached = false;
+		if (!isGlyphCached)
+			return !!TextOutA (this->_hdc, xBeg, yBeg, szText, (int) strlen (szText));
+
+		// Blit the Cached Glyphs instead
+		_font->DrawTxt (_LockSurface (), _clip, xBeg, yBeg, szText, _fontPixel);
+		return true;
 	}
 
 	size_t GUIContext_Windows::GetTxtWidth (const char *szText)
 	{
-		std::string str (szText);
-		size_t ret = 0;
-		ABCFLOAT abcFloat;
-		for (const auto &ch : str)
+		size_t width;
+		if (!MeasureTexts (&szText, 1, &width))
+			return 0;
+		return width;
+	}
+
+	bool GUIContext_Windows::MeasureTexts (const char *const *texts, size_t count,
+										   size_t *widths)
+	{
+		// Sum up the Cached Advance Widths of the Font
+		if (_font)
+			return _font->MeasureTexts (texts, count, widths);
+
+		// Otherwise all the Widths of the Selected HFONT are Fetched at once,
+		// and kept until another HFONT is Selected
+		auto hFont = GetCurrentObject (this->_hdc, OBJ_FONT);
+		if (hFont != _hAbcFont)
 		{
-			if (!GetCharABCWidthsFloatA (this->_hdc, ch, ch, &abcFloat))
-				return 0;
-			ret += (int) (abcFloat.abcfA + abcFloat.abcfB + abcFloat.abcfC);
+			ABCFLOAT abcFloats[256];
+			if (!GetCharABCWidthsFloatA (this->_hdc, 0, 255, abcFloats))
+				return false;
+			for (auto i = 0; i < 256; i++)
+				_abcWidths[i] = (int) (abcFloats[i].abcfA +
+									   abcFloats[i].abcfB + abcFloats[i].abcfC);
+			_hAbcFont = hFont;
 		}
-		return ret;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			widths[i] = 0;
+			for (auto p = texts[i]; *p; p++)
+				widths[i] += _abcWidths[(BYTE) *p];
+		}
+		return true;
 	}
 
 #ifdef _MSC_VER_TODO
@@ -989,255 +1403,122 @@ namespace EggAche_Impl
 		return true;
 	}
 
-#ifdef _MSC_VER
-	// Using GDI+ to Encode Images
-
-	bool GUIContext_Windows::SaveAsImg (const char *fileName,
-										const wchar_t *mime) const
+	bool GUIContext_Windows::DrawImg (const ImageData &image,
+									  int x, int y, int width, int height)
 	{
-		auto ret = false;
-		{
-			auto GetEncoderClsid = [] (const WCHAR* format, CLSID* pClsid)
-			{
-				using namespace Gdiplus;
-
-				UINT  num = 0;          // number of image encoders
-				UINT  size = 0;         // size of the image encoder array in bytes
-
-				ImageCodecInfo* pImageCodecInfo = NULL;
-
-				GetImageEncodersSize (&num, &size);
-				if (size == 0)
-					return -1;  // Failure
-
-				pImageCodecInfo = (ImageCodecInfo*) (malloc (size));
-				if (pImageCodecInfo == NULL)
-					return -1;  // Failure
-
-				GetImageEncoders (num, size, pImageCodecInfo);
-
-				for (size_t j = 0; j < num; ++j)
-				{
-					if (wcscmp (pImageCodecInfo[j].MimeType, format) == 0)
-					{
-						*pClsid = pImageCodecInfo[j].Clsid;
-						free (pImageCodecInfo);
-						return (int) j;  // Success
-					}
-				}
-
-				free (pImageCodecInfo);
-				return -1;  // Failure
-			};
-
-			// Get the CLSID of the PNG encoder.
-			CLSID encoderClsid;
-			if (-1 == GetEncoderClsid (mime, &encoderClsid))
-				return false;
-
-			// Get Bitmap Object.
-			auto bmp = Gdiplus::Bitmap::FromHBITMAP (this->_hBitmap, NULL);
+		// Blit the Decoded Rows into the DIB directly
+		BlitImage (_LockSurface (), _clip, x, y, width, height, image);
+		return true;
+	}
 
-			// Get File Name in Wide Chars.
-			auto cchW = MultiByteToWideChar (CP_ACP, MB_COMPOSITE,
-											 fileName, -1, NULL, 0);
-			wchar_t *fileNameW = new wchar_t[cchW];
-			MultiByteToWideChar (CP_ACP, MB_COMPOSITE,
-								 fileName, -1, fileNameW, cchW);
+	bool GUIContext_Windows::DrawImgKeyed (const ImageData &image, int x, int y)
+	{
+		// Same as TransparentBlt of the Copy in PaintOnContext
+		BlitImageKeyed (_LockSurface (), _clip, x, y, image, _GetPixel (_colorMask));
+		return true;
+	}
 
-			// Save to File
-			auto status = bmp->Save (fileNameW, &encoderClsid, NULL);
+	bool GUIContext_Windows::DrawImgMask (
+		const ImageData &src,
+		const ImageData &mask,
+		unsigned width, unsigned height,
+		int x_pos, int y_pos,
+		unsigned x_src, unsigned y_src,
+		unsigned x_msk, unsigned y_msk)
+	{
+		if (x_src >= (unsigned) src.w || y_src >= (unsigned) src.h ||
+			x_msk >= (unsigned) mask.w || y_msk >= (unsigned) mask.h)
+			return false;
 
-			delete[] fileNameW;
-			delete bmp;
-			ret = (status == Gdiplus::Ok);
-		}
-		return ret;
+		BlitImageMask (_LockSurface (), _clip,
+					   x_pos, y_pos, (int) width, (int) height,
+					   src, (int) x_src, (int) y_src,
+					   mask, (int) x_msk, (int) y_msk);
+		return true;
 	}
 
-	bool GUIContext_Windows::SaveAsJpg (const char *fileName) const
+	bool GUIContext_Windows::DrawSprite (const MaskedSprite &sprite, int x, int y)
 	{
-		return SaveAsImg (fileName, L"image/jpeg");
+		// Only the Runs not Transparent are Touched
+		BlitMaskedSprite (_LockSurface (), _clip, x, y, sprite);
+		return true;
 	}
 
-	bool GUIContext_Windows::SaveAsPng (const char *fileName) const
+	bool GUIContext_Windows::EncodeJpg (const Rect &rect, unsigned quality,
+										const ImageWriter &writer) const
 	{
-		return SaveAsImg (fileName, L"image/png");
+		// Portable Encoder for both MSVC and MinGW
+		std::vector<unsigned char> jpeg;
+		if (!EncodeJpeg (_LockSurface (rect), (int) min (quality, 100u), jpeg))
+			return false;
+		return writer (jpeg.data (), jpeg.size ());
 	}
 
-	bool GUIContext_Windows::SaveAsBmp (const char *fileName) const
+	bool GUIContext_Windows::EncodePng (PngEncoder &png, const Rect &rect) const
 	{
-		return SaveAsImg (fileName, L"image/bmp");
+		// Rows are Converted to RGB one by one, with no Copy of the Rect
+		return png.AddRows (_LockSurface (rect));
 	}
 
-#else
-	// MinGW doesn't support GDI+
-
-	bool GUIContext_Windows::SaveAsImg (
-		std::function<bool (BYTE *pData,
-							BITMAPINFOHEADER *pbmInfoHeader)> fnSave) const
+	bool GUIContext_Windows::CountColors (ColorCensus &census,
+										  const Rect &rect) const
 	{
-		// Ref:
-		// https://msdn.microsoft.com/en-us/library/dd145119(v=vs.85).aspx
+		return census.Add (_LockSurface (rect));
+	}
 
-		// Retrieve the bitmap color format, width, and height.
-		BITMAP bitmap = { 0 };
-		GetObject (this->_hBitmap, sizeof (BITMAP), &bitmap);
+	bool GUIContext_Windows::EncodeBmp (const Rect &rect,
+										const ImageWriter &writer) const
+	{
+		auto surface = _LockSurface (rect);
+		auto cbRow = (DWORD) surface.w * 4;
 
-		// NOT Support Less than 24 bit
-		// There is no RGBQUAD array for these formats:
-		// 24-bit-per-pixel or 32-bit-per-pixel
+		// 32-bit Bottom-up Rows, with no RGBQUAD array
+		BITMAPFILEHEADER bmFileHeader = { 0 };
 		BITMAPINFOHEADER bmInfoHeader = { 0 };
+		bmFileHeader.bfType = 0x4d42;			// 0x42 = "B" 0x4d = "M"
+		bmFileHeader.bfOffBits = sizeof (BITMAPFILEHEADER) +
+			sizeof (BITMAPINFOHEADER);
+		bmFileHeader.bfSize = bmFileHeader.bfOffBits + cbRow * surface.h;
 
-		// Initialize the fields in the BITMAPINFO structure.
 		bmInfoHeader.biSize = sizeof (BITMAPINFOHEADER);
-		bmInfoHeader.biWidth = bitmap.bmWidth;
-		bmInfoHeader.biHeight = bitmap.bmHeight;
+		bmInfoHeader.biWidth = surface.w;
+		bmInfoHeader.biHeight = surface.h;
 		bmInfoHeader.biPlanes = 1;
-
-		// Convert the color format to a count of bits.
-		if (bitmap.bmBitsPixel <= 24)
-			bmInfoHeader.biBitCount = 24;
-		else
-			bmInfoHeader.biBitCount = 32;
-
-		// If the bitmap is not compressed, set the BI_RGB flag.
+		bmInfoHeader.biBitCount = 32;
 		bmInfoHeader.biCompression = BI_RGB;
+		bmInfoHeader.biSizeImage = cbRow * surface.h;
 
-		// Compute the number of bytes in the array of color
-		// indices and store the result in biSizeImage.
-		// The width must be DWORD aligned unless the bitmap is RLE
-		// compressed.
-		bmInfoHeader.biSizeImage =
-			((bmInfoHeader.biWidth * bmInfoHeader.biBitCount + 31) & ~31)
-			/ 8 * bmInfoHeader.biHeight;
-
-		// Set biClrImportant to 0, indicating that all of the
-		// device colors are important.
-		bmInfoHeader.biClrImportant = 0;
-
-		// Allocate Memory for DIB Data.
-		auto hDIB = GlobalAlloc (GHND, bmInfoHeader.biSizeImage);
-		auto pData = (BYTE *) GlobalLock (hDIB);
-
-		// Get DIB.
-		GetDIBits (this->_hdc, this->_hBitmap, 0, (WORD) this->_h, pData,
-			(LPBITMAPINFO) &bmInfoHeader, DIB_RGB_COLORS);
-
-		// Save to Bmp or Png
-		// Strategy Pattern :-)
-		if (!fnSave (pData, &bmInfoHeader))
-		{
-			GlobalUnlock (hDIB);
-			GlobalFree (hDIB);
+		if (!writer ((const unsigned char *) &bmFileHeader, sizeof (BITMAPFILEHEADER)) ||
+			!writer ((const unsigned char *) &bmInfoHeader, sizeof (BITMAPINFOHEADER)))
 			return false;
-		}
-
-		// Free Memory.
-		GlobalUnlock (hDIB);
-		GlobalFree (hDIB);
-		return true;
-	}
 
-	bool GUIContext_Windows::SaveAsBmp (const char *fileName) const
-	{
-		auto fnSave = [&] (BYTE *pData,
-						   BITMAPINFOHEADER *pbmInfoHeader)
+		// Rows are Written one by one, with the Undefined Alpha Cleared
+		std::vector<uint32_t> row ((size_t) surface.w);
+		for (auto y = surface.h - 1; y >= 0; y--)
 		{
-			// Initialize BITMAPFILEHEADER.
-			BITMAPFILEHEADER bmFileHeader = { 0 };
-			bmFileHeader.bfType = 0x4d42;			// 0x42 = "B" 0x4d = "M"
-			bmFileHeader.bfOffBits = sizeof (BITMAPFILEHEADER) +
-				sizeof (BITMAPINFOHEADER);
-			bmFileHeader.bfSize = bmFileHeader.bfOffBits
-				+ pbmInfoHeader->biSizeImage;
-
-			auto hFile = CreateFileA (fileName,
-									  GENERIC_READ | GENERIC_WRITE,
-									  (DWORD) 0,
-									  NULL,
-									  CREATE_ALWAYS,
-									  FILE_ATTRIBUTE_NORMAL,
-									  (HANDLE) NULL);
-			if (hFile == INVALID_HANDLE_VALUE)
-				return false;
-
-			if (!WriteFile (hFile, &bmFileHeader, sizeof (BITMAPFILEHEADER), NULL, NULL))
-			{
-				CloseHandle (hFile);
+			auto src = surface.Row (y);
+			for (auto x = 0; x < surface.w; x++)
+				row[x] = src[x] & 0xFFFFFF;
+			if (!writer ((const unsigned char *) row.data (), cbRow))
 				return false;
-			}
-			if (!WriteFile (hFile, pbmInfoHeader, sizeof (BITMAPINFOHEADER), NULL, NULL))
-			{
-				CloseHandle (hFile);
-				return false;
-			}
-			if (!WriteFile (hFile, pData, pbmInfoHeader->biSizeImage, NULL, NULL))
-			{
-				CloseHandle (hFile);
-				return false;
-			}
-			CloseHandle (hFile);
-			return true;
-		};
-
-		return SaveAsImg (fnSave);
+		}
+		return true;
 	}
 
-	bool GUIContext_Windows::SaveAsPng (const char *fileName) const
+	bool GUIContext_Windows::EncodeQoi (const Rect &rect,
+										const ImageWriter &writer) const
 	{
-		auto fnConvertAndSave = [&] (BYTE *pData,
-									 BITMAPINFOHEADER *pbmInfoHeader)
-		{
-			// The amount of scanline bytes is width of image times channels,
-			// with extra bytes added if needed to make it a multiple of 4 bytes.
-			unsigned numChannels = pbmInfoHeader->biBitCount / 8;
-			unsigned scanlineBytes = pbmInfoHeader->biWidth * numChannels;
-			if (scanlineBytes % 4 != 0)
-				scanlineBytes = (scanlineBytes / 4) * 4 + 4;
-			unsigned dataSize = scanlineBytes * pbmInfoHeader->biHeight;
-
-			/*
-			There are 3 differences between BMP and the raw image buffer for LodePNG:
-			-it's upside down
-			-it's in BGR instead of RGB format (or BRGA instead of RGBA)
-			-each scanline has padding bytes to make it a multiple of 4 if needed
-			The 2D for loop below does all these 3 conversions at once.
-			*/
-			auto rgbArr = new BYTE[pbmInfoHeader->biWidth * pbmInfoHeader->biHeight * 3];
-			for (unsigned y = 0; y < pbmInfoHeader->biHeight; y++)
-				for (unsigned x = 0; x < pbmInfoHeader->biWidth; x++)
-				{
-					// pixel start byte position in the BMP
-					unsigned bmpos = (pbmInfoHeader->biHeight - y - 1)
-						* scanlineBytes + numChannels * x;
-
-					// pixel start byte position in the rgbaArr
-					unsigned newpos = 3 * y * pbmInfoHeader->biWidth + 3 * x;
-
-					// Take 24 bit
-					rgbArr[newpos + 0] = pData[bmpos + 2];	//R
-					rgbArr[newpos + 1] = pData[bmpos + 1];	//G
-					rgbArr[newpos + 2] = pData[bmpos + 0];	//B
-				}
-
-			stbi_write_png (fileName, pbmInfoHeader->biWidth,
-							pbmInfoHeader->biHeight,
-							3, rgbArr, pbmInfoHeader->biWidth * 3);
-
-			delete[] rgbArr;
-			return true;
-		};
-
-		return SaveAsImg (fnConvertAndSave);
+		std::vector<unsigned char> qoi;
+		if (!EggAche_Impl::EncodeQoi (_LockSurface (rect), qoi))
+			return false;
+		return writer (qoi.data (), qoi.size ());
 	}
 
-	bool GUIContext_Windows::SaveAsJpg (const char * fileName) const
+	bool GUIContext_Windows::SaveAsSnapshot (SnapshotStore &store,
+											 const Rect &rect) const
 	{
-		// Not Implemented
-		return false;
+		return store.Append (_LockSurface (rect));
 	}
-#endif
 
 	void GUIContext_Windows::Clear ()
 	{
@@ -1251,6 +1532,55 @@ namespace EggAche_Impl
 		DeleteObject (hBrush);
 	}
 
+	bool GUIContext_Windows::Scroll (int dx, int dy)
+	{
+		const auto &surface = _LockSurface ();
+		auto w = _clip.right - _clip.left;
+		auto h = _clip.bottom - _clip.top;
+		if (w <= 0 || h <= 0)
+			return true;
+
+		auto blank = _GetPixel (_colorMask);
+		auto cxMove = abs (dx) < w ? w - abs (dx) : 0;
+		auto xSrc = _clip.left + max (-dx, 0);
+		auto xDst = _clip.left + max (dx, 0);
+
+		// Move Rows in the Order that never overwrites Unmoved Rows
+		for (auto i = 0; i < h; i++)
+		{
+			auto y = dy > 0 ? _clip.bottom - 1 - i : _clip.top + i;
+			auto row = surface.Row (y);
+			auto ySrc = y - dy;
+			if (ySrc < _clip.top || ySrc >= _clip.bottom || cxMove == 0)
+			{
+				std::fill (row + _clip.left, row + _clip.right, blank);
+				continue;
+			}
+
+			memmove (row + xDst, surface.Row (ySrc) + xSrc, cxMove * 4);
+			if (dx > 0)
+				std::fill (row + _clip.left, row + xDst, blank);
+			else
+				std::fill (row + xDst + cxMove, row + _clip.right, blank);
+		}
+		return true;
+	}
+
+	void GUIContext_Windows::SetClip (const Rect &clip)
+	{
+		_clip.left = max (clip.left, 0);
+		_clip.top = max (clip.top, 0);
+		_clip.right = min (clip.right, (int) this->_w);
+		_clip.bottom = min (clip.bottom, (int) this->_h);
+
+		// GDI Primitives are trimmed by the Clip Region
+		auto hRgn = CreateRectRgn (_clip.left, _clip.top,
+								   max (_clip.left, _clip.right),
+								   max (_clip.top, _clip.bottom));
+		SelectClipRgn (this->_hdc, hRgn);
+		DeleteObject (hRgn);
+	}
+
 	void GUIContext_Windows::PaintOnContext (GUIContext *parentContext,
 											 size_t x, size_t y) const
 	{
@@ -1261,6 +1591,86 @@ namespace EggAche_Impl
 						GUIContext_Windows::_colorMask);
 	}
 
+	// Font
+
+	FontFace_Windows::FontFace_Windows (unsigned size, const char *family)
+		: _hFont (NULL), _hdc (NULL), _ascent (0)
+	{
+		_hFont = CreateFontA (size, 0, 0, 0,
+							  FW_DONTCARE, FALSE, FALSE, FALSE,
+							  DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
+							  CLIP_DEFAULT_PRECIS, NONANTIALIASED_QUALITY,
+							  DEFAULT_PITCH, family);
+		_hdc = CreateCompatibleDC (NULL);
+		if (!_hFont || !_hdc)
+		{
+			if (_hFont) DeleteObject (_hFont);
+			if (_hdc) DeleteDC (_hdc);
+			throw std::runtime_error ("Err_Font_#0_Create");
+		}
+		SelectObject (_hdc, _hFont);
+
+		TEXTMETRICA tm;
+		if (GetTextMetricsA (_hdc, &tm))
+			_ascent = tm.tmAscent;
+	}
+
+	FontFace_Windows::~FontFace_Windows ()
+	{
+		DeleteDC (_hdc);
+		DeleteObject (_hFont);
+	}
+
+	bool FontFace_Windows::RasterizeGlyph (unsigned char ch,
+										   GlyphBitmap &bitmap)
+	{
+		// Same Glyph as TextOut: NONANTIALIASED_QUALITY gives 1-bit Glyphs
+		const MAT2 identity = { { 0, 1 }, { 0, 0 }, { 0, 0 }, { 0, 1 } };
+		GLYPHMETRICS gm;
+		auto cbBuffer = GetGlyphOutlineA (_hdc, ch, GGO_BITMAP,
+										  &gm, 0, NULL, &identity);
+		if (cbBuffer == GDI_ERROR)
+			return false;
+
+		bitmap.xOff = gm.gmptGlyphOrigin.x;
+		bitmap.yOff = _ascent - gm.gmptGlyphOrigin.y;
+		bitmap.advance = gm.gmCellIncX;
+
+		// Blank Glyph (Space)
+		if (cbBuffer == 0)
+			return true;
+
+		std::vector<BYTE> mono (cbBuffer);
+		if (GetGlyphOutlineA (_hdc, ch, GGO_BITMAP, &gm,
+							  cbBuffer, mono.data (), &identity) == GDI_ERROR)
+			return false;
+
+		// Rows of 1-bit Glyphs are DWORD aligned
+		bitmap.w = (int) gm.gmBlackBoxX;
+		bitmap.h = (int) gm.gmBlackBoxY;
+		auto cbRow = (size_t) (bitmap.w + 31) / 32 * 4;
+		bitmap.coverage.assign ((size_t) bitmap.w * bitmap.h, 0);
+		for (auto y = 0; y < bitmap.h; y++)
+			for (auto x = 0; x < bitmap.w; x++)
+				if (mono[y * cbRow + x / 8] & (0x80 >> (x % 8)))
+					bitmap.coverage[(size_t) y * bitmap.w + x] = 255;
+		return true;
+	}
+
+	bool FontFace_Windows::LoadAdvances (int advances[256])
+	{
+		// Query all the Characters by a single Call
+		ABCFLOAT abcFloats[256];
+		if (!GetCharABCWidthsFloatA (_hdc, 0, 255, abcFloats))
+			return false;
+
+		for (auto i = 0; i < 256; i++)
+			advances[i] = (int) (abcFloats[i].abcfA +
+								 abcFloats[i].abcfB +
+								 abcFloats[i].abcfC);
+		return true;
+	}
+
 	// MsgBox
 
 	void MsgBox_Impl (const char * szTxt, const char * szCap)